@@ -0,0 +1,84 @@
+/*
+ * Counter-based generator of encoding coefficients. See coefgen.h.
+ */
+#include "coefgen.h"
+
+#define PHILOX_M0       0xD2511F53
+#define PHILOX_M1       0xCD9E8D57
+#define PHILOX_W0       0x9E3779B9
+#define PHILOX_W1       0xBB67AE85
+#define PHILOX_ROUNDS   10
+
+void philox4x32(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r=0; r<PHILOX_ROUNDS; r++) {
+        uint64_t p0 = (uint64_t) PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t) PHILOX_M1 * c2;
+        c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t) p1;
+        c3 = (uint32_t) p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// Map a random word to a coefficient of GF(2^gfpower); coefficients are
+// non-zero except in GF(2), where a zero coefficient is the only way for
+// successive repair packets to differ
+static inline int word_to_coef(uint32_t w, int gfpower)
+{
+    switch (gfpower) {
+    case 1:
+        return w & 1;
+    case 16:
+        return 1 + w % 65535;
+    default:
+        return 1 + w % 255;
+    }
+}
+
+int coef_at(int seed, int repairid, int sourceid, int gfpower)
+{
+    uint32_t ctr[4] = { (uint32_t) sourceid >> 2, (uint32_t) repairid, 0, 0 };
+    uint32_t key[2] = { (uint32_t) seed, 0 };
+    uint32_t out[4];
+    philox4x32(ctr, key, out);
+    return word_to_coef(out[sourceid & 3], gfpower);
+}
+
+/*
+ * Generate coefficients of source packets win_s..win_e of a repair packet into
+ * coes (COEBYTES(gfpower) bytes each), identical to calling coef_at() for each
+ * of them but with one Philox block per four coefficients.
+ */
+void coef_batch(int seed, int repairid, int win_s, int win_e, int gfpower, GF_ELEMENT *coes)
+{
+    uint32_t key[2] = { (uint32_t) seed, 0 };
+    uint32_t out[4];
+    int nbytes = gfpower > 8 ? 2 : 1;
+    if (win_e < win_s)
+        return;
+    // stops at win_e before incrementing, as win_e may be INT_MAX
+    int sid = win_s;
+    for (;;) {
+        uint32_t ctr[4] = { (uint32_t) sid >> 2, (uint32_t) repairid, 0, 0 };
+        philox4x32(ctr, key, out);
+        for (int w=sid & 3; w<4; w++) {
+            int c = word_to_coef(out[w], gfpower);
+            GF_ELEMENT *p = coes + (sid - win_s) * nbytes;
+            p[0] = c & 0xff;
+            if (nbytes == 2)
+                p[1] = c >> 8;
+            if (sid == win_e)
+                return;
+            sid++;
+        }
+    }
+}
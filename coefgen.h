@@ -0,0 +1,28 @@
+#ifndef COEFGEN_H
+#define COEFGEN_H
+/*
+ * Counter-based generator of encoding coefficients
+ *
+ * The coefficient of source packet sid in repair packet rid is a pure function
+ * of (seed, rid, sid), computed by Philox4x32-10 [1]. Unlike the sequential
+ * MT19937 stream, any coefficient can be regenerated independently (e.g., by a
+ * decoder that only knows a packet's header, or in parallel batches), and no
+ * generator state is kept in the encoder/decoder context.
+ *
+ * Each Philox block yields four 32-bit words, used for four consecutive source
+ * ids: word sid%4 of block (sid/4, rid).
+ *
+ * [1] J. K. Salmon, M. A. Moraes, R. O. Dror and D. E. Shaw, "Parallel random
+ *     numbers: As easy as 1, 2, 3," SC'11.
+ */
+#include <stdint.h>
+#ifndef GALOIS
+#define GALOIS
+typedef unsigned char GF_ELEMENT;
+#endif
+
+void philox4x32(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+int coef_at(int seed, int repairid, int sourceid, int gfpower);
+void coef_batch(int seed, int repairid, int win_s, int win_e, int gfpower, GF_ELEMENT *coes);
+
+#endif  // COEFGEN_H
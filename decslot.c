@@ -0,0 +1,125 @@
+/*
+ * Low-footprint decoder state. See decslot.h.
+ */
+#include "decslot.h"
+
+void dec_slot_init(struct dec_slot *s, struct parameters *cp, int nrecv, DELIVER_FN deliver, void *arg)
+{
+    s->dc          = NULL;
+    s->cp          = cp;
+    s->nrecv       = nrecv > 0 ? nrecv : DEC_SLOT_RECV;
+    s->deliver     = deliver;
+    s->deliver_arg = arg;
+    s->inorder     = -1;
+    s->prev_rep    = -1;
+    s->recovered   = NULL;
+    s->acked       = -1;
+}
+
+static void free_ring(struct dec_slot *s)
+{
+    if (s->recovered == NULL)
+        return;
+    for (int i=0; i<s->nrecv; i++)
+        free(s->recovered[i]);
+    free(s->recovered);
+    s->recovered = NULL;
+}
+
+struct decoder *dec_slot_get(struct dec_slot *s)
+{
+    if (s->dc != NULL)
+        return s->dc;
+    struct decoder *dc = initialize_decoder_at(s->cp, s->inorder);
+    if (dc == NULL)
+        return NULL;
+    if (s->recovered != NULL) {
+        // re-attach the ring kept at parking, of the same size, so packets keep their slots
+        free(dc->recovered);
+        dc->recovered = s->recovered;
+        dc->recvsize  = s->nrecv;
+        s->recovered  = NULL;
+    } else if (resize_recovered_buffer(dc, s->nrecv) < 0) {
+        free_decoder(dc);
+        return NULL;
+    }
+    set_delivery_callback(dc, s->deliver, s->deliver_arg);
+    dc->prev_rep = s->prev_rep;
+    s->dc = dc;
+    return dc;
+}
+
+int dec_slot_park(struct dec_slot *s)
+{
+    struct decoder *dc = s->dc;
+    if (dc == NULL)
+        return 1;
+    if (dc->active || dc->nlog > 0)
+        return 0;
+    s->inorder  = dc->inorder;
+    s->prev_rep = dc->prev_rep;
+    if (s->acked < dc->inorder) {
+        // packets still to come may cover delivered ones, keep them
+        s->recovered  = dc->recovered;
+        dc->recovered = NULL;
+    }
+    free_decoder(dc);
+    s->dc = NULL;
+    return 1;
+}
+
+void dec_slot_ack(struct dec_slot *s, int acked)
+{
+    if (acked > s->acked)
+        s->acked = acked;
+    if (s->dc == NULL && s->acked >= s->inorder)
+        free_ring(s);
+}
+
+void dec_slot_free(struct dec_slot *s)
+{
+    if (s->dc != NULL)
+        free_decoder(s->dc);
+    s->dc = NULL;
+    free_ring(s);
+}
+
+int dec_slot_inorder(const struct dec_slot *s)
+{
+    return s->dc != NULL ? s->dc->inorder : s->inorder;
+}
+
+size_t decoder_footprint(const struct decoder *dc)
+{
+    size_t n = sizeof(struct decoder);
+    size_t pktsize = dc->cp->pktsize;
+    if (dc->pbuf != NULL)
+        n += sizeof(struct packet) + pktsize;
+    if (dc->recovered != NULL) {
+        n += (size_t) dc->recvsize * sizeof(GF_ELEMENT *);
+        for (int i=0; i<dc->recvsize; i++) {
+            if (dc->recovered[i] != NULL)
+                n += pktsize;
+        }
+    }
+    // row lengths, and band rows including the scratch coefficient row dwcap
+    if (dc->dwcap > 0)
+        n += (size_t) dc->dwcap * sizeof(int) + (size_t) (dc->dwcap + 1) * dc->cstride + (size_t) dc->dwcap * dc->mstride;
+    n += (size_t) dc->logcap * sizeof(struct gf_op);
+    return n;
+}
+
+size_t dec_slot_footprint(const struct dec_slot *s)
+{
+    size_t n = sizeof(struct dec_slot);
+    if (s->dc != NULL)
+        return n + decoder_footprint(s->dc);
+    if (s->recovered != NULL) {
+        n += (size_t) s->nrecv * sizeof(GF_ELEMENT *);
+        for (int i=0; i<s->nrecv; i++) {
+            if (s->recovered[i] != NULL)
+                n += s->cp->pktsize;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,64 @@
+#ifndef DECSLOT_H
+#define DECSLOT_H
+/*
+ * Low-footprint decoder state for very high flow counts
+ *
+ * A live decoder holds its recovered ring (DEC_ALLOC slots by default), band
+ * storage for the largest decoding window seen and the packet buffer of
+ * deserialize_packet(), i.e., tens of KB or more even while its flow is idle.
+ * A dec_slot holds a flow's decoder only while the flow has a decoding window:
+ *  a) dec_slot_get() creates the decoder on demand, with a recovered ring of
+ *     nrecv slots. It must hold the delivered packets that repair packets may
+ *     still include, i.e., those sent within a feedback round trip
+ *  b) dec_slot_park() frees it once it is inactive, i.e., its window closed
+ *     (after deactivate_decoder(), or as everything was delivered) with no
+ *     pending operation, keeping only what the next decoder needs to continue:
+ *     the in-order id, the id of the previous repair packet and, unless
+ *     dec_slot_ack() told that no packet still to be received covers source
+ *     ids up to the in-order id, the recovered ring, which the next decoder
+ *     takes over
+ *  c) a parked flow costs sizeof(struct dec_slot), plus its ring until
+ *     acknowledged; its next packet re-creates the decoder
+ * The owner calls dec_slot_ack() once the peer encoder flushed up to some
+ * source id and the packets sent before that flush were received (or lost),
+ * e.g., when the first packet sent after the flush arrives over a link that
+ * keeps the order of packets.
+ * When to park is up to the owner, e.g., flows idle since a periodic sweep, as
+ * a decoder whose window keeps opening and closing is better kept live. Decoders
+ * of either coemode are parked, as they take coefficients from the packets and
+ * keep no generator state. Re-created decoders have the default settings
+ * besides the delivery callback, and restart their statistics.
+ */
+#include "streamcodec.h"
+
+#define DEC_SLOT_RECV   64          // default recovered ring of the decoders of a slot
+
+struct dec_slot {
+    struct decoder      *dc;        // NULL while parked
+    struct parameters   *cp;        // must outlive the slot
+    DELIVER_FN          deliver;
+    void                *deliver_arg;
+    int                 nrecv;      // recovered ring of its decoders
+    int                 inorder;    // of the parked decoder
+    int                 prev_rep;
+    GF_ELEMENT          **recovered;// recovered ring of the parked decoder, kept until acknowledged
+    int                 acked;      // source ids up to which no packet to be received refers, see dec_slot_ack()
+};
+
+// deliver is required, as re-created decoders are given it; nrecv is 0 for DEC_SLOT_RECV
+void dec_slot_init(struct dec_slot *s, struct parameters *cp, int nrecv, DELIVER_FN deliver, void *arg);
+// the live decoder, re-created if parked; NULL if it cannot be allocated
+struct decoder *dec_slot_get(struct dec_slot *s);
+// 1 if the slot is (now) parked, 0 if its decoder is still needed
+int dec_slot_park(struct dec_slot *s);
+// no packet still to be received covers source ids up to acked; frees the ring of
+// a parked decoder once acked reaches its in-order id
+void dec_slot_ack(struct dec_slot *s, int acked);
+void dec_slot_free(struct dec_slot *s);
+int dec_slot_inorder(const struct dec_slot *s);
+// Heap bytes of a decoder as far as its public fields tell (context, recovered
+// ring and slots, band storage, operation log, packet buffer), and of a slot
+size_t decoder_footprint(const struct decoder *dc);
+size_t dec_slot_footprint(const struct dec_slot *s);
+
+#endif  // DECSLOT_H
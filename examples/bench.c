@@ -0,0 +1,390 @@
+/*
+ * Reproducible micro- and macro-benchmarks of the codec.
+ *
+ * Micro-benchmarks time individual API calls over an encoding window of a given
+ * width: enqueue_packet, output_repair_packet, output_repair_packets (KBATCH at
+ * a time), output_repair_packet_short (over half of the window), serialize_packet
+ * and deserialize_packet. enqueue_packet_stream enqueues npkts packets into one
+ * long-lived encoder that flushes them `width` packets later, as a sender with
+ * ACKs does, and reports the p99 latency of a single enqueue_packet() call, with
+ * (enqueue_packet_reserved) and without reserve_encoder_buffer() beforehand;
+ * the segmented encoder buffer is not copied when it grows, so the tail stays
+ * close to the median. The macro-benchmark streams packets over a Bernoulli
+ * erasure channel and times receive_packet, with eager and with deferred
+ * (DEC_DEFERRED) elimination, and also reports the payload bytes multiply-added
+ * per delivered packet; in-order feedback is delayed by `width` packets, which
+ * keeps the encoding window around that width.
+ *
+ * Every configuration in the sweep of window width x pktsize x gfpower x erasure
+ * rate uses fixed seeds, so runs are repeatable and comparable across commits.
+ * Results are printed as CSV (default) or JSON, one record per benchmark and
+ * configuration.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o bench bench.c -L.. -lstreamc
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "../streamcodec.h"
+
+#define MAXLIST     16
+#define KBATCH      4               // repair packets per output_repair_packets() call
+#define SEED        20240606        // seed of the codec and of the data/erasure PRNG
+
+struct result {
+    const char  *bench;
+    int         gfpower;
+    int         pktsize;
+    int         width;
+    double      erasure;
+    long        npkts;              // number of packets processed
+    double      seconds;
+    double      madd_per_pkt;       // decoder payload bytes multiply-added per delivered packet
+    double      p99_ns;             // 99th percentile latency of a single call
+};
+
+static int json = 0;
+static int nresults = 0;
+
+char usage[] = "Usage: ./programName [-f csv|json] [-n npkts] [-w widths] [-p pktsizes] [-g gfpowers] [-e erasures]\n\
+                       -f       - output format, csv (default) or json\n\
+                       -n       - number of packets per micro-benchmark (default 10000)\n\
+                       -w       - comma-separated encoding window widths (default 16,64,256)\n\
+                       -p       - comma-separated packet sizes in bytes (default 200,1400)\n\
+                       -g       - comma-separated gfpower values (default 1,8,16)\n\
+                       -e       - comma-separated erasure rates for receive_packet (default 0.1,0.3)\n";
+
+// xorshift64*, so that data and erasures do not depend on the libc rand()
+static uint64_t rng_state;
+
+static void rng_seed(uint64_t seed)
+{
+    rng_state = seed * 0x9E3779B97F4A7C15ULL + 1;
+}
+
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_uniform(void)
+{
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int parse_list(const char *s, double *list)
+{
+    int n = 0;
+    char *end;
+    while (*s && n < MAXLIST) {
+        list[n++] = strtod(s, &end);
+        if (end == s)
+            break;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static void report(struct result *r)
+{
+    double nspp = r->seconds * 1e9 / r->npkts;
+    double mbps = (double) r->npkts * r->pktsize / r->seconds / 1e6;
+    if (json) {
+        printf("%s  {\"bench\": \"%s\", \"gfpower\": %d, \"pktsize\": %d, \"width\": %d, \"erasure\": %.3f, "
+               "\"npkts\": %ld, \"ns_per_pkt\": %.1f, \"MBps\": %.2f, \"madd_per_pkt\": %.0f, \"p99_ns\": %.0f}",
+               nresults ? ",\n" : "", r->bench, r->gfpower, r->pktsize, r->width, r->erasure, r->npkts, nspp, mbps,
+               r->madd_per_pkt, r->p99_ns);
+    } else {
+        printf("%s,%d,%d,%d,%.3f,%ld,%.1f,%.2f,%.0f,%.0f\n",
+               r->bench, r->gfpower, r->pktsize, r->width, r->erasure, r->npkts, nspp, mbps, r->madd_per_pkt,
+               r->p99_ns);
+    }
+    nresults++;
+}
+
+static void init_params(struct parameters *cp, int gfpower, int pktsize)
+{
+    cp->gfpower = gfpower;
+    cp->pktsize = pktsize;
+    cp->repfreq = 0;
+    cp->seed    = SEED;
+    cp->coemode = COE_MT19937;
+}
+
+static unsigned char *random_data(int npkts, int pktsize)
+{
+    unsigned char *buf = malloc((size_t) npkts * pktsize);
+    for (size_t i=0; i<(size_t) npkts*pktsize; i++)
+        buf[i] = rng_next();
+    return buf;
+}
+
+/*
+ * Enqueue and send (uncoded) `width` source packets, so that the encoding window
+ * of the following repair packets is [0, width-1].
+ */
+static struct encoder *window_encoder(struct parameters *cp, unsigned char *data, int width)
+{
+    struct encoder *ec = initialize_encoder(cp, NULL, 0);
+    for (int i=0; i<width; i++) {
+        enqueue_packet(ec, i, data + (size_t) i * cp->pktsize);
+        free_packet(output_source_packet(ec));
+    }
+    return ec;
+}
+
+static void bench_micro(int gfpower, int pktsize, int width, long npkts)
+{
+    struct parameters cp = {0};
+    struct result r = { NULL, gfpower, pktsize, width, 0, npkts, 0, 0, 0 };
+    init_params(&cp, gfpower, pktsize);
+    rng_seed(SEED);
+    unsigned char *data = random_data(width, pktsize);
+    double t;
+
+    // enqueue_packet: fill a fresh encoder with `width` packets at a time
+    struct encoder *ec;
+    r.seconds = 0;
+    for (long i=0; i<npkts; i+=width) {
+        int n = npkts - i < width ? npkts - i : width;
+        ec = initialize_encoder(&cp, NULL, 0);
+        t = now();
+        for (int j=0; j<n; j++)
+            enqueue_packet(ec, j, data + (size_t) j * pktsize);
+        r.seconds += now() - t;
+        free_encoder(ec);
+    }
+    r.bench = "enqueue_packet";
+    report(&r);
+
+    ec = window_encoder(&cp, data, width);
+    struct packet **pkts = malloc(sizeof(struct packet *) * npkts);
+    t = now();
+    for (long i=0; i<npkts; i++)
+        pkts[i] = output_repair_packet(ec);
+    r.seconds = now() - t;
+    r.bench = "output_repair_packet";
+    report(&r);
+
+    // serialize/deserialize the full-window repair packets generated above
+    unsigned char **strs = malloc(sizeof(unsigned char *) * npkts);
+    t = now();
+    for (long i=0; i<npkts; i++)
+        strs[i] = serialize_packet(ec, pkts[i]);
+    r.seconds = now() - t;
+    r.bench = "serialize_packet";
+    report(&r);
+
+    struct decoder *dc = initialize_decoder(&cp);
+    t = now();
+    for (long i=0; i<npkts; i++)
+        deserialize_packet(dc, strs[i]);
+    r.seconds = now() - t;
+    r.bench = "deserialize_packet";
+    report(&r);
+    free_decoder(dc);
+
+    for (long i=0; i<npkts; i++) {
+        free_packet(pkts[i]);
+        free_serialized_packet(strs[i]);
+    }
+
+    t = now();
+    for (long i=0; i<npkts; i+=KBATCH)
+        output_repair_packets(ec, npkts - i < KBATCH ? npkts - i : KBATCH, 0, pkts + i);
+    r.seconds = now() - t;
+    r.bench = "output_repair_packets";
+    report(&r);
+    for (long i=0; i<npkts; i++)
+        free_packet(pkts[i]);
+
+    int ew = width / 2 > 0 ? width / 2 : 1;
+    t = now();
+    for (long i=0; i<npkts; i++)
+        pkts[i] = output_repair_packet_short(ec, ew);
+    r.seconds = now() - t;
+    r.bench = "output_repair_packet_short";
+    report(&r);
+    for (long i=0; i<npkts; i++)
+        free_packet(pkts[i]);
+
+    free(strs);
+    free(pkts);
+    free_encoder(ec);
+    free(data);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Enqueue npkts packets into one encoder, sending each and flushing it width
+ * packets later, and time every enqueue_packet() call on its own.
+ */
+static void bench_enqueue_stream(int gfpower, int pktsize, int width, long npkts, int reserve)
+{
+    struct parameters cp = {0};
+    struct result r = { reserve ? "enqueue_packet_reserved" : "enqueue_packet_stream",
+                        gfpower, pktsize, width, 0, npkts, 0, 0, 0 };
+    init_params(&cp, gfpower, pktsize);
+    rng_seed(SEED);
+    unsigned char *data = random_data(width, pktsize);
+    double *lat = malloc(sizeof(double) * npkts);
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    if (reserve)
+        reserve_encoder_buffer(ec, width + 1);
+    r.seconds = 0;
+    for (long i=0; i<npkts; i++) {
+        double t = now();
+        enqueue_packet(ec, i, data + (size_t) (i % width) * pktsize);
+        lat[i] = now() - t;
+        r.seconds += lat[i];
+        free_packet(output_source_packet(ec));
+        if (i >= width)
+            flush_acked_packets(ec, i - width);
+    }
+    qsort(lat, npkts, sizeof(double), cmp_double);
+    r.p99_ns = lat[(npkts - 1) * 99 / 100] * 1e9;
+    report(&r);
+    free_encoder(ec);
+    free(lat);
+    free(data);
+}
+
+/*
+ * Stream snum source packets over a Bernoulli(erasure) channel with enough
+ * repair packets inserted at fixed intervals, and time deserialize_packet plus
+ * receive_packet of every non-erased packet until all are delivered in order.
+ */
+static void bench_receive(int gfpower, int pktsize, int width, double erasure, int snum, int mode)
+{
+    struct parameters cp = {0};
+    struct result r = { mode == DEC_DEFERRED ? "receive_packet_deferred" : "receive_packet",
+                        gfpower, pktsize, width, erasure, snum, 0, 0, 0 };
+    init_params(&cp, gfpower, pktsize);
+    rng_seed(SEED);
+    unsigned char *data = random_data(snum, pktsize);
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct decoder *dc = initialize_decoder(&cp);
+    set_decoder_mode(dc, mode);
+    int *feedback = malloc(sizeof(int) * width);     // in-order feedback delayed by width packets
+    for (int i=0; i<width; i++)
+        feedback[i] = -1;
+    for (int i=0; i<snum; i++)
+        enqueue_packet(ec, i, data + (size_t) i * pktsize);
+
+    double ratio = erasure / (1 - erasure) + 0.05;     // repair packets per source packet
+    double credit = 0;
+    long slot = 0;
+    double t;
+    r.seconds = 0;
+    while (dc->inorder < snum - 1) {
+        struct packet *pkt;
+        if (ec->nextsid >= snum || (ec->nextsid > ec->headsid && credit >= 1)) {
+            pkt = output_repair_packet(ec);
+            credit -= 1;
+        } else {
+            pkt = output_source_packet(ec);
+            credit += ratio;
+        }
+        unsigned char *pktstr = serialize_packet(ec, pkt);
+        free_packet(pkt);
+        if (rng_uniform() >= erasure) {
+            t = now();
+            struct packet *rpkt = deserialize_packet(dc, pktstr);
+            receive_packet(dc, rpkt);
+            r.seconds += now() - t;
+        }
+        free_serialized_packet(pktstr);
+        int pos = slot++ % width;
+        if (feedback[pos] >= 0)
+            flush_acked_packets(ec, feedback[pos]);
+        feedback[pos] = dc->inorder;
+    }
+    struct decoder_stats st;
+    get_decoder_stats(dc, &st);
+    r.madd_per_pkt = (double) st.madd_bytes / snum;
+    report(&r);
+    free(feedback);
+    free_encoder(ec);
+    free_decoder(dc);
+    free(data);
+}
+
+int main(int argc, char *argv[])
+{
+    double widths[MAXLIST]   = { 16, 64, 256 };
+    double pktsizes[MAXLIST] = { 200, 1400 };
+    double gfpowers[MAXLIST] = { 1, 8, 16 };
+    double erasures[MAXLIST] = { 0.1, 0.3 };
+    int nw = 3, np = 2, ng = 3, ne = 2;
+    long npkts = 10000;
+
+    for (int i=1; i<argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-') {
+            printf("%s\n", usage);
+            exit(1);
+        }
+        const char *v = argv[++i];
+        switch (argv[i-1][1]) {
+        case 'f':
+            json = strcmp(v, "json") == 0;
+            break;
+        case 'n':
+            npkts = atol(v);
+            break;
+        case 'w':
+            nw = parse_list(v, widths);
+            break;
+        case 'p':
+            np = parse_list(v, pktsizes);
+            break;
+        case 'g':
+            ng = parse_list(v, gfpowers);
+            break;
+        case 'e':
+            ne = parse_list(v, erasures);
+            break;
+        default:
+            printf("%s\n", usage);
+            exit(1);
+        }
+    }
+
+    if (json)
+        printf("[\n");
+    else
+        printf("bench,gfpower,pktsize,width,erasure,npkts,ns_per_pkt,MBps,madd_per_pkt,p99_ns\n");
+    for (int g=0; g<ng; g++) {
+        for (int p=0; p<np; p++) {
+            for (int w=0; w<nw; w++) {
+                bench_micro(gfpowers[g], pktsizes[p], widths[w], npkts);
+                bench_enqueue_stream(gfpowers[g], pktsizes[p], widths[w], npkts, 0);
+                bench_enqueue_stream(gfpowers[g], pktsizes[p], widths[w], npkts, 1);
+                for (int e=0; e<ne; e++) {
+                    bench_receive(gfpowers[g], pktsizes[p], widths[w], erasures[e], npkts, DEC_EAGER);
+                    bench_receive(gfpowers[g], pktsizes[p], widths[w], erasures[e], npkts, DEC_DEFERRED);
+                }
+            }
+        }
+    }
+    if (json)
+        printf("\n]\n");
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Replay a dumped decoder trace (see trace.h) through receive_packet().
+ *
+ * A decoder is created with the code parameters recorded in the dump, and every
+ * TRACE_RECEIVE event with its packet still attached is fed through
+ * deserialize_packet() and receive_packet() in the recorded order. Each call is
+ * timed, so slow decodes captured in production can be profiled and
+ * reproduced offline.
+ *
+ * The replay must start from a decoder state it can rebuild: a TRACE_INORDER
+ * event that left no decoding window (c = 1), where the traced decoder held
+ * nothing but the packets delivered up to inorder, so initialize_decoder_at()
+ * recreates it. set_decoder_trace() records one as the first event, from which
+ * a complete trace is replayed. Once the rings wrapped (trace_header.first is
+ * non-zero), that event may be gone: the replay then seeks to the first such
+ * event dumped, skipping the packets received before it, and refuses the dump
+ * if there is none, i.e., if the decoding window never closed since. Repair
+ * packets after the start may still cover packets delivered before it, which
+ * the replay does not hold; receive_packet() rejects them and they are
+ * counted, as decoding may then stall where the traced decoder did not. A
+ * TRACE_RECEIVE whose packet was overwritten in the byte ring breaks the replay
+ * likewise, which then seeks to the next such state.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../streamcodec.h"
+
+#define MAXPKT  65536
+
+char usage[] = "Usage: ./programName tracefile [slow_us]\n\
+                       tracefile - trace dumped by trace_dump() of a decoder\n\
+                       slow_us   - report packets whose receive_packet() takes longer (default 1000)\n";
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    double slow_us = argc > 2 ? atof(argv[2]) : 1000;
+    FILE *fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        perror(argv[1]);
+        exit(1);
+    }
+    struct trace_header th;
+    if (trace_read_header(fp, &th) != 0) {
+        printf("[Replay] %s is not a trace dump of this version\n", argv[1]);
+        exit(1);
+    }
+    struct parameters cp = {0};
+    cp.gfpower = th.gfpower;
+    cp.pktsize = th.pktsize;
+    cp.repfreq = 0;
+    cp.seed    = th.seed;
+    cp.coemode = th.coemode;
+    printf("[Replay] %lu events, gfpower %d pktsize %d seed %d coemode %d\n",
+           (unsigned long) th.nevents, cp.gfpower, cp.pktsize, cp.seed, cp.coemode);
+
+    if (th.first > 0)
+        printf("[Replay] the trace wrapped, %lu events were overwritten\n", (unsigned long) th.first);
+
+    struct decoder *dc = NULL;
+    unsigned char *pktstr = malloc(MAXPKT);
+    struct trace_event ev;
+    long nrecv = 0, nmissing = 0, nslow = 0, nskipped = 0, nbefore = 0;
+    int start = -1, inorder = -1, nstarts = 0;
+    double total = 0, worst = 0;
+    while (trace_read_event(fp, &ev, pktstr, MAXPKT) == 0) {
+        if (dc == NULL) {
+            // seek to a state without decoding window
+            if (ev.type == TRACE_INORDER && ev.c == 1) {
+                start = ev.a;
+                dc = initialize_decoder_at(&cp, start);
+                if (dc == NULL) {
+                    printf("[Replay] cannot allocate the decoder\n");
+                    exit(1);
+                }
+                if (nstarts++ == 0)
+                    printf("[Replay] starting at inorder %d, %ld packets skipped\n", start, nskipped);
+            } else if (ev.type == TRACE_RECEIVE) {
+                nskipped++;
+            }
+            continue;
+        }
+        if (ev.type != TRACE_RECEIVE)
+            continue;
+        if (ev.len == 0) {
+            // packet overwritten in the byte ring before the dump, seek again
+            nmissing++;
+            inorder = dc->inorder;
+            free_decoder(dc);
+            dc = NULL;
+            continue;
+        }
+        double t = now_us();
+        struct packet *rpkt = deserialize_packet(dc, pktstr);
+        if (rpkt == NULL)
+            continue;
+        int sourceid = rpkt->sourceid, repairid = rpkt->repairid, win_s = rpkt->win_s;
+        if (receive_packet(dc, rpkt) < 0 && repairid >= 0 && win_s <= start)
+            nbefore++;              // covers packets delivered before the start
+        t = now_us() - t;
+        total += t;
+        nrecv++;
+        if (t > worst)
+            worst = t;
+        if (t > slow_us) {
+            nslow++;
+            printf("[Replay] packet (sourceid %d, repairid %d) took %.1f us, DW [%d, %d], inorder %d\n",
+                   sourceid, repairid, t, dc->win_s, dc->win_e, dc->inorder);
+        }
+    }
+    if (nstarts == 0) {
+        printf("[Replay] no state without decoding window in the dump, %ld packets cannot be replayed\n", nskipped);
+        free(pktstr);
+        fclose(fp);
+        return 1;
+    }
+    printf("[Summary] replayed %ld packets (%ld not attached), %.1f us in total, %.2f us/packet, worst %.1f us, %ld slow\n",
+           nrecv, nmissing, total, nrecv ? total / nrecv : 0, worst, nslow);
+    printf("[Summary] inorder %d, last started at %d (%d starts), %ld packets skipped, %ld covering packets before a start\n",
+           dc != NULL ? dc->inorder : inorder, start, nstarts, nskipped, nbefore);
+    free(pktstr);
+    if (dc != NULL)
+        free_decoder(dc);
+    fclose(fp);
+    return 0;
+}
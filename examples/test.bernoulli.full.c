@@ -46,9 +46,10 @@ int main(int argc, char *argv[])
     }
     int snum = atoi(argv[1]);
     double arrival = atof(argv[2]);
-    struct parameters cp;
+    struct parameters cp = {0};
     cp.gfpower = 8;
     cp.pktsize = 200;
+    cp.coemode = COE_MT19937;
     cp.repfreq = atof(argv[3]);
     if (cp.repfreq >= 1 && roundf(cp.repfreq) != cp.repfreq) {
         printf("%s\n", usage);
@@ -182,9 +183,9 @@ int main(int argc, char *argv[])
         }
     }
     */
-    int ncheck = ec->snum > DEC_ALLOC ? DEC_ALLOC : ec->snum;
+    int ncheck = ec->snum > dc->recvsize ? dc->recvsize : ec->snum;
     for (int i=ec->snum-1; i>ec->snum-ncheck; i--) {
-        if (memcmp(buf+i*cp.pktsize, dc->recovered[i%DEC_ALLOC], cp.pktsize) !=0) {
+        if (memcmp(buf+i*cp.pktsize, RECOVERED(dc, i), cp.pktsize) !=0) {
             correct = 0;
             printf("[Warning] recovered %d is NOT identical to original.\n", i);
         }
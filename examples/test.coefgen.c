@@ -0,0 +1,93 @@
+/*
+ * Test of the counter-based coefficient generator (coefgen.h).
+ *
+ * philox4x32() must reproduce the known-answer tests of Philox4x32-10 published
+ * with Random123 [1]. coef_batch() must return the same coefficients as
+ * coef_at() for every source id of windows at every alignment modulo four, in
+ * GF(2), GF(2^8) and GF(2^16), including windows ending at INT_MAX, and the
+ * coefficients must be non-zero except in GF(2).
+ *
+ * [1] J. K. Salmon, M. A. Moraes, R. O. Dror and D. E. Shaw, "Parallel random
+ *     numbers: As easy as 1, 2, 3," SC'11.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o coefgen test.coefgen.c -L.. -lstreamc
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../streamcodec.h"
+#include "../coefgen.h"
+
+#define MAXW    300                 // widest window checked
+
+static const struct {
+    uint32_t ctr[4];
+    uint32_t key[2];
+    uint32_t out[4];
+} kat[] = {
+    { { 0x00000000, 0x00000000, 0x00000000, 0x00000000 }, { 0x00000000, 0x00000000 },
+      { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+    { { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }, { 0xffffffff, 0xffffffff },
+      { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+    { { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, { 0xa4093822, 0x299f31d0 },
+      { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+};
+
+int main(int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+    int errors = 0;
+    int nkat = sizeof(kat) / sizeof(kat[0]);
+    for (int i=0; i<nkat; i++) {
+        uint32_t out[4];
+        philox4x32(kat[i].ctr, kat[i].key, out);
+        for (int j=0; j<4; j++) {
+            if (out[j] != kat[i].out[j]) {
+                printf("[Error] Philox4x32-10 KAT %d word %d: %08x, expected %08x\n", i, j, out[j], kat[i].out[j]);
+                errors++;
+            }
+        }
+    }
+
+    int gfpowers[3] = { 1, 8, 16 };
+    int seeds[3] = { 0, 1, -7 };
+    GF_ELEMENT coes[2*MAXW];
+    long nchecked = 0;
+    for (int g=0; g<3; g++) {
+        int gfpower = gfpowers[g];
+        int nb = COEBYTES(gfpower);
+        for (int k=0; k<3; k++) {
+            for (int rid=0; rid<50; rid+=7) {
+                for (int win_s=0; win_s<8; win_s++) {
+                    for (int width=1; width<=MAXW; width+=width<8?1:37) {
+                        // windows at the start and at the end of the id range
+                        int win_e = rid % 2 == 0 ? win_s + 1000 * rid + width - 1 : INT_MAX - win_s;
+                        int s = win_e - width + 1;
+                        coef_batch(seeds[k], rid, s, win_e, gfpower, coes);
+                        for (int j=0; j<width; j++) {
+                            int sid = s + j;
+                            int c = coes[j*nb];
+                            if (nb == 2)
+                                c |= coes[j*nb+1] << 8;
+                            int e = coef_at(seeds[k], rid, sid, gfpower);
+                            if (c != e || (gfpower > 1 && c == 0) || c >= 1 << gfpower) {
+                                if (errors++ < 10)
+                                    printf("[Error] GF(2^%d) seed %d repair %d source %d: coef_batch %d coef_at %d\n",
+                                           gfpower, seeds[k], rid, sid, c, e);
+                            }
+                            nchecked++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (errors == 0)
+        printf("[Summary] Philox4x32-10 matches %d known answers, coef_batch matches coef_at on %ld coefficients\n",
+               nkat, nchecked);
+    printf("[Summary] errors: %d\n", errors);
+    return errors != 0;
+}
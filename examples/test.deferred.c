@@ -0,0 +1,146 @@
+/*
+ * Test of deferred elimination (DEC_DEFERRED) against eager elimination.
+ *
+ * Source packets are streamed over a Bernoulli erasure channel with a repair
+ * packet after every repfreq source packets, and the encoder is flushed every
+ * Tfb slots. Every packet not erased is received by three decoders: one in
+ * DEC_EAGER mode, one in DEC_DEFERRED mode, and one switched between both
+ * modes every period packets, i.e., with pending operations replayed by
+ * set_decoder_mode(). After every packet, receive_packet() must return the
+ * same value and the in-order ids must agree, and the delivery callbacks must
+ * see the same packets in the same order with the same bytes as the data
+ * sent. The payload bytes multiply-added by each decoder, and those of the
+ * operations dropped unapplied as their packet was not innovative, are
+ * reported; every decoder that received a non-innovative packet must have
+ * dropped some. GF(2) (gfpower 1) makes non-innovative repair packets
+ * frequent, e.g., ./deferred 20000 0.1 2 10 37 1.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o deferred test.deferred.c -L.. -lstreamc
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../streamcodec.h"
+
+#define NDEC    3
+
+static struct parameters cp;
+static int expect[NDEC];            // next source id to be delivered by each decoder
+static int errors;
+
+static void fill(unsigned char *buf, int sid)
+{
+    unsigned int x = sid * 2654435761u + 1;
+    for (int i=0; i<cp.pktsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+static void deliver(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    (void) dc;
+    int d = (int) (long) arg;
+    unsigned char buf[cp.pktsize];
+    fill(buf, sourceid);
+    if (sourceid != expect[d] || memcmp(syms, buf, cp.pktsize) != 0) {
+        if (errors++ < 10)
+            printf("[Error] decoder %d delivered source packet %d, %d expected, or its content differs\n",
+                   d, sourceid, expect[d]);
+    }
+    expect[d] = sourceid + 1;
+}
+
+static void send(struct encoder *ec, struct decoder *dc[NDEC], struct packet *pkt, double pe)
+{
+    unsigned char *pktstr = serialize_packet(ec, pkt);
+    free_packet(pkt);
+    if (rand() % 1000 >= pe * 1000) {
+        int ret[NDEC];
+        for (int d=0; d<NDEC; d++)
+            ret[d] = receive_packet(dc[d], deserialize_packet(dc[d], pktstr));
+        for (int d=1; d<NDEC; d++) {
+            if ((ret[d] != ret[0] || dc[d]->inorder != dc[0]->inorder) && errors++ < 10)
+                printf("[Error] decoder %d returned %d with inorder %d, eager returned %d with inorder %d\n",
+                       d, ret[d], dc[d]->inorder, ret[0], dc[0]->inorder);
+        }
+    }
+    free_serialized_packet(pktstr);
+}
+
+char usage[] = "Usage: ./programName snum epsilon repfreq Tfb period [gfpower]\n\
+                       snum     - number of source packets to transmit\n\
+                       epsilon  - erasure probability\n\
+                       repfreq  - a repair packet every repfreq source packets\n\
+                       Tfb      - feedback period in time slots\n\
+                       period   - source packets between mode switches of the third decoder\n\
+                       gfpower  - field GF(2^gfpower), 1, 8 (default) or 16\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 6 && argc != 7) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int snum    = atoi(argv[1]);
+    double pe   = atof(argv[2]);
+    int repfreq = atoi(argv[3]);
+    int Tfb     = atoi(argv[4]);
+    int period  = atoi(argv[5]);
+    cp.gfpower = argc > 6 ? atoi(argv[6]) : 8;
+    cp.pktsize = 512;
+    cp.seed    = 0;
+    cp.coemode = COE_COUNTER;
+    srand(1);
+
+    unsigned char *buf = malloc(cp.pktsize);
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct decoder *dc[NDEC];
+    for (int d=0; d<NDEC; d++) {
+        dc[d] = initialize_decoder(&cp);
+        set_delivery_callback(dc[d], deliver, (void *) (long) d);
+    }
+    set_decoder_mode(dc[1], DEC_DEFERRED);
+
+    int slot = 0, nsent = 0, nswitch = 0;
+    while (dc[0]->inorder < snum - 1) {
+        if (nsent < snum) {
+            fill(buf, nsent);
+            enqueue_packet(ec, nsent, buf);
+            send(ec, dc, output_source_packet(ec), pe);
+            if (++nsent % repfreq == 0)
+                send(ec, dc, output_repair_packet(ec), pe);
+            if (nsent % period == 0) {
+                set_decoder_mode(dc[2], dc[2]->mode == DEC_EAGER ? DEC_DEFERRED : DEC_EAGER);
+                nswitch++;
+            }
+        } else {
+            send(ec, dc, output_repair_packet(ec), pe);
+        }
+        if (++slot % Tfb == 0)
+            flush_acked_packets(ec, dc[0]->inorder);
+    }
+    const char *names[NDEC] = { "eager", "deferred", "switched" };
+    for (int d=0; d<NDEC; d++) {
+        if (expect[d] != snum && errors++ < 10)
+            printf("[Error] decoder %d delivered %d source packets, %d expected\n", d, expect[d], snum);
+        struct decoder_stats st;
+        get_decoder_stats(dc[d], &st);
+        printf("[Summary] %-8s madd_bytes: %llu (%.0f per packet) non-innovative: %llu skipped_bytes: %llu\n",
+               names[d], st.madd_bytes, (double) st.madd_bytes / snum, st.noninnovative, st.skipped_bytes);
+        if (st.noninnovative > 0 && st.skipped_bytes < st.noninnovative * cp.pktsize && errors++ < 10)
+            printf("[Error] decoder %d dropped %llu bytes for %llu non-innovative packets\n",
+                   d, st.skipped_bytes, st.noninnovative);
+        free_decoder(dc[d]);
+    }
+    free_encoder(ec);
+    free(buf);
+
+    if (errors == 0)
+        printf("[Summary] Deferred decoding returns and delivers the same as eager decoding\n");
+    printf("[Summary] snum: %d erasure: %.3f repfreq: %d Tfb: %d gfpower: %d switches: %d errors: %d\n",
+           snum, pe, repfreq, Tfb, cp.gfpower, nswitch, errors);
+    return errors != 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * Test of in-order delivery callbacks and of resizing the recovered ring.
+ *
+ * Source packets are streamed over a Bernoulli erasure channel with a repair
+ * packet after every repfreq source packets, and the encoder is flushed every
+ * Tfb slots with the in-order id of the decoder. The decoder hands out packets
+ * through a delivery callback, which must see every source id exactly once and
+ * in order, with the right content, and with dc->inorder already at its id.
+ * The recovered ring is resized every period packets, alternately shrunk to
+ * small slots and grown to DEC_ALLOC slots: after each resize, the last
+ * min(old, new size) delivered packets must still be readable by RECOVERED(),
+ * and decoding must go on as before. With mode 1 the decoder runs in
+ * DEC_DEFERRED mode, whose pending operations may read delivered packets that
+ * a resize drops; run under, e.g., -fsanitize=address to check that none is
+ * read after it is freed, e.g., with small 4 and period 50.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o delivery test.delivery.c -L.. -lstreamc
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../streamcodec.h"
+
+static struct parameters cp;
+static int expect;                  // next source id to be delivered
+static int errors;
+
+static void fill(unsigned char *buf, int sid)
+{
+    unsigned int x = sid * 2654435761u + 1;
+    for (int i=0; i<cp.pktsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+static void deliver(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    unsigned char *buf = arg;
+    fill(buf, sourceid);
+    if (sourceid != expect || dc->inorder != sourceid || memcmp(syms, buf, cp.pktsize) != 0) {
+        printf("[Error] source packet %d delivered, %d expected\n", sourceid, expect);
+        errors++;
+    }
+    expect = sourceid + 1;
+}
+
+// Check that the last n delivered packets can be read from the ring
+static void check_ring(struct decoder *dc, int n, unsigned char *buf)
+{
+    for (int sid=dc->inorder-n+1; sid<=dc->inorder; sid++) {
+        if (sid < 0)
+            continue;
+        fill(buf, sid);
+        if (RECOVERED(dc, sid) == NULL || memcmp(RECOVERED(dc, sid), buf, cp.pktsize) != 0) {
+            printf("[Error] source packet %d lost by resize_recovered_buffer()\n", sid);
+            errors++;
+        }
+    }
+}
+
+static void send(struct encoder *ec, struct decoder *dc, struct packet *pkt, double pe)
+{
+    unsigned char *pktstr = serialize_packet(ec, pkt);
+    free_packet(pkt);
+    if (rand() % 1000 >= pe * 1000)
+        receive_packet(dc, deserialize_packet(dc, pktstr));
+    free_serialized_packet(pktstr);
+}
+
+char usage[] = "Usage: ./programName snum epsilon repfreq Tfb small period [mode]\n\
+                       snum     - number of source packets to transmit\n\
+                       epsilon  - erasure probability\n\
+                       repfreq  - a repair packet every repfreq source packets\n\
+                       Tfb      - feedback period in time slots\n\
+                       small    - slots of the recovered ring when shrunk\n\
+                       period   - source packets between resizes\n\
+                       mode     - 0 for DEC_EAGER (default), 1 for DEC_DEFERRED\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 7 && argc != 8) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int snum    = atoi(argv[1]);
+    double pe   = atof(argv[2]);
+    int repfreq = atoi(argv[3]);
+    int Tfb     = atoi(argv[4]);
+    int small   = atoi(argv[5]);
+    int period  = atoi(argv[6]);
+    int mode    = argc > 7 ? atoi(argv[7]) : DEC_EAGER;
+    cp.gfpower = 8;
+    cp.pktsize = 200;
+    cp.repfreq = 1.0 / repfreq;
+    cp.seed    = 0;
+    cp.coemode = COE_MT19937;
+    srand(1);
+
+    unsigned char *buf = malloc(cp.pktsize);
+    unsigned char *cbbuf = malloc(cp.pktsize);
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct decoder *dc = initialize_decoder(&cp);
+    set_delivery_callback(dc, deliver, cbbuf);
+    set_decoder_mode(dc, mode);
+
+    int slot = 0, nsent = 0, nresize = 0;
+    while (dc->inorder < snum - 1) {
+        if (nsent < snum) {
+            fill(buf, nsent);
+            enqueue_packet(ec, nsent, buf);
+            send(ec, dc, output_source_packet(ec), pe);
+            nsent++;
+            if (nsent % repfreq == 0)
+                send(ec, dc, output_repair_packet(ec), pe);
+            if (nsent % period == 0) {
+                int nslots = dc->recvsize == small ? DEC_ALLOC : small;
+                int keep = nslots < dc->recvsize ? nslots : dc->recvsize;
+                if (resize_recovered_buffer(dc, nslots) < 0 || dc->recvsize != nslots) {
+                    printf("[Error] resize_recovered_buffer(%d) failed\n", nslots);
+                    errors++;
+                }
+                check_ring(dc, keep, buf);
+                nresize++;
+            }
+        } else {
+            send(ec, dc, output_repair_packet(ec), pe);
+        }
+        if (++slot % Tfb == 0)
+            flush_acked_packets(ec, dc->inorder);
+    }
+    if (expect != snum) {
+        printf("[Error] %d source packets delivered, %d expected\n", expect, snum);
+        errors++;
+    }
+    if (resize_recovered_buffer(dc, 0) == 0) {
+        printf("[Error] resize_recovered_buffer(0) succeeded\n");
+        errors++;
+    }
+    free_encoder(ec);
+    free_decoder(dc);
+    free(buf);
+    free(cbbuf);
+
+    if (errors == 0)
+        printf("[Summary] All source packets are delivered in order exactly once, and kept across resizes\n");
+    printf("[Summary] snum: %d erasure: %.3f repfreq: %d Tfb: %d resizes: %d errors: %d\n",
+           snum, pe, repfreq, Tfb, nresize, errors);
+    return errors != 0;
+}
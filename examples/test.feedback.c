@@ -0,0 +1,206 @@
+/*
+ * Test repair driven by decoder feedback over a long-delay link with Bernoulli
+ * packet loss.
+ *
+ * Source packets are sent once each. Every Tfb time slots the decoder sends a
+ * serialized feedback summary (in-order id, decoding window, rank deficit and
+ * missing runs), which reaches the encoder Tp slots later over a lossless
+ * return channel. The encoder answers with as many repair packets as the rank
+ * deficit, sent ahead of new source packets, and ignores further feedback for
+ * a round trip, as it would only report losses already being repaired. With
+ * mode 1 the repair packets cover only the span of the missing runs
+ * (output_targeted_repairs()), with mode 0 the full EW (output_repair_packet()),
+ * for comparison of the encoding work.
+ *
+ * Beforehand, targeted repair is checked on a fixed loss pattern: with source
+ * packets 3, 4 and 9 of 16 lost, the feedback must report runs [3, 4] and
+ * [9, 9] with a deficit of 3, and output_targeted_repairs() must return 3
+ * repair packets over exactly [3, 9], which recover the lost packets.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../streamcodec.h"
+#include "../wireformat.h"
+
+#define MAXREP  1024
+
+char usage[] = "Usage: ./programName snum epsilon Tp Tfb mode\n\
+                       snum     - number of source packets to transmit\n\
+                       epsilon  - erasure probability of the forward link\n\
+                       Tp       - propagation delay of channel, in both directions\n\
+                       Tfb      - feedback period in time slots\n\
+                       mode     - 1: targeted repair of the missing span, 0: full-EW repair\n";
+// Targeted repair of a fixed loss pattern; returns 1 if correct
+static int check_targeted(struct parameters *cp)
+{
+    struct encoder *ec = initialize_encoder(cp, NULL, 0);
+    struct decoder *dc = initialize_decoder(cp);
+    unsigned char *data = malloc(16 * cp->pktsize);
+    for (int i=0; i<16*cp->pktsize; i++)
+        data[i] = rand() % 256;
+    for (int i=0; i<16; i++) {
+        enqueue_packet(ec, i, data+i*cp->pktsize);
+        struct packet *pkt = output_source_packet(ec);
+        if (i != 3 && i != 4 && i != 9) {
+            unsigned char *pktstr = serialize_packet(ec, pkt);
+            receive_packet(dc, deserialize_packet(dc, pktstr));
+            free_serialized_packet(pktstr);
+        }
+        free_packet(pkt);
+    }
+    struct dec_feedback fb;
+    get_decoder_feedback(dc, &fb);
+    int ok = fb.inorder == 2 && fb.deficit == 3 && fb.nruns == 2 && fb.runs[0][0] == 3
+             && fb.runs[0][1] == 2 && fb.runs[1][0] == 9 && fb.runs[1][1] == 1;
+    struct packet *pkts[4];
+    int n = output_targeted_repairs(ec, &fb, pkts, 4);
+    ok = ok && n == 3;
+    for (int i=0; i<n; i++) {
+        ok = ok && pkts[i]->win_s == 3 && pkts[i]->win_e == 9;
+        unsigned char *pktstr = serialize_packet(ec, pkts[i]);
+        receive_packet(dc, deserialize_packet(dc, pktstr));
+        free_serialized_packet(pktstr);
+        free_packet(pkts[i]);
+    }
+    ok = ok && dc->inorder == 15;
+    for (int i=0; ok && i<16; i++)
+        ok = memcmp(RECOVERED(dc, i), data+i*cp->pktsize, cp->pktsize) == 0;
+    if (!ok)
+        printf("[Warning] targeted repair of source packets 3, 4 and 9 failed\n");
+    free(data);
+    free_encoder(ec);
+    free_decoder(dc);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 6) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int snum = atoi(argv[1]);
+    double pe = atof(argv[2]);
+    int T_P = atoi(argv[3]);
+    int T_FB = atoi(argv[4]);
+    int targeted = atoi(argv[5]);
+    struct parameters cp = {0};
+    cp.gfpower = 8;
+    cp.pktsize = 200;
+    cp.repfreq = 0;
+    cp.seed    = 1;
+    cp.coemode = COE_COUNTER;
+    srand(1);
+    int correct = check_targeted(&cp);
+
+    unsigned char *buf = malloc(snum * cp.pktsize);
+    for (int i=0; i<snum*cp.pktsize; i++)
+        buf[i] = rand() % 256;
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct decoder *dc = initialize_decoder(&cp);
+    for (int i=0; i<snum; i++)
+        enqueue_packet(ec, i, buf+i*cp.pktsize);
+
+    unsigned char **queue = calloc(T_P+1, sizeof(unsigned char *));     // forward link
+    unsigned char (*fbq)[WIRE_MAXFB] = calloc(T_P+1, WIRE_MAXFB);        // return link
+    int *fblen = calloc(T_P+1, sizeof(int));
+    struct packet *repairs[MAXREP];
+    int nrep = 0, quiet_until = -1;
+    long nuse = 0, nrepair = 0, ewsum = 0, fbbytes = 0;
+    int slot;
+    for (slot=0; dc->inorder < snum-1; slot++) {
+        int pos = slot % (T_P+1);       // sent now, received T_P slots later
+        // the encoder: feedback arriving now, then one packet
+        if (fblen[pos] > 0) {
+            struct dec_feedback fb;
+            if (deserialize_feedback(fbq[pos], fblen[pos], &fb) > 0) {
+                if (fb.inorder >= ec->headsid)
+                    flush_acked_packets(ec, fb.inorder);
+                int tail_s = fb.win_e > fb.inorder ? fb.win_e + 1 : fb.inorder + 1;
+                if (slot >= quiet_until && nrep == 0 && fb.deficit > 0) {
+                    if (targeted) {
+                        nrep = output_targeted_repairs(ec, &fb, repairs, MAXREP);
+                        int span_e = fb.runs[fb.nruns-1][0] + fb.runs[fb.nruns-1][1] - 1;
+                        for (int i=0; i<nrep; i++) {
+                            if (repairs[i]->win_s != fb.runs[0][0] || repairs[i]->win_e != span_e) {
+                                printf("[Warning] targeted repair over [%d, %d], missing span [%d, %d]\n",
+                                       repairs[i]->win_s, repairs[i]->win_e, fb.runs[0][0], span_e);
+                                correct = 0;
+                            }
+                        }
+                        if (nrep != (fb.deficit < MAXREP ? fb.deficit : MAXREP))
+                            correct = 0;
+                    } else {
+                        for (nrep=0; nrep<fb.deficit && nrep<MAXREP; nrep++)
+                            repairs[nrep] = output_repair_packet(ec);
+                    }
+                    quiet_until = slot + 2 * T_P + 1;
+                } else if (slot >= quiet_until && nrep == 0 && ec->nextsid == snum && tail_s < snum) {
+                    // packets sent after the DW are neither reported received nor missing;
+                    // once all are sent and a round trip has passed, they were lost
+                    repairs[0] = targeted ? output_repair_packet_range(ec, tail_s, snum-1) : output_repair_packet(ec);
+                    nrep = repairs[0] != NULL;
+                    quiet_until = slot + 2 * T_P + 1;
+                }
+            }
+            fblen[pos] = 0;
+        }
+        struct packet *pkt = NULL;
+        if (nrep > 0) {
+            pkt = repairs[0];
+            memmove(repairs, repairs+1, sizeof(struct packet *) * --nrep);
+            nrepair++;
+            ewsum += pkt->win_e - pkt->win_s + 1;
+        } else if (ec->nextsid < snum) {
+            pkt = output_source_packet(ec);
+        }
+        free(queue[pos]);
+        queue[pos] = NULL;
+        if (pkt != NULL) {
+            nuse++;
+            if (rand() % 10000000 >= pe * 10000000)
+                queue[pos] = serialize_packet(ec, pkt);
+            free_packet(pkt);
+        }
+        // the decoder: packet sent T_P slots ago, then feedback
+        int rpos = (slot + 1) % (T_P+1);    // == (slot - T_P) % (T_P+1)
+        if (slot >= T_P && queue[rpos] != NULL) {
+            receive_packet(dc, deserialize_packet(dc, queue[rpos]));
+            free(queue[rpos]);
+            queue[rpos] = NULL;
+        }
+        if (slot % T_FB == 0) {
+            struct dec_feedback fb;
+            get_decoder_feedback(dc, &fb);
+            int fpos = (slot + T_P) % (T_P+1);     // read by the encoder T_P slots later
+            fblen[fpos] = serialize_feedback(&fb, fbq[fpos], WIRE_MAXFB);
+            fbbytes += fblen[fpos];
+        }
+    }
+
+    int ncheck = snum > dc->recvsize ? dc->recvsize : snum;
+    for (int i=snum-1; i>snum-1-ncheck; i--) {
+        if (memcmp(buf+i*cp.pktsize, RECOVERED(dc, i), cp.pktsize) != 0) {
+            correct = 0;
+            printf("[Warning] recovered %d is NOT identical to original.\n", i);
+        }
+    }
+    if (correct)
+        printf("[Summary] All source packets are recovered correctly\n");
+    printf("[Summary] mode: %s snum: %d erasure: %.3f Tp: %d Tfb: %d slots: %d nuses: %ld\n",
+           targeted ? "targeted" : "full-EW", snum, pe, T_P, T_FB, slot, nuse);
+    printf("[Summary] repair packets: %ld, mean EW width %.1f, feedback bytes %ld\n",
+           nrepair, nrepair ? (double) ewsum / nrepair : 0, fbbytes);
+    for (int i=0; i<nrep; i++)
+        free_packet(repairs[i]);
+    for (int i=0; i<=T_P; i++)
+        free(queue[i]);
+    free(queue);
+    free(fbq);
+    free(fblen);
+    free_encoder(ec);
+    free_decoder(dc);
+    free(buf);
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+/*
+ * Loopback test of the sharded multi-flow engine of flowengine.h.
+ *
+ * nflows flows are opened on the engine, and each sends npkts source packets
+ * plus a repair packet after every repfreq source packets through its encoder.
+ * Serialized packets not erased by a Bernoulli channel are fed back to the
+ * decoder of the same flow, whose in-order feedback flushes the encoder. Once
+ * a flow has no request in flight after such a flush, no packet still to be
+ * received covers the flushed ids, which FE_FLUSHED tells its decoder. Every
+ * delivered packet is checked against the data sent, and the aggregate coded
+ * throughput is reported, e.g., to compare different numbers of workers.
+ * Finally, an engine is destroyed while its worker waits on a full completion
+ * queue with FE_DELIVER copies pending; run under, e.g., -fsanitize=address
+ * to check that none of them leaks.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o flowengine test.flowengine.c ../flowengine.c -L.. -lstreamc -lpthread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../flowengine.h"
+
+#define QSIZE   4096
+#define BATCH   256
+
+struct flow_state {
+    int     nsent;                  // source packets submitted
+    int     ndeli;                  // packets delivered in order
+    int     inflight;               // requests whose completion has not been returned
+    int     acked;                  // last in-order feedback submitted
+    int     flushed;                // encoder flushed up to it (FE_ACK completed)
+    int     released;               // last FE_FLUSHED submitted
+};
+
+char usage[] = "Usage: ./programName nflows npkts pktsize repfreq epsilon nworkers [pin]\n\
+                       nflows   - number of concurrent flows\n\
+                       npkts    - number of source packets per flow\n\
+                       pktsize  - bytes per packet\n\
+                       repfreq  - send a repair packet after every repfreq source packets\n\
+                       epsilon  - erasure probability of the loopback channel\n\
+                       nworkers - number of worker threads, 0: one per CPU\n\
+                       pin      - 1 to pin workers to cores (default 0)\n";
+
+static struct flow_engine *fe;
+static struct fe_req *pending;      // requests not yet accepted by the engine
+static int npending, cappending;
+static struct flow_state *flows;
+static struct parameters cp;
+static int outcap;
+
+static void fill(unsigned char *buf, int flow, int sid)
+{
+    unsigned int x = flow * 2654435761u + sid * 40503u + 1;
+    for (int i=0; i<cp.pktsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+static void submit(int flow, int op, unsigned char *data, int len, int arg)
+{
+    if (npending == cappending) {
+        cappending = cappending ? cappending * 2 : 1024;
+        pending = realloc(pending, sizeof(struct fe_req) * cappending);
+    }
+    struct fe_req *r = &pending[npending++];
+    memset(r, 0, sizeof(struct fe_req));
+    r->flow = flow;
+    r->op   = op;
+    r->data = data;
+    r->len  = len;
+    r->arg  = arg;
+    if (op == FE_SEND || op == FE_REPAIR) {
+        r->out    = malloc(outcap);
+        r->outcap = outcap;
+    }
+    flows[flow].inflight++;
+}
+
+static void flush_pending(void)
+{
+    int n = fe_submit(fe, pending, npending);
+    memmove(pending, pending + n, sizeof(struct fe_req) * (npending - n));
+    npending -= n;
+}
+
+// Destroy an engine whose worker blocks on a full completion queue, with
+// delivered packets both queued and not yet queued
+static void check_shutdown(void)
+{
+    struct flow_engine *sfe = fe_create(1, 4, 0);
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct fe_req req = { 0, FE_OPEN, (unsigned char *) &cp, sizeof(cp), NULL, 0, 0, 0 };
+    fe_submit(sfe, &req, 1);
+    unsigned char *pkts[4], *data = malloc(cp.pktsize);
+    for (int i=0; i<4; i++) {
+        fill(data, 0, i);
+        enqueue_packet(ec, i, data);
+        pkts[i] = malloc(outcap);
+        req.op   = FE_RECEIVE;
+        req.data = pkts[i];
+        req.len  = output_source_packet_into(ec, pkts[i], outcap);
+        while (fe_submit(sfe, &req, 1) == 0)
+            ;
+    }
+    struct timespec ts = { 0, 20000000 };
+    nanosleep(&ts, NULL);
+    fe_destroy(sfe);
+    for (int i=0; i<4; i++)
+        free(pkts[i]);
+    free(data);
+    free_encoder(ec);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 7) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int nflows   = atoi(argv[1]);
+    int npkts    = atoi(argv[2]);
+    cp.gfpower   = 8;
+    cp.pktsize   = atoi(argv[3]);
+    cp.repfreq   = atoi(argv[4]);
+    cp.seed      = 0;
+    double pe    = atof(argv[5]);
+    int nworkers = atoi(argv[6]);
+    int pin      = argc > 7 ? atoi(argv[7]) : 0;
+    int repfreq  = cp.repfreq >= 1 ? cp.repfreq : 1;
+    outcap = 4 * sizeof(int) + 2 * npkts + cp.pktsize + 64;
+    srand(1);
+
+    fe = fe_create(nworkers, QSIZE, pin);
+    flows = calloc(nflows, sizeof(struct flow_state));
+    for (int f=0; f<nflows; f++) {
+        flows[f].acked = flows[f].flushed = flows[f].released = -1;
+        submit(f, FE_OPEN, (unsigned char *) &cp, sizeof(cp), 0);
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    struct fe_cpl *cpls = malloc(sizeof(struct fe_cpl) * BATCH);
+    unsigned char *expect = malloc(cp.pktsize);
+    long ndone = 0, ncoded = 0, nerrors = 0;
+    int next = 0;
+    while (ndone < nflows) {
+        // keep a bounded number of source packets of each flow in flight
+        for (int k=0; k<nflows && npending<QSIZE; k++, next=(next+1)%nflows) {
+            struct flow_state *fs = &flows[next];
+            if (fs->nsent < npkts && fs->inflight < 8) {
+                unsigned char *data = malloc(cp.pktsize);
+                fill(data, next, fs->nsent);
+                submit(next, FE_SEND, data, cp.pktsize, 0);
+                if (++fs->nsent % repfreq == 0)
+                    submit(next, FE_REPAIR, NULL, 0, 0);
+            } else if (fs->nsent == npkts && fs->ndeli < npkts && fs->inflight == 0) {
+                submit(next, FE_REPAIR, NULL, 0, 0);       // tail of the flow: repair until delivered
+            }
+        }
+        flush_pending();
+        int n = fe_complete(fe, cpls, BATCH);
+        for (int i=0; i<n; i++) {
+            struct fe_cpl *c = &cpls[i];
+            struct flow_state *fs = &flows[c->flow];
+            if (c->op != FE_DELIVER)
+                fs->inflight--;
+            switch (c->op) {
+            case FE_SEND:
+            case FE_REPAIR:
+                if (c->op == FE_SEND)
+                    free(c->data);
+                if (c->status == 0 && (double) rand() / RAND_MAX >= pe) {
+                    ncoded++;
+                    submit(c->flow, FE_RECEIVE, c->out, c->len, 0);
+                } else {
+                    free(c->out);
+                }
+                break;
+            case FE_RECEIVE:
+                free(c->data);
+                if (c->sourceid > fs->acked) {
+                    fs->acked = c->sourceid;
+                    submit(c->flow, FE_ACK, NULL, 0, c->sourceid);
+                    pending[npending-1].tag = c->sourceid;
+                }
+                break;
+            case FE_ACK:
+                if ((int) c->tag > fs->flushed)
+                    fs->flushed = c->tag;
+                break;
+            case FE_DELIVER:
+                fill(expect, c->flow, fs->ndeli);
+                if (c->status != 0 || c->sourceid != fs->ndeli || memcmp(c->data, expect, cp.pktsize) != 0) {
+                    nerrors++;
+                    printf("[Warning] flow %u delivered packet %d while expecting %d, or its content differs\n",
+                           c->flow, c->sourceid, fs->ndeli);
+                }
+                free(c->data);
+                if (++fs->ndeli == npkts)
+                    ndone++;
+                break;
+            case FE_OPEN:
+                if (c->status != 0) {
+                    printf("[Warning] failed to open flow %u\n", c->flow);
+                    exit(1);
+                }
+                break;
+            default:
+                break;
+            }
+            // packets sent before the flush are all received or lost
+            if (fs->inflight == 0 && fs->flushed > fs->released) {
+                fs->released = fs->flushed;
+                submit(c->flow, FE_FLUSHED, NULL, 0, fs->flushed);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+    for (int f=0; f<nflows; f++)
+        submit(f, FE_CLOSE, NULL, 0, 0);
+    for (int closed=0; closed<nflows; ) {
+        flush_pending();
+        int n = fe_complete(fe, cpls, BATCH);
+        for (int i=0; i<n; i++) {
+            if (cpls[i].op == FE_CLOSE)
+                closed++;
+            else if (cpls[i].op == FE_RECEIVE || cpls[i].op == FE_DELIVER)
+                free(cpls[i].data);
+            else
+                free(cpls[i].out);
+        }
+    }
+    if (nerrors == 0)
+        printf("[Summary] All source packets of %d flows are delivered in order correctly\n", nflows);
+    printf("[Summary] workers: %d flows: %d npkts: %d pktsize: %d erasure: %.3f\n",
+           fe_nworkers(fe), nflows, npkts, cp.pktsize, pe);
+    printf("[Summary] %.3f seconds, %.0f source packets/s, %.0f coded packets received/s, %.1f MB/s delivered\n",
+           seconds, (double) nflows * npkts / seconds, ncoded / seconds, (double) nflows * npkts * cp.pktsize / seconds / 1e6);
+    fe_destroy(fe);
+    check_shutdown();
+    free(expect);
+    free(cpls);
+    free(pending);
+    free(flows);
+    return nerrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/*
+ * Measure the per-flow decoder footprint of many flows with dec_slot (see
+ * decslot.h) under a mix of idle and bursty flows.
+ *
+ * Each round, an idle flow receives one in-order source packet with
+ * probability pidle, and a bursty flow with probability pburst receives a burst
+ * of source packets over an erasure channel, with a full-EW repair packet
+ * after every repfreq of them. Repair packets and feedback are delayed until
+ * the next burst of the flow: it first receives the repair packets of its
+ * previous burst, then its encoder is flushed up to the in-order id reported
+ * at the end of that burst, after which no packet still to be received refers
+ * to those source ids (dec_slot_ack()). Delayed repair packets therefore
+ * often cover packets delivered before the decoder was parked. After each
+ * round, the decoders of flows that received nothing are parked, as in the
+ * sweep of the flow engine; at the end, bursty flows are repaired until all
+ * their packets are delivered. The codes use the default COE_MT19937
+ * coefficients, which repair packets carry, so the decoders keep no generator
+ * state and are parked like COE_COUNTER ones.
+ *
+ * Payloads are pseudo-random per flow and source id, and every delivered
+ * packet is compared with the data sent. Reported are the mean and peak
+ * footprint per flow, against a default decoder per flow, the recovered rings
+ * kept by parked flows, the repair packets reaching back further than the ring
+ * of DEC_SLOT_RECV slots (after a decoder stalled for several bursts), and
+ * whether every flow got its packets delivered in order with the right content
+ * and no other packet rejected.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../streamcodec.h"
+#include "../decslot.h"
+
+struct flow {
+    int             id;
+    struct dec_slot ds;
+    struct encoder  *ec;            // bursty flows only
+    struct packet   **pend;         // repair packets of the last burst, received with the next
+    int             npend;
+    int             acked;          // in-order id reported at the end of the last burst
+    int             nextsid;        // idle flows: next source id to send
+    int             expect;         // next source id to be delivered
+    int             errors;
+    int             recent;
+};
+
+static struct parameters cp;
+static unsigned char *expectbuf;
+static long nrejected, nbeyond;
+
+static void fill(unsigned char *buf, int flow, int sid)
+{
+    unsigned int x = (flow * 40503u + sid) * 2654435761u + 1;
+    for (int i=0; i<cp.pktsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+static void deliver(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    struct flow *f = arg;
+    (void) dc;
+    fill(expectbuf, f->id, sourceid);
+    if (sourceid != f->expect || memcmp(syms, expectbuf, cp.pktsize) != 0)
+        f->errors++;
+    f->expect = sourceid + 1;
+}
+
+// Packets rejected as they cover delivered packets further back than the ring
+// reaches are counted apart, as the ring is too short for that flow, see a) of
+// decslot.h; any other rejection is an error
+static void receive(struct flow *f, struct packet *pkt)
+{
+    int inorder = dec_slot_inorder(&f->ds);
+    if (receive_packet(dec_slot_get(&f->ds), pkt) < 0) {
+        if (pkt->win_s <= inorder - f->ds.nrecv)
+            nbeyond++;
+        else
+            nrejected++;
+    }
+}
+
+// Receive the delayed repair packets of the last burst, then apply its feedback
+static void catch_up(struct flow *f)
+{
+    for (int i=0; i<f->npend; i++) {
+        receive(f, f->pend[i]);
+        free_packet(f->pend[i]);
+    }
+    f->npend = 0;
+    flush_acked_packets(f->ec, f->acked);
+    dec_slot_ack(&f->ds, f->acked);
+}
+
+char usage[] = "Usage: ./programName nflows fbursty rounds pidle pburst burst epsilon repfreq\n\
+                       nflows   - number of flows\n\
+                       fbursty  - fraction of bursty flows\n\
+                       rounds   - number of rounds\n\
+                       pidle    - probability of an idle flow receiving a packet in a round\n\
+                       pburst   - probability of a bursty flow receiving a burst in a round\n\
+                       burst    - source packets per burst\n\
+                       epsilon  - erasure probability of bursts\n\
+                       repfreq  - a repair packet every repfreq source packets of a burst\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 9) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int nflows = atoi(argv[1]);
+    double fbursty = atof(argv[2]);
+    int rounds = atoi(argv[3]);
+    double pidle = atof(argv[4]);
+    double pburst = atof(argv[5]);
+    int burst = atoi(argv[6]);
+    double pe = atof(argv[7]);
+    int repfreq = atoi(argv[8]);
+    cp.gfpower = 8;
+    cp.pktsize = 200;
+    cp.repfreq = 0;
+    cp.seed    = 1;
+    srand(1);
+
+    struct decoder *ref = initialize_decoder(&cp);
+    size_t deflt = decoder_footprint(ref);
+    free_decoder(ref);
+
+    unsigned char *syms = malloc(cp.pktsize);
+    expectbuf = malloc(cp.pktsize);
+    struct flow *flows = calloc(nflows, sizeof(struct flow));
+    int nbursty = nflows * fbursty;
+    for (int i=0; i<nflows; i++) {
+        flows[i].id = i;
+        flows[i].acked = -1;
+        dec_slot_init(&flows[i].ds, &cp, 0, deliver, &flows[i]);
+        if (i < nbursty) {
+            flows[i].ec = initialize_encoder(&cp, NULL, 0);
+            flows[i].pend = malloc(sizeof(struct packet *) * (burst / repfreq + 1));
+        }
+    }
+    double meanfp = 0, meanlive = 0, meanrings = 0;
+    size_t peakfp = 0;
+    long npkts = 0;
+    for (int r=0; r<rounds; r++) {
+        for (int i=0; i<nflows; i++) {
+            struct flow *f = &flows[i];
+            if (f->ec == NULL) {
+                if (rand() % 10000 >= pidle * 10000)
+                    continue;
+                fill(syms, f->id, f->nextsid);
+                struct packet pkt = { f->nextsid, -1, -1, -1, NULL, syms };
+                receive(f, &pkt);
+                dec_slot_ack(&f->ds, f->nextsid++);     // source packets only, nothing refers back
+                f->recent = 1;
+                npkts++;
+                continue;
+            }
+            if (rand() % 10000 >= pburst * 10000)
+                continue;
+            catch_up(f);
+            for (int k=0; k<burst; k++) {
+                int sid = f->ec->snum;
+                fill(syms, f->id, sid);
+                enqueue_packet(f->ec, sid, syms);
+                struct packet *pkt = output_source_packet(f->ec);
+                if (rand() % 10000 >= pe * 10000)
+                    receive(f, pkt);
+                free_packet(pkt);
+                if (k % repfreq == repfreq - 1) {
+                    pkt = output_repair_packet(f->ec);
+                    if (rand() % 10000 >= pe * 10000)
+                        f->pend[f->npend++] = pkt;
+                    else
+                        free_packet(pkt);
+                }
+                npkts++;
+            }
+            f->acked = dec_slot_inorder(&f->ds);
+            f->recent = 1;
+        }
+        // footprint at the end of the round, before the sweep
+        size_t total = 0;
+        int live = 0, rings = 0;
+        for (int i=0; i<nflows; i++) {
+            total += dec_slot_footprint(&flows[i].ds);
+            live += flows[i].ds.dc != NULL;
+            rings += flows[i].ds.dc == NULL && flows[i].ds.recovered != NULL;
+        }
+        meanfp += (double) total / nflows / rounds;
+        meanlive += (double) live / rounds;
+        meanrings += (double) rings / rounds;
+        if (total > peakfp)
+            peakfp = total;
+        for (int i=0; i<nflows; i++) {
+            if (!flows[i].recent)
+                dec_slot_park(&flows[i].ds);
+            flows[i].recent = 0;
+        }
+    }
+    // repair the bursty flows to the end, without loss and with immediate feedback
+    for (int i=0; i<nbursty; i++) {
+        struct flow *f = &flows[i];
+        catch_up(f);
+        f->acked = dec_slot_inorder(&f->ds);
+        flush_acked_packets(f->ec, f->acked);
+        dec_slot_ack(&f->ds, f->acked);
+        long rejected = nrejected;
+        while (dec_slot_inorder(&f->ds) < f->ec->snum - 1 && nrejected == rejected) {
+            struct packet *pkt = output_repair_packet(f->ec);
+            receive(f, pkt);
+            free_packet(pkt);
+        }
+    }
+
+    int errors = 0;
+    for (int i=0; i<nflows; i++) {
+        struct flow *f = &flows[i];
+        int sent = f->ec != NULL ? f->ec->snum : f->nextsid;
+        errors += f->errors + (f->expect != sent);
+    }
+    if (errors == 0 && nrejected == 0)
+        printf("[Summary] All source packets are delivered in order and correctly, none rejected\n");
+    else
+        printf("[Warning] %d delivery errors, %ld packets rejected\n", errors, nrejected);
+    printf("[Summary] flows: %d bursty: %d rounds: %d packets: %ld covering more than the ring: %ld\n",
+           nflows, nbursty, rounds, npkts, nbeyond);
+    printf("[Summary] default decoder: %zu bytes per flow, %.1f MB for all flows\n",
+           deflt, (double) deflt * nflows / 1e6);
+    printf("[Summary] dec_slot: mean %.0f bytes per flow (%.1f live decoders, %.1f parked rings), peak %.1f MB, parked flow %zu bytes\n",
+           meanfp, meanlive, meanrings, (double) peakfp / 1e6, sizeof(struct dec_slot));
+    for (int i=0; i<nflows; i++) {
+        dec_slot_free(&flows[i].ds);
+        if (flows[i].ec != NULL)
+            free_encoder(flows[i].ec);
+        for (int j=0; j<flows[i].npend; j++)
+            free_packet(flows[i].pend[j]);
+        free(flows[i].pend);
+    }
+    free(flows);
+    free(syms);
+    free(expectbuf);
+    return errors == 0 && nrejected == 0 ? 0 : 1;
+}
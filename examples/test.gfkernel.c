@@ -0,0 +1,146 @@
+/*
+ * Cross-check the vectorized region kernels against the scalar kernel of the
+ * same field, for GF(2), GF(2^8) and GF(2^16). Every kernel supported by the
+ * running CPU is run over random lengths, alignments and coefficients, and its
+ * output must be byte-identical to that of the scalar kernel. Sequences of row
+ * operations run in parallel column stripes by gfpool.h must also be identical
+ * to their serial application.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../gfkernel.h"
+#include "../gfpool.h"
+
+#define MAXLEN  4096
+#define NROWS   8
+#define ROWLEN  65536
+
+char usage[] = "Usage: ./programName ntrials seed\n\
+                       ntrials  - number of random trials per kernel\n\
+                       seed     - seed of the PRNG\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int ntrials = atoi(argv[1]);
+    srand(atoi(argv[2]));
+
+    static const int fields[] = { 1, 8, 16 };
+    GF_ELEMENT *src  = malloc(MAXLEN + 64);
+    GF_ELEMENT *dst0 = malloc(MAXLEN + 64);
+    GF_ELEMENT *dst1 = malloc(MAXLEN + 64);
+    int correct = 1;
+    for (int f=0; f<3; f++) {
+        int gfpower = fields[f];
+        int qmask = (1 << gfpower) - 1;                 // coefficients are in [0, 2^gfpower-1]
+        const struct gf_kernel *ref = gf_get_kernel(gfpower, GF_KERNEL_SCALAR);
+        printf("[Summary] GF(2^%d) selected kernel: %s\n", gfpower, gf_select_kernel(gfpower)->name);
+        for (int k=0; k<GF_KERNEL_NUM; k++) {
+            const struct gf_kernel *gk = gf_get_kernel(gfpower, k);
+            if (gk == NULL || gk == ref)
+                continue;
+            int nerr = 0;
+            for (int t=0; t<ntrials; t++) {
+                // small lengths exercise the tails, large ones the vector loops
+                int len = t % 2 ? rand() % 130 : rand() % MAXLEN;
+                int soff = rand() % 64;
+                int doff = rand() % 64;
+                int c = t <= qmask ? t : rand() & qmask;
+                if (gfpower == 16)
+                    len &= ~1;
+                for (int i=0; i<MAXLEN+64; i++) {
+                    src[i]  = rand() % 256;
+                    dst0[i] = dst1[i] = rand() % 256;
+                }
+                ref->madd(dst0 + doff, src + soff, c, len);
+                gk->madd(dst1 + doff, src + soff, c, len);
+                if (memcmp(dst0, dst1, MAXLEN + 64) != 0) {
+                    nerr++;
+                    printf("[Warning] kernel %s differs from scalar: len %d soff %d doff %d c %d\n", gk->name, len, soff, doff, c);
+                }
+            }
+            printf("[Summary] kernel %s: %d trials, %d mismatches\n", gk->name, ntrials, nerr);
+            if (nerr)
+                correct = 0;
+        }
+        // element arithmetic sanity: c * (1/c) == 1, and (a*b)/b == a
+        for (int t=0; t<ntrials; t++) {
+            int a = rand() & qmask;
+            int c = (rand() & qmask) | 1;
+            if (ref->mul(c, ref->div(1, c)) != 1 || ref->div(ref->mul(a, c), c) != a) {
+                correct = 0;
+                printf("[Warning] GF(2^%d) arithmetic is inconsistent for %d and %d\n", gfpower, a, c);
+            }
+        }
+    }
+
+    // striped sequences of row operations, with rows being both sources and destinations
+    struct gf_pool *pool = gf_pool_create(4, 1000, 1);
+    GF_ELEMENT *rows0 = malloc(NROWS * ROWLEN);
+    GF_ELEMENT *rows1 = malloc(NROWS * ROWLEN);
+    struct gf_op ops0[4 * NROWS], ops1[4 * NROWS];
+    for (int f=0; f<3; f++) {
+        const struct gf_kernel *gk = gf_select_kernel(fields[f]);
+        int nerr = 0;
+        for (int t=0; t<ntrials/10+1; t++) {
+            int len = (rand() % ROWLEN) & ~1;
+            int nops = rand() % (4 * NROWS) + 1;
+            for (int i=0; i<NROWS*ROWLEN; i++)
+                rows0[i] = rows1[i] = rand() % 256;
+            for (int i=0; i<nops; i++) {
+                int d = rand() % NROWS, s = (d + 1 + rand() % (NROWS - 1)) % NROWS;
+                int c = rand() & ((1 << fields[f]) - 1);
+                ops0[i] = (struct gf_op) { rows0 + d * ROWLEN, rows0 + s * ROWLEN, c };
+                ops1[i] = (struct gf_op) { rows1 + d * ROWLEN, rows1 + s * ROWLEN, c };
+            }
+            gf_pool_madd(NULL, gk, ops0, nops, len);
+            gf_pool_madd(pool, gk, ops1, nops, len);
+            if (memcmp(rows0, rows1, NROWS * ROWLEN) != 0) {
+                nerr++;
+                printf("[Warning] striped %s differs from serial: len %d nops %d\n", gk->name, len, nops);
+            }
+        }
+        // k accumulators over the same sources in one pass, as k separate passes
+        for (int t=0; t<ntrials/10+1; t++) {
+            int len = (rand() % ROWLEN) & ~1;
+            int ndst = rand() % (NROWS / 2) + 1, nsrc = NROWS - ndst;
+            int coefs[NROWS * NROWS];
+            GF_ELEMENT *dsts[NROWS];
+            const GF_ELEMENT *srcs[NROWS];
+            for (int i=0; i<NROWS*ROWLEN; i++)
+                rows0[i] = rows1[i] = rand() % 256;
+            for (int j=0; j<ndst; j++)
+                dsts[j] = rows1 + j * ROWLEN;
+            for (int i=0; i<nsrc; i++)
+                srcs[i] = rows1 + (ndst + i) * ROWLEN;
+            for (int j=0; j<ndst*nsrc; j++)
+                coefs[j] = rand() & ((1 << fields[f]) - 1);
+            for (int j=0; j<ndst; j++) {
+                for (int i=0; i<nsrc; i++)
+                    gk->madd(rows0 + j * ROWLEN, rows0 + (ndst + i) * ROWLEN, coefs[j * nsrc + i], len);
+            }
+            gf_pool_madd_multi(t % 2 ? pool : NULL, gk, dsts, ndst, srcs, nsrc, coefs, len);
+            if (memcmp(rows0, rows1, NROWS * ROWLEN) != 0) {
+                nerr++;
+                printf("[Warning] blocked multi-accumulator %s differs from serial: len %d ndst %d\n", gk->name, len, ndst);
+            }
+        }
+        printf("[Summary] striped kernel %s on %d threads: %d trials, %d mismatches\n",
+               gk->name, gf_pool_nthreads(pool), 2 * (ntrials/10+1), nerr);
+        if (nerr)
+            correct = 0;
+    }
+    gf_pool_free(pool);
+    free(rows0);
+    free(rows1);
+
+    if (correct)
+        printf("[Summary] All kernels are byte-identical to the scalar kernels\n");
+    free(src);
+    free(dst0);
+    free(dst1);
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/*
+ * Monte Carlo simulation of streaming coding with the engine of simulator.h:
+ * independent trials over a Bernoulli, Gilbert-Elliott or trace-driven erasure
+ * channel run on a thread pool, and aggregate in-order delay and throughput
+ * statistics are printed. Results only depend on the seed, not on the number
+ * of threads.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o montecarlo test.montecarlo.c ../simulator.c -L.. -lstreamc -lpthread -lm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../simulator.h"
+
+char usage[] = "Usage: ./programName [-n snum] [-a arrival] [-r repfreq] [-c channel] [-t Tp] [-o reorder] [-N ntrials] [-j nthreads] [-s seed] [-v]\n\
+                       -n       - number of source packets per trial (default 1000)\n\
+                       -a       - Bernoulli arrival rate at the sending queue, 0: all available at time 0 (default)\n\
+                       -r       - frequency of inserting repair packets, random if < 1 (default 4)\n\
+                       -c       - erasure channel (default be:0.1)\n\
+                                  be:pe                       - Bernoulli\n\
+                                  ge:p_gb,p_bg,pe_good,pe_bad - Gilbert-Elliott\n\
+                                  tr:file                     - loss trace of 0/1 characters, 1: erased\n\
+                       -t       - propagation delay of channel in slots (default 0)\n\
+                       -o       - probability of re-ordering two in-flight packets per slot (default 0)\n\
+                       -N       - number of trials (default 100)\n\
+                       -j       - number of threads, 0: one per CPU (default)\n\
+                       -s       - seed (default 1)\n\
+                       -v       - print the result of every trial\n";
+
+static int parse_channel(const char *s, struct sim_channel *ch)
+{
+    if (strncmp(s, "be:", 3) == 0) {
+        ch->type = SIM_BERNOULLI;
+        ch->pe = atof(s + 3);
+        return 0;
+    }
+    if (strncmp(s, "ge:", 3) == 0) {
+        ch->type = SIM_GILBERT_ELLIOTT;
+        return sscanf(s + 3, "%lf,%lf,%lf,%lf", &ch->p_gb, &ch->p_bg, &ch->pe_good, &ch->pe_bad) == 4 ? 0 : -1;
+    }
+    if (strncmp(s, "tr:", 3) == 0) {
+        ch->type = SIM_TRACE;
+        ch->trace = sim_load_trace(s + 3, &ch->tracelen);
+        return ch->trace != NULL ? 0 : -1;
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    struct sim_config sc;
+    sim_default_config(&sc);
+    int verbose = 0;
+    for (int i=1; i<argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+            continue;
+        }
+        if (i + 1 >= argc || argv[i][0] != '-') {
+            printf("%s\n", usage);
+            exit(1);
+        }
+        const char *v = argv[++i];
+        switch (argv[i-1][1]) {
+        case 'n':
+            sc.snum = atoi(v);
+            break;
+        case 'a':
+            sc.arrival = atof(v);
+            break;
+        case 'r':
+            sc.cp.repfreq = atof(v);
+            break;
+        case 'c':
+            if (parse_channel(v, &sc.ch) != 0) {
+                printf("[Warning] invalid channel %s\n", v);
+                exit(1);
+            }
+            break;
+        case 't':
+            sc.ch.T_P = atoi(v);
+            break;
+        case 'o':
+            sc.ch.reorder = atof(v);
+            break;
+        case 'N':
+            sc.ntrials = atoi(v);
+            break;
+        case 'j':
+            sc.nthreads = atoi(v);
+            break;
+        case 's':
+            sc.seed = strtoul(v, NULL, 10);
+            break;
+        default:
+            printf("%s\n", usage);
+            exit(1);
+        }
+    }
+
+    struct sim_trial *trials = calloc(sc.ntrials, sizeof(struct sim_trial));
+    struct sim_stats st;
+    if (sim_run(&sc, trials, &st) != 0) {
+        printf("[Warning] simulation failed to run\n");
+        exit(1);
+    }
+    if (verbose) {
+        for (int t=0; t<sc.ntrials; t++)
+            printf("[Trial] %d correct %d nslots %d nuse %d erased %d delay mean %.2f max %d throughput %.4f\n",
+                   t, trials[t].correct, trials[t].nslots, trials[t].nuse, trials[t].nerased,
+                   trials[t].delay_mean, trials[t].delay_max, trials[t].throughput);
+    }
+    printf("[Summary] trials: %d failed: %d snum: %d repfreq: %.3f Tp: %d erasure rate: %.4f\n",
+           st.ntrials, st.nfailed, sc.snum, sc.cp.repfreq, sc.ch.T_P, st.erasure_rate);
+    printf("[Summary] in-order delay mean: %.3f std: %.3f p50: %d p95: %d p99: %d max: %d\n",
+           st.delay_mean, st.delay_std, st.delay_p50, st.delay_p95, st.delay_p99, st.delay_max);
+    printf("[Summary] throughput mean: %.4f std: %.4f min: %.4f nuses: %.1f\n",
+           st.throughput_mean, st.throughput_std, st.throughput_min, st.nuse_mean);
+    printf("[Summary] %.3f seconds, %.1f trials/s\n", st.seconds, st.ntrials / st.seconds);
+    free(trials);
+    if (sc.ch.type == SIM_TRACE)
+        free((unsigned char *) sc.ch.trace);
+    return st.nfailed == 0 ? 0 : 1;
+}
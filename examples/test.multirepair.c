@@ -0,0 +1,121 @@
+/*
+ * Test of batched and ranged repair packet output.
+ *
+ * Two encoders with the same parameters are fed the same source packets, and
+ * flushed alike so that the encoding window slides. At every step, one encoder
+ * outputs k repair packets with output_repair_packets() while the other makes
+ * k successive output_repair_packet() or output_repair_packet_short() calls,
+ * and the serialized packets must be byte-identical, i.e., have the same
+ * repair ids, windows, coefficients and symbols. Then both output a repair
+ * packet over a range sticking out of the window on both sides, through
+ * output_repair_packet_range() and through output_repair_packet() after the
+ * range was clipped to the full window, which must be identical as well. This
+ * runs in GF(2), GF(2^8) and GF(2^16), with COE_MT19937 and COE_COUNTER
+ * coefficients, serially and on a thread pool.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o multirepair test.multirepair.c -L.. -lstreamc -lpthread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../streamcodec.h"
+
+#define MAXK    9
+
+static int errors;
+
+// Compare the serialized packets of the two encoders and free them
+static void compare(struct encoder *ec[2], struct packet *pkt[2], const char *what, int gfpower, int coemode, int k)
+{
+    int size[2];
+    unsigned char *str[2];
+    for (int j=0; j<2; j++) {
+        size[j] = pkt[j] != NULL ? serialized_size(ec[j], pkt[j]) : -1;
+        str[j] = pkt[j] != NULL ? serialize_packet(ec[j], pkt[j]) : NULL;
+        free_packet(pkt[j]);
+    }
+    if (size[0] != size[1] || (size[0] > 0 && memcmp(str[0], str[1], size[0]) != 0)) {
+        if (errors++ < 10)
+            printf("[Error] %s: GF(2^%d) coemode %d k %d, packets differ\n", what, gfpower, coemode, k);
+    }
+    for (int j=0; j<2; j++)
+        free_serialized_packet(str[j]);
+}
+
+char usage[] = "Usage: ./programName snum pktsize nthreads\n\
+                       snum     - number of source packets per configuration\n\
+                       pktsize  - bytes per packet\n\
+                       nthreads - threads of the pool, 0: one per CPU\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 4) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int snum     = atoi(argv[1]);
+    int pktsize  = atoi(argv[2]);
+    int nthreads = atoi(argv[3]);
+    int gfpowers[3] = { 1, 8, 16 };
+    struct gf_pool *pool = gf_pool_create(nthreads, 1024, 1);
+    unsigned char *buf = malloc(pktsize);
+    long npkts = 0;
+    srand(1);
+    for (int g=0; g<3; g++) {
+        for (int m=COE_MT19937; m<=COE_COUNTER; m++) {
+            for (int p=0; p<2; p++) {
+                struct parameters cp = {0};
+                cp.gfpower = gfpowers[g];
+                cp.pktsize = pktsize;
+                cp.seed    = 7;
+                cp.coemode = m;
+                struct encoder *ec[2];
+                for (int j=0; j<2; j++) {
+                    ec[j] = initialize_encoder(&cp, NULL, 0);
+                    set_encoder_pool(ec[j], p ? pool : NULL);
+                }
+                for (int sid=0; sid<snum; sid++) {
+                    for (int i=0; i<pktsize; i++)
+                        buf[i] = rand();
+                    struct packet *pkt[2];
+                    for (int j=0; j<2; j++) {
+                        enqueue_packet(ec[j], sid, buf);
+                        pkt[j] = output_source_packet(ec[j]);
+                    }
+                    compare(ec, pkt, "source", gfpowers[g], m, 0);
+                    // windows of 1 to 40 packets, as flushes trail by up to 40
+                    if (sid % 10 == 9) {
+                        int ack = sid - 1 - rand() % 40;
+                        for (int j=0; j<2; j++)
+                            flush_acked_packets(ec[j], ack);
+                    }
+                    int k = 1 + rand() % MAXK;
+                    int ew = rand() % 3 == 0 ? 1 + rand() % 16 : 0;
+                    struct packet *batch[MAXK];
+                    int n = output_repair_packets(ec[0], k, ew, batch);
+                    if (n != k && errors++ < 10)
+                        printf("[Error] output_repair_packets() returned %d of %d packets\n", n, k);
+                    for (int i=0; i<n; i++) {
+                        pkt[0] = batch[i];
+                        pkt[1] = ew > 0 ? output_repair_packet_short(ec[1], ew) : output_repair_packet(ec[1]);
+                        compare(ec, pkt, "batch", gfpowers[g], m, k);
+                    }
+                    int s = ec[0]->headsid - 1 - rand() % 5, e = ec[0]->nextsid + rand() % 5;
+                    pkt[0] = output_repair_packet_range(ec[0], s, e);
+                    pkt[1] = output_repair_packet(ec[1]);
+                    compare(ec, pkt, "range", gfpowers[g], m, 1);
+                    npkts += n + 2;
+                }
+                for (int j=0; j<2; j++)
+                    free_encoder(ec[j]);
+            }
+        }
+    }
+    gf_pool_free(pool);
+    free(buf);
+
+    if (errors == 0)
+        printf("[Summary] %ld batched and ranged packets are byte-identical to single calls\n", npkts);
+    printf("[Summary] errors: %d\n", errors);
+    return errors != 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * Test of zero-copy enqueue with enqueue_packet_nocopy() and the release
+ * callback.
+ *
+ * Every other source packet is borrowed from a buffer of its own, the others
+ * are copied by enqueue_packet(). The packets are streamed over a Bernoulli
+ * erasure channel with a repair packet after every repfreq source packets, and
+ * the encoder is flushed every Tfb slots with the in-order id of the decoder,
+ * often with the same id again. The release callback must fire exactly once
+ * per borrowed packet, with its id and buffer, no earlier than the packet is
+ * flushed, and never for a copied packet; a released buffer is overwritten at
+ * once, so that any later read by the encoder corrupts the decoded packets.
+ * Packets still queued when the encoder is freed must be released by
+ * free_encoder(), again exactly once. Each decoded packet is compared with
+ * the data sent as the delivery callback hands it out, since the recovered
+ * ring only holds the last DEC_ALLOC of them.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o nocopy test.nocopy.c -L.. -lstreamc
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../streamcodec.h"
+
+#define NEXTRA  10                  // packets still queued when the encoder is freed
+
+static struct parameters cp;
+static unsigned char **bufs;        // buffer of each borrowed source packet
+static int *nrelease;               // release callbacks per source packet
+static int acked = -1;              // highest source id flushed so far
+static int errors;
+static int ndelivered;              // packets handed to the delivery callback, in order
+
+static void fill(unsigned char *buf, int sid)
+{
+    unsigned int x = sid * 2654435761u + 1;
+    for (int i=0; i<cp.pktsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+static void release(int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    int *freeing = arg;
+    if (sourceid % 2 != 0 || syms != bufs[sourceid] || (sourceid > acked && !*freeing)) {
+        printf("[Error] unexpected release of source packet %d\n", sourceid);
+        errors++;
+    }
+    nrelease[sourceid]++;
+    memset(syms, 0xA5, cp.pktsize);
+}
+
+static void deliver(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    unsigned char *expect = arg;
+    fill(expect, sourceid);
+    if (sourceid != ndelivered || memcmp(syms, expect, cp.pktsize) != 0) {
+        printf("[Error] source packet %d is not recovered correctly\n", sourceid);
+        errors++;
+    }
+    ndelivered = sourceid + 1;
+}
+
+char usage[] = "Usage: ./programName snum epsilon repfreq Tfb\n\
+                       snum     - number of source packets to transmit\n\
+                       epsilon  - erasure probability\n\
+                       repfreq  - a repair packet every repfreq source packets\n\
+                       Tfb      - feedback period in time slots\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 5) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int snum    = atoi(argv[1]);
+    double pe   = atof(argv[2]);
+    int repfreq = atoi(argv[3]);
+    int Tfb     = atoi(argv[4]);
+    cp.gfpower = 8;
+    cp.pktsize = 200;
+    cp.repfreq = 1.0 / repfreq;
+    cp.seed    = 0;
+    cp.coemode = COE_MT19937;
+    srand(1);
+
+    int total = snum + NEXTRA;
+    bufs = calloc(total, sizeof(unsigned char *));
+    nrelease = calloc(total, sizeof(int));
+    unsigned char *expect = malloc(cp.pktsize);
+    int freeing = 0;
+
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct decoder *dc = initialize_decoder(&cp);
+    set_release_callback(ec, release, &freeing);
+    set_delivery_callback(dc, deliver, expect);
+    unsigned char *copybuf = malloc(cp.pktsize);
+    for (int i=0; i<total; i++) {
+        if (i % 2 == 0) {
+            bufs[i] = malloc(cp.pktsize);
+            fill(bufs[i], i);
+            enqueue_packet_nocopy(ec, i, bufs[i]);
+        } else {
+            fill(copybuf, i);
+            enqueue_packet(ec, i, copybuf);
+            memset(copybuf, 0, cp.pktsize);
+        }
+    }
+
+    int slot = 0;
+    int nsent = 0;
+    while (dc->inorder < snum - 1) {
+        struct packet *pkt;
+        if (nsent < snum) {
+            pkt = output_source_packet(ec);
+            nsent++;
+        } else {
+            pkt = output_repair_packet(ec);
+        }
+        unsigned char *pktstr = serialize_packet(ec, pkt);
+        free_packet(pkt);
+        if (rand() % 1000 >= pe * 1000)
+            receive_packet(dc, deserialize_packet(dc, pktstr));
+        free_serialized_packet(pktstr);
+        if (nsent < snum && nsent % repfreq == 0) {
+            pkt = output_repair_packet(ec);
+            pktstr = serialize_packet(ec, pkt);
+            free_packet(pkt);
+            if (rand() % 1000 >= pe * 1000)
+                receive_packet(dc, deserialize_packet(dc, pktstr));
+            free_serialized_packet(pktstr);
+        }
+        if (++slot % Tfb == 0) {
+            if (dc->inorder > acked)
+                acked = dc->inorder;
+            flush_acked_packets(ec, dc->inorder);
+            flush_acked_packets(ec, dc->inorder);
+        }
+    }
+    // an acknowledgement beyond the packets sent releases no more than those
+    acked = snum - 1;
+    flush_acked_packets(ec, total + 100);
+    flush_acked_packets(ec, acked);
+
+    if (ndelivered != snum) {
+        printf("[Error] %d source packets delivered out of %d\n", ndelivered, snum);
+        errors++;
+    }
+    for (int i=0; i<total; i++) {
+        if (nrelease[i] != (i % 2 == 0 && i < snum)) {
+            printf("[Error] source packet %d released %d times before free_encoder()\n", i, nrelease[i]);
+            errors++;
+        }
+    }
+    freeing = 1;
+    free_encoder(ec);
+    int nborrowed = 0;
+    for (int i=0; i<total; i++) {
+        nborrowed += i % 2 == 0;
+        if (nrelease[i] != (i % 2 == 0)) {
+            printf("[Error] source packet %d released %d times\n", i, nrelease[i]);
+            errors++;
+        }
+    }
+    free_decoder(dc);
+    for (int i=0; i<total; i++)
+        free(bufs[i]);
+    free(bufs);
+    free(nrelease);
+    free(copybuf);
+    free(expect);
+
+    if (errors == 0)
+        printf("[Summary] All %d borrowed packets are released exactly once, and all source packets are recovered correctly\n",
+               nborrowed);
+    printf("[Summary] snum: %d erasure: %.3f repfreq: %d Tfb: %d errors: %d\n", snum, pe, repfreq, Tfb, errors);
+    return errors != 0;
+}
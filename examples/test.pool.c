@@ -0,0 +1,160 @@
+/*
+ * Test of the codec with the column-striped thread pool of gfpool.h.
+ *
+ * Two encoders with the same parameters, one of them given a pool with
+ * set_encoder_pool(), stream jumbo source packets with a full repair packet
+ * after every repfreq source packets, a short one in between and, every Tfb
+ * slots, a batch of output_repair_packets(): every serialized packet must be
+ * byte-identical. The packets not erased by a Bernoulli channel are received
+ * by decoders with and without a pool (set_decoder_pool()), in both DEC_EAGER
+ * and DEC_DEFERRED mode, which must all recover every source packet correctly.
+ * The pool's threshold is one byte, so that every region operation of the
+ * codec takes its parallel path.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o pool test.pool.c -L.. -lstreamc -lpthread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../streamcodec.h"
+
+#define NDEC    4                   // serial and pooled decoders, eager and deferred
+#define NBATCH  3
+
+static struct parameters cp;
+static int errors;
+
+static void fill(unsigned char *buf, int sid)
+{
+    unsigned int x = sid * 2654435761u + 1;
+    for (int i=0; i<cp.pktsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+// Serialize a packet of each encoder, which must be identical, and hand it to
+// the decoders unless erased
+static void send(struct encoder *ec[2], struct packet *pkt[2], struct decoder *dc[NDEC], double pe)
+{
+    unsigned char *str[2];
+    int size[2];
+    for (int j=0; j<2; j++) {
+        size[j] = serialized_size(ec[j], pkt[j]);
+        str[j] = serialize_packet(ec[j], pkt[j]);
+        free_packet(pkt[j]);
+    }
+    if (size[0] != size[1] || memcmp(str[0], str[1], size[0]) != 0) {
+        if (errors++ < 10)
+            printf("[Error] pooled encoder output differs\n");
+    }
+    if (rand() % 1000 >= pe * 1000) {
+        for (int d=0; d<NDEC; d++)
+            receive_packet(dc[d], deserialize_packet(dc[d], str[0]));
+    }
+    for (int j=0; j<2; j++)
+        free_serialized_packet(str[j]);
+}
+
+char usage[] = "Usage: ./programName snum pktsize epsilon repfreq Tfb nthreads\n\
+                       snum     - number of source packets to transmit\n\
+                       pktsize  - bytes per packet\n\
+                       epsilon  - erasure probability\n\
+                       repfreq  - a repair packet every repfreq source packets\n\
+                       Tfb      - feedback period in time slots\n\
+                       nthreads - threads of the pool, 0: one per CPU\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 7) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int snum     = atoi(argv[1]);
+    cp.pktsize   = atoi(argv[2]);
+    double pe    = atof(argv[3]);
+    int repfreq  = atoi(argv[4]);
+    int Tfb      = atoi(argv[5]);
+    int nthreads = atoi(argv[6]);
+    cp.gfpower = 8;
+    cp.seed    = 0;
+    cp.coemode = COE_COUNTER;
+    srand(1);
+
+    struct gf_pool *pool = gf_pool_create(nthreads, 1024, 1);
+    nthreads = gf_pool_nthreads(pool);
+    struct encoder *ec[2];
+    struct decoder *dc[NDEC];
+    for (int j=0; j<2; j++)
+        ec[j] = initialize_encoder(&cp, NULL, 0);
+    set_encoder_pool(ec[1], pool);
+    for (int d=0; d<NDEC; d++) {
+        dc[d] = initialize_decoder(&cp);
+        if (d % 2)
+            set_decoder_pool(dc[d], pool);
+        if (d >= 2)
+            set_decoder_mode(dc[d], DEC_DEFERRED);
+    }
+
+    unsigned char *buf = malloc(cp.pktsize);
+    struct packet *pkt[2], *batch[2][NBATCH];
+    int slot = 0, nsent = 0, done = 0;
+    while (!done) {
+        if (nsent < snum) {
+            fill(buf, nsent);
+            for (int j=0; j<2; j++) {
+                enqueue_packet(ec[j], nsent, buf);
+                pkt[j] = output_source_packet(ec[j]);
+            }
+            send(ec, pkt, dc, pe);
+            nsent++;
+            if (nsent % repfreq == 0 || nsent % repfreq == repfreq / 2) {
+                for (int j=0; j<2; j++)
+                    pkt[j] = nsent % repfreq == 0 ? output_repair_packet(ec[j]) : output_repair_packet_short(ec[j], 3);
+                send(ec, pkt, dc, pe);
+            }
+        } else {
+            for (int j=0; j<2; j++)
+                pkt[j] = output_repair_packet(ec[j]);
+            send(ec, pkt, dc, pe);
+        }
+        if (++slot % Tfb == 0) {
+            int k = 0;
+            for (int j=0; j<2; j++)
+                k = output_repair_packets(ec[j], NBATCH, 0, batch[j]);
+            for (int i=0; i<k; i++) {
+                pkt[0] = batch[0][i];
+                pkt[1] = batch[1][i];
+                send(ec, pkt, dc, pe);
+            }
+            int inorder = dc[0]->inorder;
+            for (int d=1; d<NDEC; d++)
+                inorder = dc[d]->inorder < inorder ? dc[d]->inorder : inorder;
+            for (int j=0; j<2; j++)
+                flush_acked_packets(ec[j], inorder);
+        }
+        done = 1;
+        for (int d=0; d<NDEC; d++)
+            done = done && dc[d]->inorder == snum - 1;
+    }
+    for (int d=0; d<NDEC; d++) {
+        for (int sid=snum>DEC_ALLOC?snum-DEC_ALLOC:0; sid<snum; sid++) {
+            fill(buf, sid);
+            if (memcmp(RECOVERED(dc[d], sid), buf, cp.pktsize) != 0 && errors++ < 10)
+                printf("[Error] decoder %d recovered source packet %d wrong\n", d, sid);
+        }
+        free_decoder(dc[d]);
+    }
+    for (int j=0; j<2; j++)
+        free_encoder(ec[j]);
+    gf_pool_free(pool);
+    free(buf);
+
+    if (errors == 0)
+        printf("[Summary] Pooled encoding is byte-identical, and pooled decoders recover all source packets\n");
+    printf("[Summary] snum: %d pktsize: %d erasure: %.3f threads: %d slots: %d errors: %d\n",
+           snum, cp.pktsize, pe, nthreads, slot, errors);
+    return errors != 0;
+}
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+# Compare the per-packet ctypes path of pystreamc.py with the batch entry
+# points of the pybatch extension (see pybatch.c) over a link with Bernoulli
+# packet loss.
+#
+# Both paths send the same snum source packets of a COE_COUNTER code, with a
+# repair packet after every repfreq source packets, and lose the same packets.
+# The per-packet path makes the ctypes calls of a typical proxy for every packet
+# (enqueue, output, serialize and copy out; copy in, deserialize, receive and
+# copy the recovered packet out); the batch path makes one call per batch of
+# packets and reads the recovered packets through zero-copy memoryviews. Every
+# recovered packet is checked against the original, and the time per source
+# packet of both paths is reported. A batch of truncated and padded packets
+# must be rejected by the batch path without disturbing the decoder.
+#
+# Requires libstreamc.so and the pybatch extension on the library/module paths.
+import random
+import sys
+import time
+from array import array
+from ctypes import byref, c_ubyte, string_at
+sys.path.insert(0, '..')
+from pystreamc import *
+
+BATCH = 64
+
+
+def new_codec(pktsize):
+    cp = parameters()
+    cp.gfpower = 8
+    cp.pktsize = pktsize
+    cp.repfreq = 0
+    cp.seed = 1
+    cp.coemode = COE_COUNTER
+    ec = streamc.initialize_encoder(byref(cp), None, 0)
+    dc = streamc.initialize_decoder(byref(cp))
+    streamc.set_wire_format(ec, WIRE_COMPACT)
+    return cp, ec, dc
+
+
+def per_packet(data, pktsize, repfreq, lost):
+    cp, ec, dc = new_codec(pktsize)
+    snum = len(data) // pktsize
+    out = []
+    t0 = time.perf_counter()
+    n = 0
+    for sid in range(snum):
+        buf = (c_ubyte * pktsize).from_buffer_copy(data, sid * pktsize)
+        streamc.enqueue_packet(ec, sid, buf)
+        kinds = [streamc.output_source_packet] + [streamc.output_repair_packet] * (sid % repfreq == repfreq - 1)
+        for output in kinds:
+            pkt = output(ec)
+            size = streamc.serialized_size(ec, pkt)
+            pktstr = streamc.serialize_packet(ec, pkt)
+            wire = string_at(pktstr, size)
+            streamc.free_serialized_packet(pktstr)
+            streamc.free_packet(pkt)
+            if not lost[n]:
+                rbuf = (c_ubyte * len(wire)).from_buffer_copy(wire)
+                streamc.receive_packet(dc, streamc.deserialize_packet(dc, rbuf))
+            n += 1
+        d = dc.contents
+        while len(out) <= d.inorder:
+            out.append(string_at(d.recovered[len(out) % d.recvsize], pktsize))
+        if d.inorder >= 0:
+            streamc.flush_acked_packets(ec, d.inorder)
+    elapsed = time.perf_counter() - t0
+    streamc.free_encoder(ec)
+    streamc.free_decoder(dc)
+    return elapsed, out
+
+
+def batched(data, pktsize, repfreq, lost):
+    cp, ec, dc = new_codec(pktsize)
+    snum = len(data) // pktsize
+    stride = pktsize + 64
+    wire = bytearray(stride * (BATCH + BATCH // repfreq + 1))
+    lens = array('i', bytes(4 * (BATCH + BATCH // repfreq + 1)))
+    view = memoryview(data)
+    out = bytearray()
+    t0 = time.perf_counter()
+    n = 0
+    for first in range(0, snum, BATCH):
+        k = encode_batch(ec, view[first * pktsize:min(first + BATCH, snum) * pktsize], repfreq, wire, stride, lens)
+        rlens = lens[:k]
+        for i in range(k):
+            if lost[n + i]:
+                rlens[i] = 0
+        n += k
+        inorder, rejected = receive_batch(dc, wire, rlens, stride)
+        if rejected:
+            print("[Warning] batch: %d intact packets rejected" % rejected)
+        out += b''.join(recovered_views(dc, len(out) // pktsize, inorder))
+        if inorder >= 0:
+            streamc.flush_acked_packets(ec, inorder)
+    elapsed = time.perf_counter() - t0
+    streamc.free_encoder(ec)
+    streamc.free_decoder(dc)
+    return elapsed, [bytes(out[i:i + pktsize]) for i in range(0, len(out), pktsize)]
+
+
+def truncated(data, pktsize):
+    # Every packet of a batch is received first cut short at a random length
+    # (down to the header, or to nothing but a byte), or with trailing bytes,
+    # and must be rejected without being received; then intact, and must be
+    # recovered. Returns the number of errors.
+    cp, ec, dc = new_codec(pktsize)
+    stride = pktsize + 64
+    wire = bytearray(stride * 2 * BATCH)
+    lens = array('i', bytes(4 * 2 * BATCH))
+    k = encode_batch(ec, memoryview(data)[:BATCH * pktsize], 2, wire, stride, lens)
+    bad = array('i', lens[:k])
+    for i in range(k):
+        bad[i] = lens[i] + 1 if i % 5 == 0 else random.randrange(1, lens[i])
+    errors = 0
+    inorder, rejected = receive_batch(dc, wire, bad, stride)
+    if rejected != k or inorder != -1:
+        errors += 1
+        print("[Warning] truncated: %d of %d packets rejected, in-order id %d" % (rejected, k, inorder))
+    inorder, rejected = receive_batch(dc, wire, lens[:k], stride)
+    out = b''.join(recovered_views(dc, 0, inorder))
+    if rejected or inorder != BATCH - 1 or out != data[:BATCH * pktsize]:
+        errors += 1
+        print("[Warning] truncated: intact packets not recovered after truncated ones")
+    streamc.free_encoder(ec)
+    streamc.free_decoder(dc)
+    return errors
+
+
+def main():
+    if len(sys.argv) != 5:
+        print("Usage: ./test.pybatch.py snum pktsize repfreq epsilon\n"
+              "       snum     - number of source packets to transmit\n"
+              "       pktsize  - bytes per packet\n"
+              "       repfreq  - a repair packet every repfreq source packets\n"
+              "       epsilon  - erasure probability")
+        sys.exit(1)
+    snum, pktsize, repfreq = int(sys.argv[1]), int(sys.argv[2]), int(sys.argv[3])
+    pe = float(sys.argv[4])
+    random.seed(1)
+    data = bytes(random.getrandbits(8) for _ in range(snum * pktsize))
+    lost = [random.random() < pe for _ in range(snum + snum // repfreq + 1)]
+    tp, outp = per_packet(data, pktsize, repfreq, lost)
+    tb, outb = batched(data, pktsize, repfreq, lost)
+    correct = truncated(data, pktsize) == 0
+    for name, out in (("per-packet", outp), ("batch", outb)):
+        bad = sum(out[i] != data[i * pktsize:(i + 1) * pktsize] for i in range(len(out)))
+        if bad:
+            correct = False
+            print("[Warning] %s: %d recovered packets are NOT identical to the original" % (name, bad))
+        print("[Summary] %-10s recovered in order: %d of %d" % (name, len(out), snum))
+    print("[Summary] per-packet: %.2f us per source packet" % (tp / snum * 1e6))
+    print("[Summary] batch:      %.2f us per source packet (%.1fx)" % (tb / snum * 1e6, tp / tb))
+    sys.exit(0 if correct else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,160 @@
+/*
+ * Test the adaptive repair scheduler over a long-delay link with Gilbert
+ * (bursty) packet loss.
+ *
+ * Packets to send are chosen by next_packet(). Every Tfb time slots the decoder
+ * sends a serialized feedback summary, which reaches the encoder Tp slots later
+ * over a lossless return channel and is passed to sched_feedback(). For
+ * comparison, with repfreq > 0 the scheduler is replaced by the fixed-interval
+ * full-EW insertion of test.bernoulli.full.c, feedback then only flushes the
+ * acknowledged packets. Reported are the in-order delay, the channel uses and
+ * the number of source packets mixed per sent packet (encoding work).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../streamcodec.h"
+#include "../wireformat.h"
+#include "../scheduler.h"
+
+char usage[] = "Usage: ./programName snum pgb pbg Tp Tfb delay budget repfreq\n\
+                       snum     - number of source packets to transmit\n\
+                       pgb      - probability of the channel going from good to bad (lossy) state\n\
+                       pbg      - probability of the channel going from bad to good state\n\
+                       Tp       - propagation delay of channel, in both directions\n\
+                       Tfb      - feedback period in time slots\n\
+                       delay    - in-order delay target of the scheduler, in source packets\n\
+                       budget   - CPU budget of the scheduler, in source packets mixed per sent packet\n\
+                       repfreq  - 0 for the scheduler, otherwise a full-EW repair every repfreq source packets\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 9) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int snum = atoi(argv[1]);
+    double pgb = atof(argv[2]);
+    double pbg = atof(argv[3]);
+    int T_P = atoi(argv[4]);
+    int T_FB = atoi(argv[5]);
+    double delay = atof(argv[6]);
+    double budget = atof(argv[7]);
+    int repfreq = atoi(argv[8]);
+    struct parameters cp = {0};
+    cp.gfpower = 8;
+    cp.pktsize = 200;
+    cp.repfreq = repfreq;
+    cp.seed    = 1;
+    cp.coemode = COE_COUNTER;
+    srand(1);
+
+    unsigned char *buf = malloc(snum * cp.pktsize);
+    for (int i=0; i<snum*cp.pktsize; i++)
+        buf[i] = rand() % 256;
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct decoder *dc = initialize_decoder(&cp);
+    struct scheduler *sch = NULL;
+    if (repfreq <= 0) {
+        sch = sched_create(delay, budget);
+        set_encoder_scheduler(ec, sch);
+    }
+    for (int i=0; i<snum; i++)
+        enqueue_packet(ec, i, buf+i*cp.pktsize);
+
+    unsigned char **queue = calloc(T_P+1, sizeof(unsigned char *));     // forward link
+    unsigned char (*fbq)[WIRE_MAXFB] = calloc(T_P+1, WIRE_MAXFB);        // return link
+    int *fblen = calloc(T_P+1, sizeof(int));
+    int *sent_slot = calloc(snum, sizeof(int));
+    long nuse = 0, nrepair = 0, ewsum = 0;
+    double delaysum = 0;
+    int maxdelay = 0, bad = 0;
+    int slot;
+    for (slot=0; dc->inorder < snum-1; slot++) {
+        int pos = slot % (T_P+1);       // sent now, received T_P slots later
+        // the encoder: feedback arriving now, then at most one packet
+        if (fblen[pos] > 0) {
+            struct dec_feedback fb;
+            if (deserialize_feedback(fbq[pos], fblen[pos], &fb) > 0) {
+                if (sch != NULL)
+                    sched_feedback(ec, &fb);
+                else if (fb.inorder >= ec->headsid)
+                    flush_acked_packets(ec, fb.inorder);
+            }
+            fblen[pos] = 0;
+        }
+        struct packet *pkt;
+        if (sch != NULL) {
+            pkt = next_packet(ec);
+        } else if (ec->head == -1) {
+            pkt = ec->nextsid < snum ? output_source_packet(ec) : NULL;
+        } else if (ec->nextsid >= snum
+                   || (ec->nextsid > ec->headsid && (ec->count + 1) % (repfreq + 1) == 0)) {
+            pkt = output_repair_packet(ec);
+        } else {
+            pkt = output_source_packet(ec);
+        }
+        free(queue[pos]);
+        queue[pos] = NULL;
+        if (pkt != NULL) {
+            nuse++;
+            ewsum += pkt->win_e - pkt->win_s + 1;
+            if (pkt->repairid == -1)
+                sent_slot[pkt->sourceid] = slot;
+            else
+                nrepair++;
+            bad = bad ? rand() % 10000 >= pbg * 10000 : rand() % 10000 < pgb * 10000;
+            if (!bad)
+                queue[pos] = serialize_packet(ec, pkt);
+            free_packet(pkt);
+        }
+        // the decoder: packet sent T_P slots ago, then feedback
+        int rpos = (slot + 1) % (T_P+1);    // == (slot - T_P) % (T_P+1)
+        if (slot >= T_P && queue[rpos] != NULL) {
+            int prev = dc->inorder;
+            receive_packet(dc, deserialize_packet(dc, queue[rpos]));
+            free(queue[rpos]);
+            queue[rpos] = NULL;
+            for (int i=prev+1; i<=dc->inorder; i++) {
+                int d = slot - T_P - sent_slot[i];      // in-order delay, excluding propagation
+                delaysum += d;
+                if (d > maxdelay)
+                    maxdelay = d;
+            }
+        }
+        if (slot % T_FB == 0) {
+            struct dec_feedback fb;
+            get_decoder_feedback(dc, &fb);
+            int fpos = (slot + T_P) % (T_P+1);     // read by the encoder T_P slots later
+            fblen[fpos] = serialize_feedback(&fb, fbq[fpos], WIRE_MAXFB);
+        }
+    }
+
+    int correct = 1;
+    int ncheck = snum > dc->recvsize ? dc->recvsize : snum;
+    for (int i=snum-1; i>snum-1-ncheck; i--) {
+        if (memcmp(buf+i*cp.pktsize, RECOVERED(dc, i), cp.pktsize) != 0) {
+            correct = 0;
+            printf("[Warning] recovered %d is NOT identical to original.\n", i);
+        }
+    }
+    if (correct)
+        printf("[Summary] All source packets are recovered correctly\n");
+    printf("[Summary] %s snum: %d pgb: %.3f pbg: %.3f Tp: %d Tfb: %d slots: %d nuses: %ld repairs: %ld\n",
+           sch != NULL ? "scheduler" : "fixed", snum, pgb, pbg, T_P, T_FB, slot, nuse, nrepair);
+    printf("[Summary] in-order delay mean %.1f max %d, source packets mixed per sent packet %.1f\n",
+           delaysum / snum, maxdelay, nuse ? (double) ewsum / nuse : 0);
+    if (sch != NULL)
+        printf("[Summary] estimated loss %.3f burst %.2f, repfreq %.3f shortlen %d, repairs full %llu short %llu\n",
+               sch->loss, sch->burst, sch->repfreq, sch->shortlen, sch->nfull, sch->nshort);
+    for (int i=0; i<=T_P; i++)
+        free(queue[i]);
+    free(queue);
+    free(fbq);
+    free(fblen);
+    free(sent_slot);
+    free_encoder(ec);
+    free_decoder(dc);
+    sched_free(sch);
+    free(buf);
+    return correct ? 0 : 1;
+}
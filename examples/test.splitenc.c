@@ -0,0 +1,233 @@
+/*
+ * Stress test of the split encoder (splitenc.h) with its roles on separate
+ * threads.
+ *
+ * A producer thread publishes npkts source packets into the split encoder, half
+ * of them copied by se_enqueue() and half filled in place by se_reserve() and
+ * se_commit(), waiting while the ring of capacity slots is full. A sender thread
+ * outputs them with a repair packet after every repfreq source packets, plus
+ * full repair packets while it has nothing new to send and packets are
+ * unacknowledged, and passes the serialized packets not erased by a Bernoulli
+ * channel to a receiver thread over a lock-free queue. The receiver decodes
+ * them and publishes its in-order id, which a feedback thread acknowledges with
+ * se_ack() every ackint microseconds. Every thread yields at random to vary
+ * the interleavings. Every delivered packet must be identical to the packet
+ * produced with its id.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o splitenc test.splitenc.c ../splitenc.c -L.. -lstreamc -lpthread
+ * or with the library sources under ThreadSanitizer, to check the orderings:
+ *      gcc -O1 -g -fsanitize=thread -o splitenc test.splitenc.c $(ls ../[a-z]*.c | grep -v pybatch) -lpthread -lm
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../splitenc.h"
+#include "../wireformat.h"
+
+#define QSIZE   1024                // packets in flight from the sender to the receiver
+
+static struct parameters cp;
+static struct split_encoder *se;
+static int npkts, repfreq, ackint;
+static double pe;
+// sender -> receiver, single producer single consumer
+static unsigned char *qbuf;
+static int qlen[QSIZE], qcap;
+static _Alignas(CACHELINE) atomic_int qtail;
+static _Alignas(CACHELINE) atomic_int qhead;
+static _Alignas(CACHELINE) atomic_int inorder = -1;
+static int expect, errors;
+static long nfull, nrepair, nsent;
+
+static void fill(unsigned char *buf, int sid)
+{
+    unsigned int x = sid * 2654435761u + 1;
+    for (int i=0; i<cp.pktsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+static void jitter(unsigned int *seed)
+{
+    if (rand_r(seed) % 64 == 0)
+        sched_yield();
+}
+
+static void *producer(void *arg)
+{
+    unsigned int seed = 1;
+    unsigned char *buf = malloc(cp.pktsize);
+    (void) arg;
+    for (int sid=0; sid<npkts; sid++) {
+        if (sid % 2 == 0) {
+            fill(buf, sid);
+            while (se_enqueue(se, buf) < 0) {
+                nfull++;
+                sched_yield();
+            }
+        } else {
+            GF_ELEMENT *slot;
+            while ((slot = se_reserve(se)) == NULL) {
+                nfull++;
+                sched_yield();
+            }
+            fill(slot, sid);
+            se_commit(se);
+        }
+        jitter(&seed);
+    }
+    free(buf);
+    return NULL;
+}
+
+// Serialize pkt into the queue to the receiver, unless it is erased
+static void transmit(struct packet *pkt, unsigned int *seed)
+{
+    struct encoder *ec = se_encoder(se);
+    nsent++;
+    if (rand_r(seed) % 10000 >= pe * 10000) {
+        int tail = atomic_load_explicit(&qtail, memory_order_relaxed);
+        while (tail - atomic_load_explicit(&qhead, memory_order_acquire) >= QSIZE)
+            sched_yield();
+        qlen[tail % QSIZE] = serialize_packet_into(ec, pkt, qbuf + (size_t) (tail % QSIZE) * qcap, qcap);
+        atomic_store_explicit(&qtail, tail + 1, memory_order_release);
+    }
+    free_packet(pkt);
+}
+
+static void *sender(void *arg)
+{
+    unsigned int seed = 2;
+    struct encoder *ec = se_encoder(se);
+    (void) arg;
+    set_wire_format(ec, WIRE_COMPACT);
+    while (ec->headsid < npkts) {
+        struct packet *pkt = se_output_source(se);
+        if (pkt != NULL) {
+            int sid = pkt->sourceid;
+            transmit(pkt, &seed);
+            if ((sid + 1) % repfreq == 0 && (pkt = se_output_repair(se, 0)) != NULL) {
+                nrepair++;
+                transmit(pkt, &seed);
+            }
+        } else if (atomic_load(&qtail) == atomic_load(&qhead) && (pkt = se_output_repair(se, 0)) != NULL) {
+            // the receiver is idle with unacknowledged packets, e.g., the last ones were lost
+            nrepair++;
+            transmit(pkt, &seed);
+        } else {
+            sched_yield();
+        }
+        jitter(&seed);
+    }
+    return NULL;
+}
+
+static void deliver(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    unsigned char *ref = arg;
+    (void) dc;
+    fill(ref, sourceid);
+    if (sourceid != expect || memcmp(ref, syms, cp.pktsize) != 0)
+        errors++;
+    expect = sourceid + 1;
+}
+
+static void *receiver(void *arg)
+{
+    unsigned int seed = 3;
+    unsigned char *ref = malloc(cp.pktsize);
+    struct decoder *dc = initialize_decoder(&cp);
+    (void) arg;
+    set_delivery_callback(dc, deliver, ref);
+    while (dc->inorder < npkts - 1) {
+        int head = atomic_load_explicit(&qhead, memory_order_relaxed);
+        if (head == atomic_load_explicit(&qtail, memory_order_acquire)) {
+            sched_yield();
+            continue;
+        }
+        struct packet *pkt = deserialize_packet(dc, qbuf + (size_t) (head % QSIZE) * qcap);
+        if (pkt == NULL)
+            errors++;
+        else
+            receive_packet(dc, pkt);
+        atomic_store_explicit(&qhead, head + 1, memory_order_release);
+        atomic_store_explicit(&inorder, dc->inorder, memory_order_relaxed);
+        jitter(&seed);
+    }
+    free_decoder(dc);
+    free(ref);
+    return NULL;
+}
+
+static void *feedback(void *arg)
+{
+    struct timespec ts = { 0, ackint * 1000L };
+    (void) arg;
+    while (se_acked(se) < npkts - 1) {
+        se_ack(se, atomic_load_explicit(&inorder, memory_order_relaxed));
+        if (ackint > 0)
+            nanosleep(&ts, NULL);
+        else
+            sched_yield();
+    }
+    return NULL;
+}
+
+char usage[] = "Usage: ./programName npkts pktsize capacity repfreq epsilon ackint\n\
+                       npkts    - number of source packets to transmit\n\
+                       pktsize  - bytes per packet\n\
+                       capacity - slots of the producer ring (unacknowledged packets)\n\
+                       repfreq  - a repair packet after every repfreq source packets\n\
+                       epsilon  - erasure probability\n\
+                       ackint   - feedback interval in microseconds\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 7) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    npkts = atoi(argv[1]);
+    cp.gfpower = 8;
+    cp.pktsize = atoi(argv[2]);
+    cp.repfreq = 0;
+    cp.seed    = 1;
+    cp.coemode = COE_COUNTER;
+    int capacity = atoi(argv[3]);
+    repfreq = atoi(argv[4]);
+    pe = atof(argv[5]);
+    ackint = atoi(argv[6]);
+
+    se = se_create(&cp, capacity);
+    qcap = cp.pktsize + WIRE_MAXHDR;
+    qbuf = malloc((size_t) QSIZE * qcap);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_t tid[4];
+    void *(*roles[4])(void *) = { receiver, feedback, sender, producer };
+    for (int i=0; i<4; i++)
+        pthread_create(&tid[i], NULL, roles[i], NULL);
+    for (int i=0; i<4; i++)
+        pthread_join(tid[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = t1.tv_sec - t0.tv_sec + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+    int correct = errors == 0 && expect == npkts;
+    if (correct)
+        printf("[Summary] All source packets are delivered in order and identical to the original\n");
+    else
+        printf("[Warning] %d delivery errors, %d of %d packets delivered\n", errors, expect, npkts);
+    printf("[Summary] sent: %ld (%ld repair) producer waits: %ld acked: %d time: %.3f s (%.0f packets/s)\n",
+           nsent, nrepair, nfull, se_acked(se), secs, npkts / secs);
+    se_free(se);
+    free(qbuf);
+    return correct ? 0 : 1;
+}
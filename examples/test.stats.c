@@ -0,0 +1,151 @@
+/*
+ * Test of the encoder and decoder statistics (get_encoder_stats() and
+ * get_decoder_stats()).
+ *
+ * A fixed sequence of packets, whose effect on every counter is known, is sent
+ * and received in GF(2^8), where all coefficients are non-zero: source packets
+ * with two of them erased, a full repair packet, a duplicate of it, a short
+ * repair packet that completes decoding, and packets covering only delivered
+ * source packets. The counters must match exactly. Meanwhile, a second thread
+ * polls the statistics and checks that no counter ever decreases.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o stats test.stats.c -L.. -lstreamc -lpthread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../streamcodec.h"
+
+#define SNUM    10
+#define PKTSIZE 100
+#define NBATCH  3                   // repair packets of output_repair_packets()
+
+static struct encoder *ec;
+static struct decoder *dc;
+static atomic_int done;
+static int errors;
+
+static void expect(const char *what, unsigned long long got, unsigned long long want)
+{
+    if (got != want) {
+        printf("[Error] %s: %llu, expected %llu\n", what, got, want);
+        errors++;
+    }
+}
+
+static void *poll_stats(void *arg)
+{
+    (void) arg;
+    struct encoder_stats es, pes = { 0 };
+    struct decoder_stats ds, pds;
+    memset(&pds, 0, sizeof(pds));
+    long npolls = 0, nbad = 0;
+    while (!atomic_load(&done)) {
+        get_encoder_stats(ec, &es);
+        get_decoder_stats(dc, &ds);
+        nbad += es.nsource < pes.nsource || es.nrepair < pes.nrepair || es.madd_bytes < pes.madd_bytes
+                || ds.nsource < pds.nsource || ds.nrepair < pds.nrepair || ds.innovative < pds.innovative
+                || ds.madd_bytes < pds.madd_bytes || ds.redundant < pds.redundant;
+        pes = es;
+        pds = ds;
+        npolls++;
+    }
+    if (nbad)
+        printf("[Error] counters decreased in %ld of %ld polls\n", nbad, npolls);
+    return (void *) nbad;
+}
+
+static void receive(struct packet *pkt)
+{
+    unsigned char *pktstr = serialize_packet(ec, pkt);
+    receive_packet(dc, deserialize_packet(dc, pktstr));
+    free_serialized_packet(pktstr);
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+    struct parameters cp = {0};
+    cp.gfpower = 8;
+    cp.pktsize = PKTSIZE;
+    cp.seed    = 3;
+    cp.coemode = COE_COUNTER;
+    ec = initialize_encoder(&cp, NULL, 0);
+    dc = initialize_decoder(&cp);
+    pthread_t poller;
+    pthread_create(&poller, NULL, poll_stats, NULL);
+
+    unsigned char buf[PKTSIZE];
+    struct packet *src[SNUM];
+    for (int i=0; i<SNUM; i++) {
+        memset(buf, i + 1, PKTSIZE);
+        enqueue_packet(ec, i, buf);
+        src[i] = output_source_packet(ec);
+        if (i != 3 && i != 7)
+            receive(src[i]);
+    }
+    struct packet *full = output_repair_packet(ec);          // [0, 9]
+    receive(full);                                          // innovative
+    receive(full);                                          // non-innovative
+    struct packet *shrt = output_repair_packet_short(ec, 4); // [6, 9]
+    receive(shrt);                                          // innovative, delivers all
+    receive(src[3]);                                        // redundant source
+    receive(full);                                          // redundant repair
+    struct packet *batch[NBATCH];
+    output_repair_packets(ec, NBATCH, 0, batch);
+    atomic_store(&done, 1);
+    void *nbad;
+    pthread_join(poller, &nbad);
+    errors += nbad != NULL;
+
+    struct encoder_stats es;
+    get_encoder_stats(ec, &es);
+    expect("encoder nsource", es.nsource, SNUM);
+    expect("encoder nrepair", es.nrepair, 2 + NBATCH);
+    expect("encoder madd_bytes", es.madd_bytes, (unsigned long long) (SNUM + 4 + NBATCH * SNUM) * PKTSIZE);
+    expect("encoder buf_hwm", es.buf_hwm, SNUM);
+
+    struct decoder_stats ds;
+    get_decoder_stats(dc, &ds);
+    expect("decoder inorder", dc->inorder, SNUM - 1);
+    expect("decoder nsource", ds.nsource, SNUM - 2 + 1);
+    expect("decoder nrepair", ds.nrepair, 4);
+    expect("decoder innovative", ds.innovative, 2);
+    expect("decoder noninnovative", ds.noninnovative, 1);
+    expect("decoder redundant", ds.redundant, 2);
+    expect("decoder buf_hwm", ds.buf_hwm, 7);           // window [3, 9]: 5 source and 2 repair rows
+    unsigned long long ndw = 0, ndelay = 0;
+    for (int b=0; b<STATS_NBINS; b++) {
+        ndw += ds.dw_hist[b];
+        ndelay += ds.delay_hist[b];
+    }
+    expect("decoder dw_hist total", ndw, ds.nrepair);
+    expect("decoder delay_hist total", ndelay, SNUM);
+    if (ds.madd_bytes == 0 || ds.madd_bytes % PKTSIZE != 0) {
+        printf("[Error] decoder madd_bytes: %llu\n", ds.madd_bytes);
+        errors++;
+    }
+    for (int i=0; i<SNUM; i++) {
+        memset(buf, i + 1, PKTSIZE);
+        if (memcmp(RECOVERED(dc, i), buf, PKTSIZE) != 0) {
+            printf("[Error] source packet %d is not recovered correctly\n", i);
+            errors++;
+        }
+        free_packet(src[i]);
+    }
+    for (int i=0; i<NBATCH; i++)
+        free_packet(batch[i]);
+    free_packet(full);
+    free_packet(shrt);
+    free_encoder(ec);
+    free_decoder(dc);
+
+    if (errors == 0)
+        printf("[Summary] All encoder and decoder counters match\n");
+    printf("[Summary] decoder madd_bytes: %llu elim_ns: %llu errors: %d\n", ds.madd_bytes, ds.elim_ns, errors);
+    return errors != 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Test the C++ codec templates (streamcodec.hpp) over a link with Bernoulli
+ * packet loss, and their wire compatibility with the C API.
+ *
+ * For each field and both wire formats, the packets of a StreamEncoder are fed
+ * to a StreamDecoder and to a C decoder, and the packets of a C encoder of the
+ * same code to a second StreamDecoder; all three must recover every source
+ * packet. A repair packet is inserted after every repfreq source packets, and
+ * the encoders flush what both decoders have recovered in order. The encoding
+ * time of the C++ and C encoders is reported for comparison. Every packet is
+ * serialized into a buffer of its serialized size, whatever the width of its
+ * window, and a packet that fails to serialize, parse or decode fails the run.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../streamcodec.hpp"
+
+using namespace streamc;
+
+#define PKTSIZE 1024
+
+static double elapsed(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+template <class Field>
+static int run(const char *name, int wireformat, int snum, double pe, int repfreq)
+{
+    StreamEncoder<Field, PKTSIZE> enc(1, wireformat);
+    StreamDecoder<Field, PKTSIZE> dec(1);           // of enc
+    StreamDecoder<Field, PKTSIZE> cdec(1);          // of the C encoder
+    struct parameters cp = enc.params();
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct decoder *dc = initialize_decoder(&cp);
+    set_wire_format(ec, wireformat);
+
+    std::vector<uint8_t> buf((size_t) snum * PKTSIZE);
+    for (auto &b : buf)
+        b = rand() % 256;
+    for (int i=0; i<snum; i++) {
+        enc.enqueue(&buf[(size_t) i * PKTSIZE]);
+        enqueue_packet(ec, i, &buf[(size_t) i * PKTSIZE]);
+    }
+    std::vector<uint8_t> wire;             // sized to each packet, windows are not bounded
+    double tcpp = 0, tc = 0;
+    int correct = 1;
+    for (int n=0; dec.inorder() < snum-1 || dc->inorder < snum-1 || cdec.inorder() < snum-1; n++) {
+        bool repair = enc.nextsid() >= snum || (enc.nextsid() > enc.headsid() && n % (repfreq + 1) == repfreq);
+        bool lost = rand() % 10000 < pe * 10000;
+        auto t0 = std::chrono::steady_clock::now();
+        Packet<PKTSIZE> pkt = repair ? enc.output_repair() : enc.output_source();
+        tcpp += elapsed(t0);
+        if (pkt && !lost) {
+            wire.resize(enc.serialized_size(pkt));
+            int len = enc.serialize(pkt, wire.data(), wire.size());
+            struct packet *p = len < 0 ? NULL : deserialize_packet(dc, wire.data());
+            if (len < 0 || dec.receive(wire.data(), len) < 0 || p == NULL || receive_packet(dc, p) < 0) {
+                printf("[Error] %s: C++ packet %d of EW [%d, %d] (%d bytes) is not received\n",
+                       name, n, pkt.win_s, pkt.win_e, len);
+                correct = 0;
+                break;
+            }
+        }
+        t0 = std::chrono::steady_clock::now();
+        struct packet *cpkt = repair ? output_repair_packet(ec) : output_source_packet(ec);
+        tc += elapsed(t0);
+        if (cpkt != NULL && !lost) {
+            wire.resize(serialized_size(ec, cpkt));
+            int len = serialize_packet_into(ec, cpkt, wire.data(), wire.size());
+            if (len < 0 || cdec.receive(wire.data(), len) < 0) {
+                printf("[Error] %s: C packet %d of EW [%d, %d] (%d bytes) is not received\n",
+                       name, n, cpkt->win_s, cpkt->win_e, len);
+                free_packet(cpkt);
+                correct = 0;
+                break;
+            }
+        }
+        free_packet(cpkt);
+        // instant feedback
+        int ack = dec.inorder() < dc->inorder ? dec.inorder() : dc->inorder;
+        if (cdec.inorder() < ack)
+            ack = cdec.inorder();
+        if (ack >= enc.headsid()) {
+            enc.flush_acked(ack);
+            flush_acked_packets(ec, ack);
+        }
+    }
+
+    // nothing to compare if the transfer was cut short
+    int ncheck = !correct ? 0 : snum > dc->recvsize ? dc->recvsize : snum;
+    for (int i=snum-1; i>snum-1-ncheck; i--) {
+        const uint8_t *orig = &buf[(size_t) i * PKTSIZE];
+        if (memcmp(orig, dec.recovered(i), PKTSIZE) != 0
+            || memcmp(orig, RECOVERED(dc, i), PKTSIZE) != 0
+            || memcmp(orig, cdec.recovered(i), PKTSIZE) != 0) {
+            correct = 0;
+            printf("[Warning] %s: recovered %d is NOT identical to original.\n", name, i);
+        }
+    }
+    printf("[Summary] %-8s %-7s packets sent: %d  C++ encode %.3f s  C encode %.3f s  %s\n",
+           name, wireformat == WIRE_COMPACT ? "compact" : "legacy", enc.count(), tcpp, tc,
+           correct ? "all recovered" : "FAILED");
+    free_encoder(ec);
+    free_decoder(dc);
+    return correct;
+}
+
+char usage[] = "Usage: ./programName snum epsilon repfreq\n\
+                       snum     - number of source packets to transmit\n\
+                       epsilon  - erasure probability\n\
+                       repfreq  - a repair packet every repfreq source packets\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 4) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int snum = atoi(argv[1]);
+    double pe = atof(argv[2]);
+    int repfreq = atoi(argv[3]);
+    srand(1);
+    int correct = 1;
+    for (int wf : { WIRE_LEGACY, WIRE_COMPACT }) {
+        correct &= run<GF2>("GF(2)", wf, snum, pe, repfreq);
+        correct &= run<GF256>("GF(2^8)", wf, snum, pe, repfreq);
+        correct &= run<GF65536>("GF(2^16)", wf, snum, pe, repfreq);
+    }
+    return correct ? 0 : 1;
+}
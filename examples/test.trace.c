@@ -0,0 +1,202 @@
+/*
+ * Test of the event trace (trace.h) of a decoder.
+ *
+ * Source packets are streamed over a Bernoulli erasure channel with a repair
+ * packet after every repfreq source packets, and the encoder is flushed every
+ * Tfb slots with the in-order id of the decoder, whose tracer is much smaller
+ * than the trace of the stream. Meanwhile, a second thread keeps dumping the
+ * tracer, and every dump must be consistent although the rings wrap while it is
+ * copied: events numbered contiguously from trace_header.first, timestamps not
+ * decreasing, and each attached packet parsing to the source and repair ids of
+ * its TRACE_RECEIVE event, with the right symbols for source packets. The final
+ * dump is written to dumpfile, if given, for examples/replay.c.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o trace test.trace.c -L.. -lstreamc -lpthread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../streamcodec.h"
+#include "../wireformat.h"
+
+#define MAXPKT  65536
+
+static struct parameters cp;
+static struct tracer *tr;
+static atomic_int done;
+static int errors;
+
+static void fill(unsigned char *buf, int sid)
+{
+    unsigned int x = sid * 2654435761u + 1;
+    for (int i=0; i<cp.pktsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+// Check a dump read from fp, returning the number of errors
+static int check_dump(FILE *fp, struct trace_header *th)
+{
+    struct decoder *dc = initialize_decoder(&cp);
+    unsigned char *pktstr = malloc(MAXPKT);
+    unsigned char *buf = malloc(cp.pktsize);
+    struct trace_event ev;
+    uint64_t ts = 0, n = 0;
+    int nerr = 0;
+    if (trace_read_header(fp, th) != 0) {
+        printf("[Error] dump header unreadable\n");
+        nerr++;
+        th->nevents = 0;
+    }
+    while (n < th->nevents && trace_read_event(fp, &ev, pktstr, MAXPKT) == 0) {
+        n++;
+        if (ev.ts < ts || ev.type < TRACE_ENQUEUE || ev.type > TRACE_PARK) {
+            if (nerr++ < 10)
+                printf("[Error] event %lu torn: type %d ts %lu\n",
+                       (unsigned long) (th->first + n - 1), ev.type, (unsigned long) ev.ts);
+            continue;
+        }
+        ts = ev.ts;
+        if (ev.type != TRACE_RECEIVE || ev.len == 0)
+            continue;
+        struct packet *rpkt = NULL;
+        if (wire_length(&cp, pktstr, ev.len) == ev.len)
+            rpkt = deserialize_packet(dc, pktstr);
+        int ok = rpkt != NULL && rpkt->sourceid == ev.a && rpkt->repairid == ev.b;
+        if (ok && rpkt->repairid < 0) {
+            fill(buf, rpkt->sourceid);
+            ok = memcmp(rpkt->syms, buf, cp.pktsize) == 0;
+        }
+        if (!ok && nerr++ < 10)
+            printf("[Error] packet of event %lu (sourceid %d, repairid %d) torn\n",
+                   (unsigned long) (th->first + n - 1), ev.a, ev.b);
+    }
+    if (n != th->nevents) {
+        printf("[Error] %lu events read of %lu dumped\n", (unsigned long) n, (unsigned long) th->nevents);
+        nerr++;
+    }
+    free(buf);
+    free(pktstr);
+    free_decoder(dc);
+    return nerr;
+}
+
+static void send(struct encoder *ec, struct decoder *dc, struct packet *pkt, double pe)
+{
+    unsigned char *pktstr = serialize_packet(ec, pkt);
+    free_packet(pkt);
+    if (rand() % 1000 >= pe * 1000)
+        receive_packet(dc, deserialize_packet(dc, pktstr));
+    free_serialized_packet(pktstr);
+}
+
+static void *dump_trace(void *arg)
+{
+    long *ndumps = arg;
+    while (!atomic_load(&done)) {
+        FILE *fp = tmpfile();
+        struct trace_header th;
+        if (fp == NULL || trace_dump(tr, fp) < 0) {
+            printf("[Error] trace_dump() failed\n");
+            errors++;
+            break;
+        }
+        rewind(fp);
+        errors += check_dump(fp, &th);
+        fclose(fp);
+        (*ndumps)++;
+    }
+    return NULL;
+}
+
+char usage[] = "Usage: ./programName snum epsilon repfreq Tfb nevents blobsize [dumpfile]\n\
+                       snum     - number of source packets to transmit\n\
+                       epsilon  - erasure probability\n\
+                       repfreq  - a repair packet every repfreq source packets\n\
+                       Tfb      - feedback period in time slots\n\
+                       nevents  - capacity of the event ring\n\
+                       blobsize - capacity of the byte ring\n\
+                       dumpfile - where to write the final dump\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 7 && argc != 8) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    int snum     = atoi(argv[1]);
+    double pe    = atof(argv[2]);
+    int repfreq  = atoi(argv[3]);
+    int Tfb      = atoi(argv[4]);
+    int nevents  = atoi(argv[5]);
+    int blobsize = atoi(argv[6]);
+    cp.gfpower = 8;
+    cp.pktsize = 200;
+    cp.seed    = 0;
+    cp.coemode = COE_COUNTER;
+    srand(1);
+
+    unsigned char *buf = malloc(cp.pktsize);
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct decoder *dc = initialize_decoder(&cp);
+    set_wire_format(ec, WIRE_COMPACT);
+    tr = trace_create(nevents, blobsize);
+    set_decoder_trace(dc, tr);
+    long ndumps = 0;
+    pthread_t dumper;
+    pthread_create(&dumper, NULL, dump_trace, &ndumps);
+
+    int slot = 0, nsent = 0;
+    while (dc->inorder < snum - 1) {
+        if (nsent < snum) {
+            fill(buf, nsent);
+            enqueue_packet(ec, nsent, buf);
+            send(ec, dc, output_source_packet(ec), pe);
+            if (++nsent % repfreq == 0)
+                send(ec, dc, output_repair_packet(ec), pe);
+        } else {
+            send(ec, dc, output_repair_packet(ec), pe);
+        }
+        if (++slot % Tfb == 0)
+            flush_acked_packets(ec, dc->inorder);
+    }
+    atomic_store(&done, 1);
+    pthread_join(dumper, NULL);
+
+    struct trace_header th = { 0 };
+    FILE *fp = tmpfile();
+    if (fp == NULL || trace_dump(tr, fp) < 0) {
+        printf("[Error] trace_dump() failed\n");
+        errors++;
+    } else {
+        rewind(fp);
+        errors += check_dump(fp, &th);
+        fclose(fp);
+        if (th.first == 0 || th.first + th.nevents != atomic_load(&tr->head)) {
+            printf("[Error] final dump covers events [%lu, %lu), expected up to %lu, wrapped\n",
+                   (unsigned long) th.first, (unsigned long) (th.first + th.nevents),
+                   (unsigned long) atomic_load(&tr->head));
+            errors++;
+        }
+    }
+    if (argc == 8 && trace_dump_file(tr, argv[7]) < 0) {
+        printf("[Error] cannot write %s\n", argv[7]);
+        errors++;
+    }
+    set_decoder_trace(dc, NULL);
+    trace_free(tr);
+    free_encoder(ec);
+    free_decoder(dc);
+    free(buf);
+
+    if (errors == 0)
+        printf("[Summary] All concurrent dumps of the wrapped trace are consistent\n");
+    printf("[Summary] snum: %d erasure: %.3f events: %lu dumps: %ld errors: %d\n",
+           snum, pe, (unsigned long) th.first + th.nevents, ndumps, errors);
+    return errors != 0;
+}
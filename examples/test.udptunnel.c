@@ -0,0 +1,183 @@
+/*
+ * End-to-end test of the batched UDP tunnel (udptunnel.h) over loopback.
+ *
+ * A sender endpoint streams npkts source packets to a receiver endpoint on
+ * 127.0.0.1, each on its own thread. The loss shim of the sender drops data
+ * datagrams with a Gilbert-Elliott channel of loss rate epsilon and mean burst
+ * length burst, and the one of the receiver drops feedback with probability
+ * fbloss. The sender keeps at most window unacknowledged source packets in
+ * flight, i.e., feedback drives both flushing and flow control. Every
+ * delivered packet is checked against the data sent. Reported are the packets
+ * per second per core of each side, i.e., datagrams handled over the CPU time
+ * of its thread, and the system calls per datagram.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o udptunnel test.udptunnel.c ../udptunnel.c -L.. -lstreamc -lpthread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../udptunnel.h"
+#include "../wireformat.h"
+
+struct side {
+    struct udp_tunnel *ut;
+    double  cpu;                    // CPU seconds of its thread
+};
+
+static struct parameters cp;
+static int npkts, window;
+static atomic_int done;             // the sender got everything acknowledged
+static int expect, errors;
+
+static double thread_cpu(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fill(unsigned char *buf, int sid)
+{
+    unsigned int x = sid * 2654435761u + 1;
+    for (int i=0; i<cp.pktsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+static void deliver(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    unsigned char *ref = arg;
+    (void) dc;
+    fill(ref, sourceid);
+    if (sourceid != expect || memcmp(ref, syms, cp.pktsize) != 0)
+        errors++;
+    expect = sourceid + 1;
+}
+
+static void *sender(void *arg)
+{
+    struct side *s = arg;
+    struct encoder *ec = ut_encoder(s->ut);
+    unsigned char *batch = malloc((size_t) UT_BATCH * cp.pktsize);
+    int nsent = 0;
+    double t0 = thread_cpu();
+    while (nsent < npkts) {
+        int room = window - (ec->nextsid - (ec->head != -1 ? ec->headsid : ec->nextsid));
+        int n = npkts - nsent < UT_BATCH ? npkts - nsent : UT_BATCH;
+        if (n > room)
+            n = room;
+        if (n <= 0) {
+            ut_poll(s->ut, 1);      // window full, wait for feedback
+            continue;
+        }
+        for (int i=0; i<n; i++)
+            fill(batch + (size_t) i * cp.pktsize, nsent + i);
+        ut_send(s->ut, batch, n);
+        nsent += n;
+        ut_poll(s->ut, 0);
+    }
+    while (ut_unacked(s->ut))
+        ut_poll(s->ut, 2);
+    s->cpu = thread_cpu() - t0;
+    atomic_store(&done, 1);
+    free(batch);
+    return NULL;
+}
+
+static void *receiver(void *arg)
+{
+    struct side *s = arg;
+    double t0 = thread_cpu();
+    while (!atomic_load(&done))
+        ut_poll(s->ut, 1);
+    s->cpu = thread_cpu() - t0;
+    return NULL;
+}
+
+char usage[] = "Usage: ./programName npkts pktsize repfreq epsilon burst fbloss window\n\
+                       npkts    - number of source packets to transmit\n\
+                       pktsize  - bytes per packet\n\
+                       repfreq  - send a repair packet after every repfreq source packets\n\
+                       epsilon  - loss rate of the data datagrams\n\
+                       burst    - mean loss burst length, 1 for Bernoulli losses\n\
+                       fbloss   - loss probability of the feedback datagrams\n\
+                       window   - maximum unacknowledged source packets in flight\n";
+int main(int argc, char *argv[])
+{
+    if (argc != 8) {
+        printf("%s\n", usage);
+        exit(1);
+    }
+    npkts = atoi(argv[1]);
+    cp.gfpower = 8;
+    cp.pktsize = atoi(argv[2]);
+    cp.repfreq = atof(argv[3]);
+    cp.seed    = 1;
+    cp.coemode = COE_COUNTER;
+    double pe = atof(argv[4]);
+    double burst = atof(argv[5]);
+    double fbloss = atof(argv[6]);
+    window = atoi(argv[7]);
+
+    struct side tx = { ut_open(&cp, "127.0.0.1", 0, 0), 0 };
+    struct side rx = { ut_open(&cp, "127.0.0.1", 0, 0), 0 };
+    if (tx.ut == NULL || rx.ut == NULL) {
+        printf("[Error] cannot open the endpoints\n");
+        exit(1);
+    }
+    int port, fbport;
+    ut_ports(rx.ut, &port, &fbport);
+    ut_connect(tx.ut, "127.0.0.1", port, fbport);
+    ut_ports(tx.ut, &port, &fbport);
+    ut_connect(rx.ut, "127.0.0.1", port, fbport);
+    set_wire_format(ut_encoder(tx.ut), WIRE_COMPACT);
+    ut_set_loss(tx.ut, pe, burst, 0, 1);
+    ut_set_loss(rx.ut, 0, 1, fbloss, 2);
+    unsigned char *ref = malloc(cp.pktsize);
+    set_delivery_callback(ut_decoder(rx.ut), deliver, ref);
+
+    double t0 = now();
+    pthread_t ttx, trx;
+    pthread_create(&trx, NULL, receiver, &rx);
+    pthread_create(&ttx, NULL, sender, &tx);
+    pthread_join(ttx, NULL);
+    pthread_join(trx, NULL);
+    double wall = now() - t0;
+
+    struct ut_stats st, sr;
+    ut_get_stats(tx.ut, &st);
+    ut_get_stats(rx.ut, &sr);
+    int correct = errors == 0 && expect == npkts;
+    if (correct)
+        printf("[Summary] All source packets are delivered in order and identical to the original\n");
+    else
+        printf("[Warning] %d delivery errors, %d of %d packets delivered\n", errors, expect, npkts);
+    unsigned long long nout = st.nsource + st.nrepair;
+    printf("[Summary] sent: %llu source %llu repair (%llu probes, %llu spared as in flight) dropped: %llu feedback received: %llu\n",
+           st.nsource, st.nrepair, st.nprobe, st.nspared, st.dropped, st.fbrecv);
+    printf("[Summary] received: %llu (%llu bad) feedback sent: %llu dropped: %llu\n",
+           sr.nrecv, sr.nbad, sr.fbsent, sr.dropped);
+    printf("[Summary] sender: %.0f packets/s per core, %.3f syscalls per packet\n",
+           nout / tx.cpu, (double) st.nsyscall / nout);
+    printf("[Summary] receiver: %.0f packets/s per core, %.3f syscalls per packet\n",
+           sr.nrecv / rx.cpu, (double) sr.nsyscall / (sr.nrecv ? sr.nrecv : 1));
+    printf("[Summary] goodput: %.1f MB/s in %.3f s\n", (double) npkts * cp.pktsize / wall / 1e6, wall);
+    ut_close(tx.ut);
+    ut_close(rx.ut);
+    free(ref);
+    return correct ? 0 : 1;
+}
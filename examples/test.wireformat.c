@@ -0,0 +1,224 @@
+/*
+ * Test of the wire formats (wireformat.h).
+ *
+ * Source and repair packets, over windows at small and at large source ids so
+ * that every varint width is used, are serialized in the legacy and compact
+ * formats, in GF(2), GF(2^8) and GF(2^16), with COE_MT19937 and COE_COUNTER
+ * coefficients, and must:
+ *  - round-trip through deserialize_packet(), with the same header fields,
+ *    coefficients (regenerated if elided) and symbols, and wire_length() equal
+ *    to serialized_size();
+ *  - be rejected by deserialize_compact() with any single bit of the compact
+ *    header flipped, i.e., with a corrupt checksum;
+ *  - be rejected by wire_length() and deserialize_compact() when truncated to
+ *    any shorter length. Each truncated copy is held in a buffer of its exact
+ *    length, so that a read past it is caught by, e.g., -fsanitize=address.
+ * Decoder feedback must round-trip and be rejected when truncated likewise,
+ * and feedback with a valid checksum but offsets that take an id past INT_MAX
+ * must be rejected.
+ * Packets whose window, or the decoding window they would open, is wider than
+ * DEC_DWMAX must be rejected by receive_packet() before any band is reserved.
+ *
+ * Build against the library, e.g., from this folder:
+ *      gcc -O2 -o wireformat test.wireformat.c -L.. -lstreamc
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../streamcodec.h"
+#include "../wireformat.h"
+
+#define PKTSIZE 32
+
+static int errors;
+
+static void check(int ok, const char *what, int gfpower, int coemode, int format, int sid, int rid)
+{
+    if (!ok && errors++ < 20)
+        printf("[Error] %s: GF(2^%d) coemode %d format %d source %d repair %d\n",
+               what, gfpower, coemode, format, sid, rid);
+}
+
+// Check one serialized packet against pkt, the packet it was serialized from
+static void check_packet(struct encoder *ec, struct decoder *dc, struct packet *pkt)
+{
+    struct parameters *cp = ec->cp;
+    int g = cp->gfpower, m = cp->coemode, f = ec->wireformat;
+    int sid = pkt->sourceid, rid = pkt->repairid;
+    int nb = COEBYTES(g);
+    int size = serialized_size(ec, pkt);
+    unsigned char *str = serialize_packet(ec, pkt);
+    check(wire_length(cp, str, size) == size, "wire_length", g, m, f, sid, rid);
+
+    struct packet *rpkt = deserialize_packet(dc, str);
+    check(rpkt != NULL, "round trip", g, m, f, sid, rid);
+    if (rpkt != NULL) {
+        int ok = rpkt->sourceid == sid && rpkt->repairid == rid
+                 && memcmp(rpkt->syms, pkt->syms, cp->pktsize) == 0;
+        if (rid >= 0)
+            ok = ok && rpkt->win_s == pkt->win_s && rpkt->win_e == pkt->win_e
+                 && memcmp(rpkt->coes, pkt->coes, (pkt->win_e - pkt->win_s + 1) * nb) == 0;
+        check(ok, "round trip fields", g, m, f, sid, rid);
+    }
+
+    struct packet v;
+    if (f == WIRE_COMPACT) {
+        unsigned char hdr[WIRE_MAXHDR];
+        int hlen = compact_header(cp, pkt, hdr);
+        for (int i=0; i<hlen; i++) {
+            for (int b=0; b<8; b++) {
+                str[i] ^= 1 << b;
+                check(deserialize_compact(cp, str, size, &v) < 0, "corrupt header accepted", g, m, f, sid, rid);
+                check(deserialize_packet(dc, str) == NULL, "corrupt packet accepted", g, m, f, sid, rid);
+                str[i] ^= 1 << b;
+            }
+        }
+    }
+    for (int len=0; len<size; len++) {
+        unsigned char *trunc = malloc(len > 0 ? len : 1);
+        memcpy(trunc, str, len);
+        check(wire_length(cp, trunc, len) < 0, "truncated length accepted", g, m, f, sid, rid);
+        if (f == WIRE_COMPACT)
+            check(deserialize_compact(cp, trunc, len, &v) < 0, "truncated packet accepted", g, m, f, sid, rid);
+        free(trunc);
+    }
+    free_serialized_packet(str);
+}
+
+static void check_feedback(void)
+{
+    struct dec_feedback fb = { 70000, 70003, 70400, 5, 3, { { 70003, 2 }, { 70100, 1 }, { 70390, 9 } } };
+    struct dec_feedback rfb;
+    unsigned char buf[WIRE_MAXFB];
+    int n = serialize_feedback(&fb, buf, sizeof(buf));
+    int ok = n > 0 && deserialize_feedback(buf, n, &rfb) == n && rfb.inorder == fb.inorder
+             && rfb.win_s == fb.win_s && rfb.win_e == fb.win_e && rfb.deficit == fb.deficit
+             && rfb.nruns == fb.nruns && memcmp(rfb.runs, fb.runs, sizeof(int) * 2 * fb.nruns) == 0;
+    check(ok, "feedback round trip", 0, 0, 0, -1, -1);
+    for (int len=0; len<n; len++) {
+        unsigned char *trunc = malloc(len > 0 ? len : 1);
+        memcpy(trunc, buf, len);
+        check(deserialize_feedback(trunc, len, &rfb) < 0, "truncated feedback accepted", 0, 0, 0, -1, -1);
+        free(trunc);
+    }
+}
+
+static void check_wide(void)
+{
+    struct parameters cp = {0};
+    cp.gfpower = 8;
+    cp.pktsize = PKTSIZE;
+    cp.coemode = COE_COUNTER;
+    struct decoder *dc = initialize_decoder(&cp);
+    GF_ELEMENT coes[1] = { 1 }, syms[PKTSIZE] = { 0 };
+    struct packet wide = { -1, 0, 0, DEC_DWMAX, coes, syms };         // one column too many
+    struct packet far  = { -1, 1, 0x7ffffff0, 0x7fffffff, NULL, syms };// elided coefficients
+    struct packet src  = { 0x7fffffff, -1, -1, -1, NULL, syms };      // opens [0, INT_MAX]
+    check(receive_packet(dc, &wide) < 0 && receive_packet(dc, &far) < 0 && dc->dwcap == 0,
+          "wide window accepted", 8, COE_COUNTER, 0, -1, 0);
+    check(receive_packet(dc, &src) < 0 && dc->dwcap == 0, "far source packet accepted", 8, COE_COUNTER, 0, 0x7fffffff, -1);
+    free_decoder(dc);
+}
+
+// Feedback of the varints v, with a valid checksum (see wireformat.c)
+static int forge_feedback(const unsigned int *v, int nv, unsigned char *buf)
+{
+    int n = 4;
+    buf[0] = WIRE_FB_MAGIC;
+    buf[1] = WIRE_VERSION;
+    for (int i=0; i<nv; i++) {
+        unsigned int x = v[i];
+        for (; x >= 0x80; x >>= 7)
+            buf[n++] = (x & 0x7f) | 0x80;
+        buf[n++] = x;
+    }
+    unsigned int s1 = 0, s2 = 0;
+    for (int i=0; i<n; i++) {
+        if (i == 2 || i == 3)
+            continue;
+        s1 = (s1 + buf[i]) % 255;
+        s2 = (s2 + s1) % 255;
+    }
+    buf[2] = s1;
+    buf[3] = s2;
+    return n;
+}
+
+static void check_feedback_overflow(void)
+{
+    static const struct {
+        unsigned int v[7];
+        int nv, ok;
+    } cases[] = {
+        { { INT_MAX, 0, 0, 0, 0 }, 5, 1 },              // inorder INT_MAX-1, empty window at INT_MAX
+        { { INT_MAX, 1, 1, 0, 0 }, 5, 0 },              // win_s past INT_MAX
+        { { 0, INT_MAX, 2, 0, 0 }, 5, 0 },              // win_e past INT_MAX
+        { { 0, 0, 1, 0, 1, INT_MAX, 1 }, 7, 0 },        // run ending past INT_MAX
+        { { 0, 0, 1, 0, 1, INT_MAX - 1, 1 }, 7, 1 },    // run ending at INT_MAX
+    };
+    unsigned char buf[WIRE_MAXFB];
+    struct dec_feedback rfb;
+    for (int i=0; i<(int) (sizeof(cases) / sizeof(cases[0])); i++) {
+        int n = forge_feedback(cases[i].v, cases[i].nv, buf);
+        check((deserialize_feedback(buf, n, &rfb) == n) == cases[i].ok, "feedback offsets past INT_MAX", 0, 0, 0, -1, i);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+    int gfpowers[3] = { 1, 8, 16 };
+    int starts[3] = { 0, 200, 70000 };     // first source id of the windows, 1-, 2- and 3-byte varints
+    unsigned char buf[PKTSIZE];
+    long npkts = 0;
+    for (int g=0; g<3; g++) {
+        for (int m=COE_MT19937; m<=COE_COUNTER; m++) {
+            for (int f=WIRE_LEGACY; f<=WIRE_COMPACT; f++) {
+                for (int k=0; k<3; k++) {
+                    struct parameters cp = {0};
+                    cp.gfpower = gfpowers[g];
+                    cp.pktsize = PKTSIZE;
+                    cp.seed    = 5;
+                    cp.coemode = m;
+                    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+                    struct decoder *dc = initialize_decoder(&cp);
+                    set_wire_format(ec, f);
+                    for (int sid=0; sid<starts[k]+40; sid++) {
+                        for (int i=0; i<PKTSIZE; i++)
+                            buf[i] = sid * 31 + i;
+                        enqueue_packet(ec, sid, buf);
+                        struct packet *pkt = output_source_packet(ec);
+                        if (sid >= starts[k]) {
+                            check_packet(ec, dc, pkt);
+                            npkts++;
+                        }
+                        free_packet(pkt);
+                        if (sid < starts[k])
+                            flush_acked_packets(ec, sid);
+                        if (sid >= starts[k] && sid % 7 == 0) {
+                            pkt = output_repair_packet(ec);
+                            check_packet(ec, dc, pkt);
+                            free_packet(pkt);
+                            pkt = output_repair_packet_short(ec, 3);
+                            check_packet(ec, dc, pkt);
+                            free_packet(pkt);
+                            npkts += 2;
+                        }
+                    }
+                    free_encoder(ec);
+                    free_decoder(dc);
+                }
+            }
+        }
+    }
+    check_feedback();
+    check_feedback_overflow();
+    check_wide();
+
+    if (errors == 0)
+        printf("[Summary] %ld packets round-trip, and are rejected when corrupt or truncated\n", npkts);
+    printf("[Summary] errors: %d\n", errors);
+    return errors != 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * Decoder feedback summary and targeted repair packets. The summary is
+ * built from the decoding-window rows of the decoder: a source id in the
+ * window whose row is empty is missing, and the number of empty rows is the
+ * rank deficit. See struct dec_feedback in streamcodec.h, and wireformat.h for
+ * its serialized form.
+ */
+#include "streamcodec.h"
+
+void get_decoder_feedback(struct decoder *dc, struct dec_feedback *fb)
+{
+    fb->inorder = dc->inorder;
+    fb->win_s   = dc->inorder + 1;
+    fb->win_e   = dc->inorder;
+    fb->deficit = 0;
+    fb->nruns   = 0;
+    if (!dc->active)
+        return;
+    if (dc->win_s > fb->win_s)
+        fb->win_s = dc->win_s;
+    fb->win_e = dc->win_e;
+    for (int sid=fb->win_s; sid<=fb->win_e; sid++) {
+        if (dc->rlen[sid % dc->dwcap] != 0)
+            continue;
+        fb->deficit++;
+        int r = fb->nruns - 1;
+        if (r >= 0 && (fb->runs[r][0] + fb->runs[r][1] == sid || fb->nruns == FB_MAXRUNS)) {
+            fb->runs[r][1] = sid - fb->runs[r][0] + 1;      // extend, or merge into the last run
+        } else {
+            fb->runs[fb->nruns][0] = sid;
+            fb->runs[fb->nruns][1] = 1;
+            fb->nruns++;
+        }
+    }
+}
+
+int output_targeted_repairs(struct encoder *ec, const struct dec_feedback *fb, struct packet **pkts, int max)
+{
+    if (fb->inorder >= ec->headsid)
+        flush_acked_packets(ec, fb->inorder);
+    if (fb->nruns <= 0 || fb->deficit <= 0)
+        return 0;
+    int win_s = fb->runs[0][0];
+    int win_e = fb->runs[fb->nruns-1][0] + fb->runs[fb->nruns-1][1] - 1;
+    int n = 0;
+    while (n < fb->deficit && n < max) {
+        pkts[n] = output_repair_packet_range(ec, win_s, win_e);
+        if (pkts[n] == NULL)
+            break;
+        n++;
+    }
+    return n;
+}
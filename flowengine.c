@@ -0,0 +1,455 @@
+/*
+ * Sharded multi-flow codec engine. See flowengine.h.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "flowengine.h"
+#include "decslot.h"
+#include "wireformat.h"
+
+#define FE_BATCH        32          // requests a worker takes off its queue at a time
+#define FE_SPINS        256         // empty polls before a worker starts sleeping
+#define FE_SLEEP_NS     20000
+#define FE_SWEEP        4096        // minimum requests between sweeps parking the decoders of idle flows
+#define FE_RECV         1024        // recovered ring of flow decoders, covering the ACK lag of the queues
+
+struct fe_flow {
+    uint32_t            id;
+    struct parameters   cp;
+    struct encoder      *ec;
+    struct dec_slot     ds;         // decoder, parked while the flow is idle
+    int                 recent;     // received a packet since the last sweep
+    struct tracer       *trace;
+    struct fe_worker    *w;
+    struct fe_flow      *next;      // hash chain
+};
+
+// bounded MPSC queue, D. Vyukov's sequence-numbered ring
+struct fe_cell {
+    _Atomic size_t      seq;
+    struct fe_req       req;
+};
+
+struct fe_worker {
+    struct flow_engine  *fe;
+    int                 index;
+    pthread_t           tid;
+    struct fe_cell      *rq;
+    struct fe_cpl       *cq;
+    size_t              mask;
+    _Alignas(CACHELINE) _Atomic size_t rq_tail;     // next request slot, claimed by producers
+    _Alignas(CACHELINE) size_t         rq_head;     // worker only
+    _Alignas(CACHELINE) _Atomic size_t cq_tail;     // written by the worker
+    _Alignas(CACHELINE) _Atomic size_t cq_head;     // written by the completion thread
+    // flows owned by the worker, touched by its thread only
+    _Alignas(CACHELINE) struct fe_flow **buckets;
+    int                 nbuckets;   // a power of 2
+    int                 nflows;
+    int                 nreq;       // requests since the last sweep
+};
+
+struct flow_engine {
+    int                 nworkers;
+    struct fe_worker    *workers;
+    FE_DELIVER_FN       deliver;
+    void                *deliver_arg;
+    atomic_int          stop;
+    int                 next_cq;    // fe_complete() starts at a different worker each time
+};
+
+static int pow2_ceil(int n)
+{
+    int p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+static int rq_push(struct fe_worker *w, const struct fe_req *req)
+{
+    size_t pos = atomic_load_explicit(&w->rq_tail, memory_order_relaxed);
+    struct fe_cell *cell;
+    for (;;) {
+        cell = &w->rq[pos & w->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t) seq - (intptr_t) pos;
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&w->rq_tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            return -1;              // full
+        } else {
+            pos = atomic_load_explicit(&w->rq_tail, memory_order_relaxed);
+        }
+    }
+    cell->req = *req;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+static int rq_pop(struct fe_worker *w, struct fe_req *req)
+{
+    struct fe_cell *cell = &w->rq[w->rq_head & w->mask];
+    if (atomic_load_explicit(&cell->seq, memory_order_acquire) != w->rq_head + 1)
+        return -1;                  // empty
+    *req = cell->req;
+    atomic_store_explicit(&cell->seq, w->rq_head + w->mask + 1, memory_order_release);
+    w->rq_head++;
+    return 0;
+}
+
+// wait while the completion queue is full, i.e., for fe_complete() to drain it;
+// -1 if the engine stopped meanwhile and the completion was not queued
+static int cq_push(struct fe_worker *w, const struct fe_cpl *cpl)
+{
+    size_t tail = atomic_load_explicit(&w->cq_tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&w->cq_head, memory_order_acquire) > w->mask) {
+        if (atomic_load_explicit(&w->fe->stop, memory_order_relaxed))
+            return -1;
+        sched_yield();
+    }
+    w->cq[tail & w->mask] = *cpl;
+    atomic_store_explicit(&w->cq_tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+static struct fe_flow *find_flow(struct fe_worker *w, uint32_t id)
+{
+    struct fe_flow *f = w->buckets[id & (w->nbuckets - 1)];
+    while (f != NULL && f->id != id)
+        f = f->next;
+    return f;
+}
+
+static void insert_flow(struct fe_worker *w, struct fe_flow *f)
+{
+    if (w->nflows >= w->nbuckets) {
+        int n = w->nbuckets * 2;
+        struct fe_flow **b = calloc(n, sizeof(struct fe_flow *));
+        if (b != NULL) {
+            for (int i=0; i<w->nbuckets; i++) {
+                struct fe_flow *g = w->buckets[i], *next;
+                for (; g != NULL; g = next) {
+                    next = g->next;
+                    g->next = b[g->id & (n - 1)];
+                    b[g->id & (n - 1)] = g;
+                }
+            }
+            free(w->buckets);
+            w->buckets = b;
+            w->nbuckets = n;
+        }
+    }
+    struct fe_flow **head = &w->buckets[f->id & (w->nbuckets - 1)];
+    f->next = *head;
+    *head = f;
+    w->nflows++;
+}
+
+static void free_flow(struct fe_flow *f)
+{
+    free_encoder(f->ec);
+    dec_slot_free(&f->ds);
+    free(f);
+}
+
+static void remove_flow(struct fe_worker *w, uint32_t id)
+{
+    struct fe_flow **p = &w->buckets[id & (w->nbuckets - 1)];
+    while (*p != NULL && (*p)->id != id)
+        p = &(*p)->next;
+    if (*p != NULL) {
+        struct fe_flow *f = *p;
+        *p = f->next;
+        free_flow(f);
+        w->nflows--;
+    }
+}
+
+static void deliver(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    struct fe_flow *f = arg;
+    struct flow_engine *fe = f->w->fe;
+    int len = dc->cp->pktsize;
+    if (fe->deliver != NULL) {
+        fe->deliver(f->id, sourceid, syms, len, fe->deliver_arg);
+        return;
+    }
+    struct fe_cpl cpl = { f->id, FE_DELIVER, 0, len, sourceid, 0, malloc(len), NULL };
+    if (cpl.data == NULL) {
+        cpl.status = -1;
+        cpl.len = 0;
+    } else {
+        memcpy(cpl.data, syms, len);
+    }
+    if (cq_push(f->w, &cpl) < 0)
+        free(cpl.data);             // nobody is left to claim the copy
+}
+
+static struct fe_flow *open_flow(struct fe_worker *w, uint32_t id, const struct parameters *cp)
+{
+    if (cp == NULL || find_flow(w, id) != NULL)
+        return NULL;
+    struct fe_flow *f = calloc(1, sizeof(struct fe_flow));
+    if (f == NULL)
+        return NULL;
+    f->id = id;
+    f->cp = *cp;
+    f->w  = w;
+    f->ec = initialize_encoder(&f->cp, NULL, 0);
+    if (f->ec == NULL) {
+        free(f);
+        return NULL;
+    }
+    dec_slot_init(&f->ds, &f->cp, FE_RECV, deliver, f);
+    insert_flow(w, f);
+    return f;
+}
+
+static void process(struct fe_worker *w, const struct fe_req *req)
+{
+    struct fe_cpl cpl = { req->flow, req->op, -1, 0, -1, req->tag, req->data, req->out };
+    struct fe_flow *f = req->op == FE_OPEN ? NULL : find_flow(w, req->flow);
+    switch (req->op) {
+    case FE_OPEN:
+        if (open_flow(w, req->flow, (const struct parameters *) req->data) != NULL)
+            cpl.status = 0;
+        break;
+    case FE_CLOSE:
+        if (f != NULL) {
+            remove_flow(w, req->flow);
+            cpl.status = 0;
+        }
+        break;
+    case FE_SEND:
+        if (f == NULL || req->len != f->cp.pktsize)
+            break;
+        cpl.sourceid = f->ec->snum;
+        if (enqueue_packet(f->ec, cpl.sourceid, req->data) < 0)
+            break;
+        cpl.len = output_source_packet_into(f->ec, req->out, req->outcap);
+        cpl.status = cpl.len > 0 ? 0 : -1;
+        break;
+    case FE_REPAIR:
+        if (f == NULL)
+            break;
+        if (req->arg > 0)
+            cpl.len = output_repair_packet_short_into(f->ec, req->arg, req->out, req->outcap);
+        else
+            cpl.len = output_repair_packet_into(f->ec, req->out, req->outcap);
+        cpl.status = cpl.len > 0 ? 0 : -1;
+        break;
+    case FE_RECEIVE:
+        if (f == NULL)
+            break;
+        {
+            // a packet shorter or longer than its header tells is rejected unparsed
+            int len = wire_length(&f->cp, req->data, req->len);
+            if (len != req->len) {
+                TRACE(f->trace, TRACE_REJECT, req->len, len, 0);
+                break;
+            }
+            struct decoder *dc = dec_slot_get(&f->ds);
+            if (dc == NULL)
+                break;
+            if (dc->trace != f->trace)
+                set_decoder_trace(dc, f->trace);
+            struct packet *rpkt = deserialize_packet(dc, req->data);
+            if (rpkt != NULL && receive_packet(dc, rpkt) >= 0)
+                cpl.status = 0;
+            cpl.sourceid = dc->inorder;
+            f->recent = 1;
+        }
+        break;
+    case FE_ACK:
+        if (f == NULL)
+            break;
+        flush_acked_packets(f->ec, req->arg);
+        cpl.status = 0;
+        break;
+    case FE_FLUSHED:
+        if (f == NULL)
+            break;
+        dec_slot_ack(&f->ds, req->arg);
+        cpl.status = 0;
+        break;
+    case FE_TRACE:
+        if (f == NULL)
+            break;
+        f->trace = (struct tracer *) req->data;
+        set_encoder_trace(f->ec, f->trace);
+        if (f->ds.dc != NULL)
+            set_decoder_trace(f->ds.dc, f->trace);
+        cpl.status = 0;
+        break;
+    }
+    cq_push(w, &cpl);
+}
+
+// park the decoders of flows that received nothing since the last sweep, at most
+// once per FE_SWEEP requests or per flow, so sweeps cost O(1) per request
+static void sweep(struct fe_worker *w)
+{
+    for (int i=0; i<w->nbuckets; i++) {
+        for (struct fe_flow *f = w->buckets[i]; f != NULL; f = f->next) {
+            if (!f->recent && f->ds.dc != NULL && dec_slot_park(&f->ds))
+                TRACE(f->trace, TRACE_PARK, f->ds.inorder, 0, 0);
+            f->recent = 0;
+        }
+    }
+    w->nreq = 0;
+}
+
+static void *fe_worker_main(void *arg)
+{
+    struct fe_worker *w = arg;
+    struct fe_req reqs[FE_BATCH];
+    int idle = 0;
+    while (!atomic_load_explicit(&w->fe->stop, memory_order_relaxed)) {
+        int n = 0;
+        while (n < FE_BATCH && rq_pop(w, &reqs[n]) == 0)
+            n++;
+        for (int i=0; i<n; i++)
+            process(w, &reqs[i]);
+        w->nreq += n;
+        if (w->nreq >= FE_SWEEP && w->nreq >= w->nflows)
+            sweep(w);
+        if (n > 0) {
+            idle = 0;
+        } else if (++idle < FE_SPINS) {
+            sched_yield();
+        } else {
+            struct timespec ts = { 0, FE_SLEEP_NS };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+struct flow_engine *fe_create(int nworkers, int qsize, int pin)
+{
+    if (nworkers <= 0)
+        nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nworkers <= 0)
+        nworkers = 1;
+    qsize = pow2_ceil(qsize > 2 ? qsize : 2);
+    struct flow_engine *fe = calloc(1, sizeof(struct flow_engine));
+    if (fe == NULL)
+        return NULL;
+    atomic_init(&fe->stop, 0);
+    fe->workers = aligned_alloc(CACHELINE, ALIGN(sizeof(struct fe_worker) * nworkers, CACHELINE) * CACHELINE);
+    if (fe->workers == NULL) {
+        free(fe);
+        return NULL;
+    }
+    memset(fe->workers, 0, sizeof(struct fe_worker) * nworkers);
+    fe->nworkers = nworkers;
+    int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i=0; i<nworkers; i++) {
+        struct fe_worker *w = &fe->workers[i];
+        w->fe       = fe;
+        w->index    = i;
+        w->mask     = qsize - 1;
+        w->rq       = calloc(qsize, sizeof(struct fe_cell));
+        w->cq       = calloc(qsize, sizeof(struct fe_cpl));
+        w->nbuckets = 64;
+        w->buckets  = calloc(w->nbuckets, sizeof(struct fe_flow *));
+        if (w->rq == NULL || w->cq == NULL || w->buckets == NULL) {
+            fe_destroy(fe);
+            return NULL;
+        }
+        for (int j=0; j<qsize; j++)
+            atomic_init(&w->rq[j].seq, j);
+        atomic_init(&w->rq_tail, 0);
+        atomic_init(&w->cq_tail, 0);
+        atomic_init(&w->cq_head, 0);
+    }
+    for (int i=0; i<nworkers; i++) {
+        struct fe_worker *w = &fe->workers[i];
+        if (pthread_create(&w->tid, NULL, fe_worker_main, w) != 0) {
+            fe_destroy(fe);
+            return NULL;
+        }
+        if (pin && ncpu > 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i % ncpu, &set);
+            pthread_setaffinity_np(w->tid, sizeof(cpu_set_t), &set);
+        }
+    }
+    return fe;
+}
+
+void fe_set_delivery(struct flow_engine *fe, FE_DELIVER_FN deliver, void *arg)
+{
+    fe->deliver_arg = arg;
+    fe->deliver = deliver;
+}
+
+int fe_submit(struct flow_engine *fe, const struct fe_req *reqs, int n)
+{
+    for (int i=0; i<n; i++) {
+        if (rq_push(&fe->workers[reqs[i].flow % fe->nworkers], &reqs[i]) != 0)
+            return i;
+    }
+    return n;
+}
+
+int fe_complete(struct flow_engine *fe, struct fe_cpl *cpls, int max)
+{
+    int n = 0;
+    for (int k=0; k<fe->nworkers && n<max; k++) {
+        struct fe_worker *w = &fe->workers[(fe->next_cq + k) % fe->nworkers];
+        size_t head = atomic_load_explicit(&w->cq_head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&w->cq_tail, memory_order_acquire);
+        for (; head != tail && n < max; head++)
+            cpls[n++] = w->cq[head & w->mask];
+        atomic_store_explicit(&w->cq_head, head, memory_order_release);
+    }
+    fe->next_cq = (fe->next_cq + 1) % fe->nworkers;
+    return n;
+}
+
+int fe_nworkers(struct flow_engine *fe)
+{
+    return fe->nworkers;
+}
+
+void fe_destroy(struct flow_engine *fe)
+{
+    atomic_store(&fe->stop, 1);
+    for (int i=0; i<fe->nworkers; i++) {
+        struct fe_worker *w = &fe->workers[i];
+        if (w->tid != 0)
+            pthread_join(w->tid, NULL);
+    }
+    for (int i=0; i<fe->nworkers; i++) {
+        struct fe_worker *w = &fe->workers[i];
+        if (w->cq != NULL) {
+            size_t head = atomic_load(&w->cq_head), tail = atomic_load(&w->cq_tail);
+            for (; head != tail; head++) {
+                if (w->cq[head & w->mask].op == FE_DELIVER)
+                    free(w->cq[head & w->mask].data);
+            }
+        }
+        for (int j=0; w->buckets != NULL && j<w->nbuckets; j++) {
+            struct fe_flow *f = w->buckets[j], *next;
+            for (; f != NULL; f = next) {
+                next = f->next;
+                free_flow(f);
+            }
+        }
+        free(w->buckets);
+        free(w->rq);
+        free(w->cq);
+    }
+    free(fe->workers);
+    free(fe);
+}
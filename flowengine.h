@@ -0,0 +1,87 @@
+#ifndef FLOWENGINE_H
+#define FLOWENGINE_H
+/*
+ * Sharded multi-flow codec engine
+ *
+ * The engine owns the encoder and decoder of many flows, sharded by flow id
+ * across worker threads (optionally pinned to cores). A flow is only touched by
+ * the worker owning it, so the codec contexts need no locks. Requests reach a
+ * worker through its bounded lock-free MPSC queue, i.e., fe_submit() may be
+ * called from any number of threads, and results come back through one
+ * lock-free SPSC completion queue per worker, drained by fe_complete() from a
+ * single thread. Requests of a flow submitted by one thread are processed in
+ * submission order.
+ *
+ * Buffers referenced by a request (data, out) must stay valid until its
+ * completion is returned. Packets delivered in order by a flow's decoder are
+ * handed to the delivery callback on the worker thread if one is set with
+ * fe_set_delivery(); otherwise each is returned as an FE_DELIVER completion
+ * with a malloc()'ed copy, to be released with free().
+ *
+ * A flow's decoder is created by its first packet and parked (freed, see
+ * decslot.h) by a periodic sweep once the flow stays idle with its decoding
+ * window closed, so idle flows cost little more than their encoder and the
+ * recovered ring of the parked decoder. The ring is kept until FE_FLUSHED
+ * tells that the peer encoder was flushed past the parked in-order id and the
+ * packets it sent before were received or lost.
+ *
+ * A tracer attached by FE_TRACE is written by the flow's worker only, and
+ * records, besides the codec events, the FE_RECEIVE packets rejected
+ * (TRACE_REJECT) and the parking of the decoder (TRACE_PARK). Each re-created
+ * decoder records the TRACE_INORDER it starts from.
+ */
+#include <stdint.h>
+#include "streamcodec.h"
+
+enum fe_op {
+    FE_OPEN = 1,                    // data: struct parameters of the flow (copied)
+    FE_CLOSE,
+    FE_SEND,                        // data: pktsize bytes to enqueue and send as a source packet into out
+    FE_REPAIR,                      // arg: EW width, 0 for full; the repair packet is serialized into out
+    FE_RECEIVE,                     // data: a serialized packet of len bytes
+    FE_ACK,                         // arg: in-order feedback, flushes the encoder up to it
+    FE_DELIVER,                     // completion only: data holds source packet sourceid
+    FE_TRACE,                       // data: struct tracer recording the flow's encoder and decoder, NULL to detach
+    FE_FLUSHED,                     // arg: no packet still to be received covers source ids up to it (dec_slot_ack())
+};
+
+struct fe_req {
+    uint32_t        flow;
+    int             op;             // one of fe_op
+    unsigned char   *data;
+    int             len;
+    unsigned char   *out;           // FE_SEND/FE_REPAIR: caller-owned buffer of outcap bytes
+    int             outcap;
+    int             arg;
+    uint64_t        tag;            // opaque, returned in the completion
+};
+
+struct fe_cpl {
+    uint32_t        flow;
+    int             op;
+    int             status;         // 0 on success, -1 on error (e.g., unknown flow, out too small)
+    int             len;            // bytes written to out, or of data for FE_DELIVER
+    int             sourceid;       // FE_SEND/FE_DELIVER: source id; FE_RECEIVE: inorder after the packet
+    uint64_t        tag;
+    unsigned char   *data;          // FE_DELIVER: the delivered packet; otherwise the request's data
+    unsigned char   *out;           // the request's out
+};
+
+// called on the worker thread; syms is only valid during the call
+typedef void (*FE_DELIVER_FN)(uint32_t flow, int sourceid, GF_ELEMENT *syms, int len, void *arg);
+
+struct flow_engine;
+
+// qsize: capacity of each worker's request and completion queues, rounded up to a power of 2
+struct flow_engine *fe_create(int nworkers, int qsize, int pin);
+void fe_set_delivery(struct flow_engine *fe, FE_DELIVER_FN deliver, void *arg);
+// Returns the number of requests accepted, a prefix of reqs; the rest did not
+// fit in the queues and may be resubmitted after draining completions
+int fe_submit(struct flow_engine *fe, const struct fe_req *reqs, int n);
+// Returns the number of completions (at most max) copied into cpls
+int fe_complete(struct flow_engine *fe, struct fe_cpl *cpls, int max);
+int fe_nworkers(struct flow_engine *fe);
+// Stop the workers and free all flows; unclaimed FE_DELIVER copies are released
+void fe_destroy(struct flow_engine *fe);
+
+#endif  // FLOWENGINE_H
@@ -0,0 +1,510 @@
+/*
+ * Region multiply-accumulate kernels over GF(2), GF(2^8) and GF(2^16) with
+ * runtime CPU dispatch. See gfkernel.h.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "gfkernel.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GF_X86
+#endif
+
+static GF_ELEMENT gf_log[256];
+static GF_ELEMENT gf_exp[510];                          // doubled to skip the modulo in gf_mul()
+static GF_ELEMENT gf_mt[256][256] __attribute__((aligned(64)));    // full multiplication table
+static GF_ELEMENT gf_nib[256][32] __attribute__((aligned(64)));    // c*x for x=0..15 (low), c*(x<<4) (high)
+static uint64_t   gf_aff[256];                          // GF2P8AFFINEQB bit-matrix of multiplying c
+static pthread_once_t gf_once = PTHREAD_ONCE_INIT;
+
+static uint16_t   gf16_log[65536];
+static uint16_t   gf16_exp[131070];
+static pthread_once_t gf16_once = PTHREAD_ONCE_INIT;
+
+static void gf_build_tables(void)
+{
+    int i, j;
+    int x = 1;
+    for (i=0; i<255; i++) {
+        gf_exp[i] = gf_exp[i+255] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= GF_POLY_8;
+    }
+    for (i=0; i<256; i++) {
+        for (j=0; j<256; j++)
+            gf_mt[i][j] = (i == 0 || j == 0) ? 0 : gf_exp[gf_log[i] + gf_log[j]];
+        for (j=0; j<16; j++) {
+            gf_nib[i][j]    = gf_mt[i][j];
+            gf_nib[i][16+j] = gf_mt[i][j<<4];
+        }
+        // Bit i of an output byte is the parity of matrix byte 7-i ANDed with the
+        // input, so byte 7-i holds bit i of c*x^j at position j.
+        uint64_t m = 0;
+        for (j=0; j<8; j++) {
+            GF_ELEMENT col = gf_mt[i][1<<j];
+            for (int b=0; b<8; b++) {
+                if (col & (1<<b))
+                    m |= (uint64_t) 1 << ((7-b)*8 + j);
+            }
+        }
+        gf_aff[i] = m;
+    }
+}
+
+static void gf16_build_tables(void)
+{
+    int x = 1;
+    for (int i=0; i<65535; i++) {
+        gf16_exp[i] = gf16_exp[i+65535] = x;
+        gf16_log[x] = i;
+        x <<= 1;
+        if (x & 0x10000)
+            x ^= GF_POLY_16;
+    }
+}
+
+GF_ELEMENT gf_mul(GF_ELEMENT a, GF_ELEMENT b)
+{
+    pthread_once(&gf_once, gf_build_tables);
+    return gf_mt[a][b];
+}
+
+GF_ELEMENT gf_div(GF_ELEMENT a, GF_ELEMENT b)
+{
+    pthread_once(&gf_once, gf_build_tables);
+    if (a == 0 || b == 0)
+        return 0;                   // division by zero is undefined
+    return gf_exp[gf_log[a] + 255 - gf_log[b]];
+}
+
+/************
+ * GF(2^8)  *
+ ************/
+static int gf8_mul(int a, int b)
+{
+    return gf_mt[a][b];
+}
+
+static int gf8_div(int a, int b)
+{
+    return gf_div(a, b);
+}
+
+static void madd_scalar(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    int i;
+    if (c == 0)
+        return;
+    if (c == 1) {
+        for (i=0; i<len; i++)
+            dst[i] ^= src[i];
+        return;
+    }
+    const GF_ELEMENT *row = gf_mt[c];
+    for (i=0; i<len; i++)
+        dst[i] ^= row[src[i]];
+}
+
+#ifdef GF_X86
+__attribute__((target("ssse3")))
+static void madd_ssse3(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    if (c == 0)
+        return;
+    int i = 0;
+    __m128i lo   = _mm_load_si128((const __m128i *) gf_nib[c]);
+    __m128i hi   = _mm_load_si128((const __m128i *) (gf_nib[c] + 16));
+    __m128i mask = _mm_set1_epi8(0x0f);
+    for (; i+16<=len; i+=16) {
+        __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *) (dst + i));
+        __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(s, mask));
+        __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        d = _mm_xor_si128(d, _mm_xor_si128(l, h));
+        _mm_storeu_si128((__m128i *) (dst + i), d);
+    }
+    madd_scalar(dst + i, src + i, c, len - i);
+}
+
+__attribute__((target("avx2")))
+static void madd_avx2(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    if (c == 0)
+        return;
+    int i = 0;
+    __m256i lo   = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) gf_nib[c]));
+    __m256i hi   = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) (gf_nib[c] + 16)));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+    for (; i+32<=len; i+=32) {
+        __m256i s = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i *) (dst + i));
+        __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(s, mask));
+        __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+        d = _mm256_xor_si256(d, _mm256_xor_si256(l, h));
+        _mm256_storeu_si256((__m256i *) (dst + i), d);
+    }
+    madd_ssse3(dst + i, src + i, c, len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void madd_avx512(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    if (c == 0)
+        return;
+    int i = 0;
+    __m512i lo   = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) gf_nib[c]));
+    __m512i hi   = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) (gf_nib[c] + 16)));
+    __m512i mask = _mm512_set1_epi8(0x0f);
+    for (; i+64<=len; i+=64) {
+        __m512i s = _mm512_loadu_si512((const void *) (src + i));
+        __m512i d = _mm512_loadu_si512((const void *) (dst + i));
+        __m512i l = _mm512_shuffle_epi8(lo, _mm512_and_si512(s, mask));
+        __m512i h = _mm512_shuffle_epi8(hi, _mm512_and_si512(_mm512_srli_epi64(s, 4), mask));
+        d = _mm512_ternarylogic_epi32(d, l, h, 0x96);      // d ^ l ^ h
+        _mm512_storeu_si512((void *) (dst + i), d);
+    }
+    madd_avx2(dst + i, src + i, c, len - i);
+}
+
+__attribute__((target("avx2,gfni")))
+static void madd_gfni_avx2(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    if (c == 0)
+        return;
+    int i = 0;
+    __m256i m = _mm256_set1_epi64x((long long) gf_aff[c]);
+    for (; i+32<=len; i+=32) {
+        __m256i s = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i *) (dst + i));
+        d = _mm256_xor_si256(d, _mm256_gf2p8affine_epi64_epi8(s, m, 0));
+        _mm256_storeu_si256((__m256i *) (dst + i), d);
+    }
+    madd_ssse3(dst + i, src + i, c, len - i);
+}
+
+__attribute__((target("avx512f,avx512bw,gfni")))
+static void madd_gfni_avx512(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    if (c == 0)
+        return;
+    int i = 0;
+    __m512i m = _mm512_set1_epi64((long long) gf_aff[c]);
+    for (; i+64<=len; i+=64) {
+        __m512i s = _mm512_loadu_si512((const void *) (src + i));
+        __m512i d = _mm512_loadu_si512((const void *) (dst + i));
+        d = _mm512_xor_si512(d, _mm512_gf2p8affine_epi64_epi8(s, m, 0));
+        _mm512_storeu_si512((void *) (dst + i), d);
+    }
+    if (i < len) {
+        // masked tail, avoids falling back to narrower kernels
+        __mmask64 k = _cvtu64_mask64(~0ULL >> (64 - (len - i)));
+        __m512i s = _mm512_maskz_loadu_epi8(k, (const void *) (src + i));
+        __m512i d = _mm512_maskz_loadu_epi8(k, (const void *) (dst + i));
+        d = _mm512_xor_si512(d, _mm512_gf2p8affine_epi64_epi8(s, m, 0));
+        _mm512_mask_storeu_epi8((void *) (dst + i), k, d);
+    }
+}
+#endif
+
+/************
+ * GF(2)    *
+ ************/
+// The only non-zero coefficient is 1, so multiply-accumulate is a plain XOR
+
+static int gf2_mul(int a, int b)
+{
+    return a & b;
+}
+
+static int gf2_div(int a, int b)
+{
+    return b ? a : 0;
+}
+
+static void xor_scalar(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    int i = 0;
+    if (c == 0)
+        return;
+    for (; i+8<=len; i+=8) {
+        uint64_t d, s;
+        memcpy(&d, dst + i, 8);
+        memcpy(&s, src + i, 8);
+        d ^= s;
+        memcpy(dst + i, &d, 8);
+    }
+    for (; i<len; i++)
+        dst[i] ^= src[i];
+}
+
+#ifdef GF_X86
+__attribute__((target("avx2")))
+static void xor_avx2(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    if (c == 0)
+        return;
+    int i = 0;
+    for (; i+32<=len; i+=32) {
+        __m256i s = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i *) (dst + i));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(d, s));
+    }
+    xor_scalar(dst + i, src + i, c, len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void xor_avx512(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    if (c == 0)
+        return;
+    int i = 0;
+    for (; i+64<=len; i+=64) {
+        __m512i s = _mm512_loadu_si512((const void *) (src + i));
+        __m512i d = _mm512_loadu_si512((const void *) (dst + i));
+        _mm512_storeu_si512((void *) (dst + i), _mm512_xor_si512(d, s));
+    }
+    if (i < len) {
+        __mmask64 k = _cvtu64_mask64(~0ULL >> (64 - (len - i)));
+        __m512i s = _mm512_maskz_loadu_epi8(k, (const void *) (src + i));
+        __m512i d = _mm512_maskz_loadu_epi8(k, (const void *) (dst + i));
+        _mm512_mask_storeu_epi8((void *) (dst + i), k, _mm512_xor_si512(d, s));
+    }
+}
+#endif
+
+/************
+ * GF(2^16) *
+ ************/
+// Symbols are little-endian 16-bit words, so len must be even. The product of c
+// and a word is the XOR of four table lookups, one per nibble of the word.
+
+static int gf16_mul(int a, int b)
+{
+    if (a == 0 || b == 0)
+        return 0;
+    return gf16_exp[gf16_log[a] + gf16_log[b]];
+}
+
+static int gf16_div(int a, int b)
+{
+    if (a == 0 || b == 0)
+        return 0;
+    return gf16_exp[gf16_log[a] + 65535 - gf16_log[b]];
+}
+
+// t[k][n] = c * (n << 4k), k = 0..3, n = 0..15
+static void gf16_nibble_tables(int c, uint16_t t[4][16])
+{
+    for (int k=0; k<4; k++) {
+        for (int n=0; n<16; n++)
+            t[k][n] = gf16_mul(c, n << (4*k));
+    }
+}
+
+static void madd16_scalar(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    uint16_t t[4][16];
+    if (c == 0)
+        return;
+    if (c == 1) {
+        xor_scalar(dst, src, 1, len & ~1);
+        return;
+    }
+    gf16_nibble_tables(c, t);
+    for (int i=0; i+2<=len; i+=2) {
+        int w = src[i] | src[i+1] << 8;
+        int p = t[0][w & 0xf] ^ t[1][(w >> 4) & 0xf] ^ t[2][(w >> 8) & 0xf] ^ t[3][w >> 12];
+        dst[i]   ^= p & 0xff;
+        dst[i+1] ^= p >> 8;
+    }
+}
+
+#ifdef GF_X86
+// Split the nibble tables into low and high bytes of the products, tl/th[k][n]
+static void gf16_byte_tables(int c, GF_ELEMENT tl[4][16], GF_ELEMENT th[4][16])
+{
+    uint16_t t[4][16];
+    gf16_nibble_tables(c, t);
+    for (int k=0; k<4; k++) {
+        for (int n=0; n<16; n++) {
+            tl[k][n] = t[k][n] & 0xff;
+            th[k][n] = t[k][n] >> 8;
+        }
+    }
+}
+
+__attribute__((target("ssse3")))
+static void madd16_ssse3(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    GF_ELEMENT tl[4][16] __attribute__((aligned(16)));
+    GF_ELEMENT th[4][16] __attribute__((aligned(16)));
+    __m128i l[4], h[4];
+    if (c == 0)
+        return;
+    gf16_byte_tables(c, tl, th);
+    for (int k=0; k<4; k++) {
+        l[k] = _mm_load_si128((const __m128i *) tl[k]);
+        h[k] = _mm_load_si128((const __m128i *) th[k]);
+    }
+    // gather low bytes of words into the low 8 bytes, high bytes into the high 8 bytes
+    __m128i split = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    __m128i mask  = _mm_set1_epi8(0x0f);
+    int i = 0;
+    for (; i+32<=len; i+=32) {
+        __m128i a  = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (src + i)), split);
+        __m128i b  = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (src + i + 16)), split);
+        __m128i lo = _mm_unpacklo_epi64(a, b);
+        __m128i hi = _mm_unpackhi_epi64(a, b);
+        __m128i n0 = _mm_and_si128(lo, mask);
+        __m128i n1 = _mm_and_si128(_mm_srli_epi64(lo, 4), mask);
+        __m128i n2 = _mm_and_si128(hi, mask);
+        __m128i n3 = _mm_and_si128(_mm_srli_epi64(hi, 4), mask);
+        __m128i rl = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(l[0], n0), _mm_shuffle_epi8(l[1], n1)),
+                                   _mm_xor_si128(_mm_shuffle_epi8(l[2], n2), _mm_shuffle_epi8(l[3], n3)));
+        __m128i rh = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(h[0], n0), _mm_shuffle_epi8(h[1], n1)),
+                                   _mm_xor_si128(_mm_shuffle_epi8(h[2], n2), _mm_shuffle_epi8(h[3], n3)));
+        __m128i d0 = _mm_loadu_si128((const __m128i *) (dst + i));
+        __m128i d1 = _mm_loadu_si128((const __m128i *) (dst + i + 16));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(d0, _mm_unpacklo_epi8(rl, rh)));
+        _mm_storeu_si128((__m128i *) (dst + i + 16), _mm_xor_si128(d1, _mm_unpackhi_epi8(rl, rh)));
+    }
+    madd16_scalar(dst + i, src + i, c, len - i);
+}
+
+__attribute__((target("avx2")))
+static void madd16_avx2(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len)
+{
+    GF_ELEMENT tl[4][16] __attribute__((aligned(16)));
+    GF_ELEMENT th[4][16] __attribute__((aligned(16)));
+    __m256i l[4], h[4];
+    if (c == 0)
+        return;
+    gf16_byte_tables(c, tl, th);
+    for (int k=0; k<4; k++) {
+        l[k] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) tl[k]));
+        h[k] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) th[k]));
+    }
+    // same as madd16_ssse3(), independently in each 128-bit lane
+    __m256i split = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+                                     0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    __m256i mask  = _mm256_set1_epi8(0x0f);
+    int i = 0;
+    for (; i+64<=len; i+=64) {
+        __m256i a  = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (src + i)), split);
+        __m256i b  = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (src + i + 32)), split);
+        __m256i lo = _mm256_unpacklo_epi64(a, b);
+        __m256i hi = _mm256_unpackhi_epi64(a, b);
+        __m256i n0 = _mm256_and_si256(lo, mask);
+        __m256i n1 = _mm256_and_si256(_mm256_srli_epi64(lo, 4), mask);
+        __m256i n2 = _mm256_and_si256(hi, mask);
+        __m256i n3 = _mm256_and_si256(_mm256_srli_epi64(hi, 4), mask);
+        __m256i rl = _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(l[0], n0), _mm256_shuffle_epi8(l[1], n1)),
+                                      _mm256_xor_si256(_mm256_shuffle_epi8(l[2], n2), _mm256_shuffle_epi8(l[3], n3)));
+        __m256i rh = _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(h[0], n0), _mm256_shuffle_epi8(h[1], n1)),
+                                      _mm256_xor_si256(_mm256_shuffle_epi8(h[2], n2), _mm256_shuffle_epi8(h[3], n3)));
+        __m256i d0 = _mm256_loadu_si256((const __m256i *) (dst + i));
+        __m256i d1 = _mm256_loadu_si256((const __m256i *) (dst + i + 32));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(d0, _mm256_unpacklo_epi8(rl, rh)));
+        _mm256_storeu_si256((__m256i *) (dst + i + 32), _mm256_xor_si256(d1, _mm256_unpackhi_epi8(rl, rh)));
+    }
+    madd16_ssse3(dst + i, src + i, c, len - i);
+}
+#endif
+
+static const struct gf_kernel gf2_kernels[GF_KERNEL_NUM] = {
+    [GF_KERNEL_SCALAR]      = { GF_KERNEL_SCALAR,      1,  "gf2-scalar",      xor_scalar,       gf2_mul,  gf2_div  },
+#ifdef GF_X86
+    [GF_KERNEL_AVX2]        = { GF_KERNEL_AVX2,        1,  "gf2-avx2",        xor_avx2,         gf2_mul,  gf2_div  },
+    [GF_KERNEL_AVX512]      = { GF_KERNEL_AVX512,      1,  "gf2-avx512",      xor_avx512,       gf2_mul,  gf2_div  },
+#endif
+};
+
+static const struct gf_kernel gf8_kernels[GF_KERNEL_NUM] = {
+    [GF_KERNEL_SCALAR]      = { GF_KERNEL_SCALAR,      8,  "scalar",          madd_scalar,      gf8_mul,  gf8_div  },
+#ifdef GF_X86
+    [GF_KERNEL_SSSE3]       = { GF_KERNEL_SSSE3,       8,  "ssse3",           madd_ssse3,       gf8_mul,  gf8_div  },
+    [GF_KERNEL_AVX2]        = { GF_KERNEL_AVX2,        8,  "avx2",            madd_avx2,        gf8_mul,  gf8_div  },
+    [GF_KERNEL_AVX512]      = { GF_KERNEL_AVX512,      8,  "avx512",          madd_avx512,      gf8_mul,  gf8_div  },
+    [GF_KERNEL_GFNI_AVX2]   = { GF_KERNEL_GFNI_AVX2,   8,  "gfni-avx2",       madd_gfni_avx2,   gf8_mul,  gf8_div  },
+    [GF_KERNEL_GFNI_AVX512] = { GF_KERNEL_GFNI_AVX512, 8,  "gfni-avx512",     madd_gfni_avx512, gf8_mul,  gf8_div  },
+#endif
+};
+
+static const struct gf_kernel gf16_kernels[GF_KERNEL_NUM] = {
+    [GF_KERNEL_SCALAR]      = { GF_KERNEL_SCALAR,      16, "gf16-scalar",     madd16_scalar,    gf16_mul, gf16_div },
+#ifdef GF_X86
+    [GF_KERNEL_SSSE3]       = { GF_KERNEL_SSSE3,       16, "gf16-ssse3",      madd16_ssse3,     gf16_mul, gf16_div },
+    [GF_KERNEL_AVX2]        = { GF_KERNEL_AVX2,        16, "gf16-avx2",       madd16_avx2,      gf16_mul, gf16_div },
+#endif
+};
+
+static int gf_cpu_supports(int type)
+{
+#ifdef GF_X86
+    __builtin_cpu_init();
+    switch (type) {
+    case GF_KERNEL_SSSE3:
+        return __builtin_cpu_supports("ssse3");
+    case GF_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case GF_KERNEL_AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    case GF_KERNEL_GFNI_AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("gfni");
+    case GF_KERNEL_GFNI_AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+                && __builtin_cpu_supports("gfni");
+    }
+#endif
+    return type == GF_KERNEL_SCALAR;
+}
+
+/*
+ * Return the kernel of the given type for GF(2^gfpower), or NULL if the field
+ * is not supported, or the kernel is not supported by the running CPU (or not
+ * compiled in).
+ */
+const struct gf_kernel *gf_get_kernel(int gfpower, int type)
+{
+    const struct gf_kernel *kernels;
+    if (type < 0 || type >= GF_KERNEL_NUM)
+        return NULL;
+    switch (gfpower) {
+    case 1:
+        kernels = gf2_kernels;
+        break;
+    case 8:
+        pthread_once(&gf_once, gf_build_tables);
+        kernels = gf8_kernels;
+        break;
+    case 16:
+        pthread_once(&gf16_once, gf16_build_tables);
+        kernels = gf16_kernels;
+        break;
+    default:
+        return NULL;
+    }
+    if (kernels[type].madd == NULL)
+        return NULL;
+    return gf_cpu_supports(type) ? &kernels[type] : NULL;
+}
+
+/*
+ * Return the fastest kernel for GF(2^gfpower) supported by the running CPU,
+ * or NULL if the field is not supported. Called once by initialize_encoder()
+ * and initialize_decoder() with parameters.gfpower.
+ */
+const struct gf_kernel *gf_select_kernel(int gfpower)
+{
+    static const int pref[] = { GF_KERNEL_GFNI_AVX512, GF_KERNEL_AVX512, GF_KERNEL_GFNI_AVX2,
+                                GF_KERNEL_AVX2, GF_KERNEL_SSSE3 };
+    const struct gf_kernel *gk;
+    for (int i=0; i<(int) (sizeof(pref)/sizeof(pref[0])); i++) {
+        if ((gk = gf_get_kernel(gfpower, pref[i])) != NULL)
+            return gk;
+    }
+    return gf_get_kernel(gfpower, GF_KERNEL_SCALAR);
+}
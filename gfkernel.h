@@ -0,0 +1,55 @@
+#ifndef GFKERNEL_H
+#define GFKERNEL_H
+/*
+ * Region multiply-accumulate kernels over GF(2^n), n = 1, 8 or 16
+ *
+ *      dst[i] = dst[i] + c * src[i],   i = 0, 1, ..., len-1
+ *
+ * which is the inner loop of encoding a repair packet (syms += coe * src over
+ * the encoding window) and of the row operations when decoding. The field is
+ * chosen at runtime from parameters.gfpower:
+ *  - GF(2): XOR only, in 64-bit words or SIMD registers
+ *  - GF(2^8): split-nibble (low/high 4-bit) table lookup via PSHUFB on
+ *    SSSE3/AVX2/AVX-512, or an 8x8 bit-matrix via GF2P8AFFINEQB with GFNI
+ *  - GF(2^16): symbols are little-endian 16-bit words (len must be even), four
+ *    nibble tables per coefficient, split into low/high product bytes for PSHUFB
+ * The best kernel supported by the running CPU is selected at runtime; the
+ * scalar kernel of each field is always available and is the reference of the
+ * others.
+ */
+#ifndef GALOIS
+#define GALOIS
+typedef unsigned char GF_ELEMENT;
+#endif
+
+#define GF_POLY_8   0x11D           // primitive polynomial of GF(2^8), x^8+x^4+x^3+x^2+1
+#define GF_POLY_16  0x1100B         // primitive polynomial of GF(2^16), x^16+x^12+x^3+x+1
+
+// len is in bytes, c is an element of the field
+typedef void (*GF_MADD_FN)(GF_ELEMENT *dst, const GF_ELEMENT *src, int c, int len);
+
+enum gf_kernel_type {
+    GF_KERNEL_SCALAR = 0,
+    GF_KERNEL_SSSE3,
+    GF_KERNEL_AVX2,
+    GF_KERNEL_AVX512,
+    GF_KERNEL_GFNI_AVX2,
+    GF_KERNEL_GFNI_AVX512,
+    GF_KERNEL_NUM
+};
+
+struct gf_kernel {
+    int         type;               // one of gf_kernel_type
+    int         gfpower;            // n of GF(2^n)
+    const char  *name;
+    GF_MADD_FN  madd;               // region multiply-accumulate
+    int         (*mul)(int a, int b);   // element arithmetic, e.g., on coefficients
+    int         (*div)(int a, int b);
+};
+
+const struct gf_kernel *gf_select_kernel(int gfpower);
+const struct gf_kernel *gf_get_kernel(int gfpower, int type);
+GF_ELEMENT gf_mul(GF_ELEMENT a, GF_ELEMENT b);
+GF_ELEMENT gf_div(GF_ELEMENT a, GF_ELEMENT b);
+
+#endif  // GFKERNEL_H
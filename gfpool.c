@@ -0,0 +1,187 @@
+/*
+ * Column-striped parallel region operations. See gfpool.h.
+ */
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "gfpool.h"
+
+// a call, run stripe by stripe by fn
+struct gf_job {
+    void                    (*fn)(const struct gf_job *job, int off, int n);
+    const struct gf_kernel  *gk;
+    const struct gf_op      *ops;
+    int                     nops;
+    GF_ELEMENT              **dsts;
+    int                     ndst;
+    const GF_ELEMENT        **srcs;
+    int                     nsrc;
+    const int               *coefs;
+    int                     len;
+};
+
+struct gf_pool {
+    int                     nthreads;   // including the calling thread
+    int                     fixed;      // stripe given to gf_pool_create(), 0 to derive it per call
+    int                     stripe;     // of the current call
+    int                     threshold;
+    pthread_t               *tids;
+    pthread_mutex_t         call;       // serializes the calls on the pool
+    pthread_mutex_t         lock;       // protects gen and stop
+    pthread_cond_t          cond;
+    unsigned long           gen;        // incremented for every parallel call
+    int                     stop;
+    struct gf_job           job;        // the current call
+    int                     nstripes;
+    atomic_int              next;       // next stripe to claim
+    atomic_int              nidle;      // helper threads done with the call
+};
+
+static void stripe_ops(const struct gf_job *job, int off, int n)
+{
+    for (int i=0; i<job->nops; i++)
+        job->gk->madd(job->ops[i].dst + off, job->ops[i].src + off, job->ops[i].c, n);
+}
+
+// each source stripe is loaded once and accumulated into all destinations
+static void stripe_multi(const struct gf_job *job, int off, int n)
+{
+    for (int i=0; i<job->nsrc; i++) {
+        for (int j=0; j<job->ndst; j++)
+            job->gk->madd(job->dsts[j] + off, job->srcs[i] + off, job->coefs[j * job->nsrc + i], n);
+    }
+}
+
+static void run_stripes(struct gf_pool *pool)
+{
+    int s;
+    while ((s = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed)) < pool->nstripes) {
+        int off = s * pool->stripe;
+        pool->job.fn(&pool->job, off, pool->job.len - off < pool->stripe ? pool->job.len - off : pool->stripe);
+    }
+}
+
+static void *gf_pool_worker(void *arg)
+{
+    struct gf_pool *pool = arg;
+    unsigned long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->gen == seen && !pool->stop)
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        if (pool->stop) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->gen;
+        pthread_mutex_unlock(&pool->lock);
+        run_stripes(pool);
+        atomic_fetch_add_explicit(&pool->nidle, 1, memory_order_release);
+    }
+}
+
+struct gf_pool *gf_pool_create(int nthreads, int stripe, int threshold)
+{
+    if (nthreads <= 0)
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0)
+        nthreads = 1;
+    struct gf_pool *pool = calloc(1, sizeof(struct gf_pool));
+    if (pool == NULL)
+        return NULL;
+    pool->fixed     = stripe > 0 ? (stripe + 63) & ~63 : 0;
+    pool->threshold = threshold > 0 ? threshold : GF_THRESHOLD;
+    pool->tids      = calloc(nthreads, sizeof(pthread_t));
+    if (pool->tids == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->call, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    atomic_init(&pool->next, 0);
+    atomic_init(&pool->nidle, 0);
+    pool->nthreads = 1;
+    for (int i=1; i<nthreads; i++) {
+        if (pthread_create(&pool->tids[i], NULL, gf_pool_worker, pool) != 0)
+            break;
+        pool->nthreads++;
+    }
+    return pool;
+}
+
+void gf_pool_free(struct gf_pool *pool)
+{
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i=1; i<pool->nthreads; i++)
+        pthread_join(pool->tids[i], NULL);
+    pthread_mutex_destroy(&pool->call);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    free(pool->tids);
+    free(pool);
+}
+
+int gf_pool_nthreads(struct gf_pool *pool)
+{
+    return pool != NULL ? pool->nthreads : 1;
+}
+
+// A stripe per thread, rounded up to 64 bytes, at most GF_STRIPE so that stripes
+// stay cache-sized, e.g., 2304 bytes for 9000-byte payloads on 4 threads
+static int derive_stripe(const struct gf_pool *pool, int len)
+{
+    if (pool == NULL)
+        return GF_STRIPE;
+    if (pool->fixed > 0)
+        return pool->fixed;
+    int stripe = ((len + pool->nthreads - 1) / pool->nthreads + 63) & ~63;
+    return stripe < GF_STRIPE ? stripe : GF_STRIPE;
+}
+
+static void run(struct gf_pool *pool, const struct gf_job *job)
+{
+    int stripe = derive_stripe(pool, job->len);
+    if (pool == NULL || pool->nthreads == 1 || job->len < pool->threshold || job->len <= stripe) {
+        // serial, still stripe by stripe
+        for (int off=0; off<job->len; off+=stripe)
+            job->fn(job, off, job->len - off < stripe ? job->len - off : stripe);
+        return;
+    }
+    pthread_mutex_lock(&pool->call);
+    pool->job      = *job;
+    pool->stripe   = stripe;
+    pool->nstripes = (job->len + stripe - 1) / stripe;
+    atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+    atomic_store_explicit(&pool->nidle, 0, memory_order_relaxed);
+    pthread_mutex_lock(&pool->lock);
+    pool->gen++;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    run_stripes(pool);
+    // helpers must be done with the job before the caller may reuse its arrays
+    while (atomic_load_explicit(&pool->nidle, memory_order_acquire) < pool->nthreads - 1)
+        sched_yield();
+    pthread_mutex_unlock(&pool->call);
+}
+
+void gf_pool_madd(struct gf_pool *pool, const struct gf_kernel *gk, const struct gf_op *ops, int nops, int len)
+{
+    struct gf_job job = { .fn = stripe_ops, .gk = gk, .ops = ops, .nops = nops, .len = len };
+    run(pool, &job);
+}
+
+void gf_pool_madd_multi(struct gf_pool *pool, const struct gf_kernel *gk, GF_ELEMENT **dsts, int ndst,
+                        const GF_ELEMENT **srcs, int nsrc, const int *coefs, int len)
+{
+    struct gf_job job = { .fn = stripe_multi, .gk = gk, .dsts = dsts, .ndst = ndst,
+                          .srcs = srcs, .nsrc = nsrc, .coefs = coefs, .len = len };
+    run(pool, &job);
+}
@@ -0,0 +1,48 @@
+#ifndef GFPOOL_H
+#define GFPOOL_H
+/*
+ * Column-striped parallel region operations for jumbo payloads
+ *
+ * A sequence of row operations dst += c * src (encoding a repair packet over
+ * the window, or applying a pivot row during elimination) works on every
+ * column independently. The symbol range is therefore cut into stripes of a
+ * cache-sized number of bytes, and the whole sequence is run stripe by stripe
+ * on a pool of threads: each thread keeps its stripe of the destination rows
+ * in cache while it streams the corresponding stripes of the sources, and
+ * stripes never overlap, so no synchronization is needed within a call. The
+ * result is byte-identical to applying the operations in order serially.
+ *
+ * Calls on payloads shorter than the pool's threshold take the serial path on
+ * the calling thread, which runs the same stripes one after another, i.e., is
+ * still cache-blocked. Only payloads are striped: the coefficient matrix of the
+ * decoder is small and is eliminated on the calling thread.
+ */
+#include "gfkernel.h"
+
+#define GF_STRIPE       8192        // largest derived stripe, and that of the serial path, in bytes
+#define GF_THRESHOLD    8192        // default minimum payload size of the parallel path
+
+struct gf_op {
+    GF_ELEMENT          *dst;
+    const GF_ELEMENT    *src;
+    int                 c;
+};
+
+struct gf_pool;
+
+// nthreads includes the calling thread, 0 for one per online CPU; stripe is
+// rounded up to a multiple of 64 bytes, 0 to split each call into one stripe
+// per thread of at most GF_STRIPE bytes
+struct gf_pool *gf_pool_create(int nthreads, int stripe, int threshold);
+void gf_pool_free(struct gf_pool *pool);
+int gf_pool_nthreads(struct gf_pool *pool);
+// Apply ops[0], ..., ops[nops-1] in order over len bytes of each row. pool may
+// be NULL for the serial path. Calls on the same pool are serialized
+void gf_pool_madd(struct gf_pool *pool, const struct gf_kernel *gk, const struct gf_op *ops, int nops, int len);
+// dsts[j] += sum_i coefs[j*nsrc+i] * srcs[i], j = 0, ..., ndst-1, with each
+// stripe of a source loaded once for all destinations (e.g., k repair packets
+// over the same EW)
+void gf_pool_madd_multi(struct gf_pool *pool, const struct gf_kernel *gk, GF_ELEMENT **dsts, int ndst,
+                        const GF_ELEMENT **srcs, int nsrc, const int *coefs, int len);
+
+#endif  // GFPOOL_H
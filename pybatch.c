@@ -0,0 +1,342 @@
+/*
+ * CPython extension module "pybatch": batch entry points of the codec over
+ * buffer-protocol objects (bytes, bytearray, memoryview, array, NumPy arrays)
+ * holding many packets at once, for applications driving the codec from
+ * Python, where a ctypes call per packet and the copies into and out of
+ * POINTER(c_ubyte) dominate the cost of small packets.
+ *
+ * Encoders and decoders are those of pystreamc.py, passed as their ctypes
+ * pointers or by address, so the module mixes freely with the ctypes API.
+ * Batches of serialized packets are laid out in slots of stride bytes, e.g.,
+ * the receive buffers of recvmmsg(), with their lengths in an int32 buffer;
+ * a stride of 0 on input means packed back to back. Encoding and decoding run
+ * without the GIL. Buffers must be C-contiguous; errors raise ValueError.
+ *
+ *  enqueue(ec, data)                           enqueue len(data)/pktsize source packets
+ *  encode(ec, data, repfreq, out, stride, lens)
+ *                                              enqueue and output them, with a full repair
+ *                                              packet after every source packet whose
+ *                                              id+1 is a multiple of repfreq (0: none);
+ *                                              those not fitting in out stay queued
+ *  output_source(ec, n, out, stride, lens)     up to n source packets, serialized
+ *  output_repair(ec, n, ew, out, stride, lens) n repair packets over the same EW (full
+ *                                              if ew <= 0), encoded in one pass
+ *  next_packets(ec, n, out, stride, lens)      up to n packets as decided by next_packet()
+ *  receive(dc, data, lens, stride=0)           deserialize and receive len(lens) packets,
+ *                                              returns the in-order id afterwards and the
+ *                                              number of packets rejected as their length
+ *                                              is not the one their header implies
+ *  recovered(dc, first, last=inorder)          zero-copy read-only memoryviews of the
+ *                                              recovered packets first..last
+ * Outputs are clipped to the slots of out and the entries of lens. The output
+ * functions return the number of packets written; a packet that does not fit
+ * in a slot ends the batch and is dropped, and so are the repair packets
+ * encoded after it in the same pass.
+ *
+ * recovered() views point into the decoder's ring of recovered packets, so
+ * they are only valid without a delivery callback, until the slot is reused
+ * recvsize source packets later (see RECOVERED() in streamcodec.h), and while
+ * the decoder lives; copy what must be kept longer.
+ *
+ * Build against the library, e.g.:
+ *      gcc -O2 -shared -fPIC $(python3-config --includes) -o pybatch$(python3-config --extension-suffix) pybatch.c -L. -lstreamc
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "streamcodec.h"
+#include "wireformat.h"
+
+#define PB_MAXK     64              // repair packets encoded per output_repair_packets() pass
+
+// an address, or a ctypes pointer, whose buffer holds the pointer itself
+static int to_ptr(PyObject *obj, void *out)
+{
+    void *p = NULL;
+    if (PyLong_Check(obj)) {
+        p = PyLong_AsVoidPtr(obj);
+    } else {
+        Py_buffer b;
+        if (PyObject_GetBuffer(obj, &b, PyBUF_SIMPLE) < 0)
+            return 0;
+        if (b.len == sizeof(void *))
+            memcpy(&p, b.buf, sizeof(void *));
+        PyBuffer_Release(&b);
+    }
+    if (p == NULL) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_ValueError, "NULL encoder or decoder");
+        return 0;
+    }
+    *(void **) out = p;
+    return 1;
+}
+
+// Check the output slots and int32 lengths, clipping n to the packets they hold
+static int get_out(Py_buffer *out, Py_buffer *lens, Py_ssize_t stride, Py_ssize_t *n)
+{
+    if (stride <= 0 || stride > INT_MAX || lens->itemsize != sizeof(int)) {
+        PyErr_SetString(PyExc_ValueError, "stride must be positive and lens an int32 buffer");
+        return -1;
+    }
+    if (*n > out->len / stride)
+        *n = out->len / stride;
+    if (*n > lens->len / (Py_ssize_t) sizeof(int))
+        *n = lens->len / sizeof(int);
+    return 0;
+}
+
+static PyObject *pb_enqueue(PyObject *self, PyObject *args)
+{
+    struct encoder *ec;
+    Py_buffer data;
+    (void) self;
+    if (!PyArg_ParseTuple(args, "O&y*", to_ptr, &ec, &data))
+        return NULL;
+    int pktsize = ec->cp->pktsize;
+    if (data.len % pktsize != 0) {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "data must hold a whole number of packets");
+        return NULL;
+    }
+    Py_ssize_t n = data.len / pktsize, i;
+    Py_BEGIN_ALLOW_THREADS
+    for (i=0; i<n; i++) {
+        if (enqueue_packet(ec, ec->snum, (GF_ELEMENT *) data.buf + i * pktsize) < 0)
+            break;
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&data);
+    return PyLong_FromSsize_t(i);
+}
+
+static PyObject *pb_encode(PyObject *self, PyObject *args)
+{
+    struct encoder *ec;
+    Py_buffer data, out, lens;
+    Py_ssize_t stride, n = 0, i = 0;
+    int repfreq;
+    (void) self;
+    if (!PyArg_ParseTuple(args, "O&y*iw*nw*", to_ptr, &ec, &data, &repfreq, &out, &stride, &lens))
+        return NULL;
+    int pktsize = ec->cp->pktsize;
+    if (data.len % pktsize != 0)
+        PyErr_SetString(PyExc_ValueError, "data must hold a whole number of packets");
+    else if ((n = PY_SSIZE_T_MAX, get_out(&out, &lens, stride, &n)) == 0) {
+        int *len = lens.buf;
+        Py_ssize_t k = data.len / pktsize;
+        Py_BEGIN_ALLOW_THREADS
+        for (Py_ssize_t j=0; j<k; j++) {
+            if (enqueue_packet(ec, ec->snum, (GF_ELEMENT *) data.buf + j * pktsize) < 0)
+                break;
+        }
+        while (i < n && ec->nextsid < ec->snum) {
+            int sid = ec->nextsid;
+            len[i] = output_source_packet_into(ec, (unsigned char *) out.buf + i * stride, stride);
+            if (len[i] < 0)
+                break;
+            i++;
+            if (repfreq > 0 && (sid + 1) % repfreq == 0 && i < n) {
+                len[i] = output_repair_packet_into(ec, (unsigned char *) out.buf + i * stride, stride);
+                if (len[i] < 0)
+                    break;
+                i++;
+            }
+        }
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&data);
+    PyBuffer_Release(&out);
+    PyBuffer_Release(&lens);
+    return PyErr_Occurred() ? NULL : PyLong_FromSsize_t(i);
+}
+
+static PyObject *pb_output_source(PyObject *self, PyObject *args)
+{
+    struct encoder *ec;
+    Py_ssize_t n, stride, i = 0;
+    Py_buffer out, lens;
+    (void) self;
+    if (!PyArg_ParseTuple(args, "O&nw*nw*", to_ptr, &ec, &n, &out, &stride, &lens))
+        return NULL;
+    if (get_out(&out, &lens, stride, &n) == 0) {
+        int *len = lens.buf;
+        Py_BEGIN_ALLOW_THREADS
+        for (i=0; i<n; i++) {
+            len[i] = output_source_packet_into(ec, (unsigned char *) out.buf + i * stride, stride);
+            if (len[i] < 0)
+                break;
+        }
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&out);
+    PyBuffer_Release(&lens);
+    return PyErr_Occurred() ? NULL : PyLong_FromSsize_t(i);
+}
+
+static PyObject *pb_output_repair(PyObject *self, PyObject *args)
+{
+    struct encoder *ec;
+    Py_ssize_t n, stride, i = 0;
+    int ew;
+    Py_buffer out, lens;
+    (void) self;
+    if (!PyArg_ParseTuple(args, "O&niw*nw*", to_ptr, &ec, &n, &ew, &out, &stride, &lens))
+        return NULL;
+    if (get_out(&out, &lens, stride, &n) == 0) {
+        int *len = lens.buf;
+        struct packet *pkts[PB_MAXK];
+        int full = 0;
+        Py_BEGIN_ALLOW_THREADS
+        while (i < n && !full) {
+            int k = output_repair_packets(ec, n - i < PB_MAXK ? n - i : PB_MAXK, ew, pkts);
+            if (k <= 0)
+                break;
+            for (int j=0; j<k; j++) {
+                if (!full) {
+                    len[i] = serialize_packet_into(ec, pkts[j], (unsigned char *) out.buf + i * stride, stride);
+                    full = len[i] < 0;
+                    i += !full;
+                }
+                free_packet(pkts[j]);
+            }
+        }
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&out);
+    PyBuffer_Release(&lens);
+    return PyErr_Occurred() ? NULL : PyLong_FromSsize_t(i);
+}
+
+static PyObject *pb_next_packets(PyObject *self, PyObject *args)
+{
+    struct encoder *ec;
+    Py_ssize_t n, stride, i = 0;
+    Py_buffer out, lens;
+    (void) self;
+    if (!PyArg_ParseTuple(args, "O&nw*nw*", to_ptr, &ec, &n, &out, &stride, &lens))
+        return NULL;
+    if (get_out(&out, &lens, stride, &n) == 0) {
+        int *len = lens.buf;
+        Py_BEGIN_ALLOW_THREADS
+        for (i=0; i<n; i++) {
+            struct packet *pkt = next_packet(ec);
+            if (pkt == NULL)
+                break;
+            len[i] = serialize_packet_into(ec, pkt, (unsigned char *) out.buf + i * stride, stride);
+            free_packet(pkt);
+            if (len[i] < 0)
+                break;
+        }
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&out);
+    PyBuffer_Release(&lens);
+    return PyErr_Occurred() ? NULL : PyLong_FromSsize_t(i);
+}
+
+static PyObject *pb_receive(PyObject *self, PyObject *args)
+{
+    struct decoder *dc;
+    Py_buffer data, lens;
+    Py_ssize_t stride = 0;
+    (void) self;
+    if (!PyArg_ParseTuple(args, "O&y*y*|n", to_ptr, &dc, &data, &lens, &stride))
+        return NULL;
+    Py_ssize_t n = lens.len / sizeof(int);
+    const int *len = lens.buf;
+    // check the layout before touching the decoder
+    Py_ssize_t off = 0;
+    if (lens.itemsize != sizeof(int) || stride < 0) {
+        PyErr_SetString(PyExc_ValueError, "lens must be an int32 buffer and stride non-negative");
+    } else {
+        for (Py_ssize_t i=0; i<n; i++) {
+            Py_ssize_t end = (stride ? i * stride : off) + len[i];
+            if (len[i] < 0 || (stride && len[i] > stride) || end > data.len) {
+                PyErr_SetString(PyExc_ValueError, "packet lengths exceed data");
+                break;
+            }
+            off = end;
+        }
+    }
+    if (PyErr_Occurred()) {
+        PyBuffer_Release(&data);
+        PyBuffer_Release(&lens);
+        return NULL;
+    }
+    int inorder;
+    Py_ssize_t rejected = 0;
+    Py_BEGIN_ALLOW_THREADS
+    off = 0;
+    for (Py_ssize_t i=0; i<n; i++) {
+        unsigned char *pktstr = (unsigned char *) data.buf + (stride ? i * stride : off);
+        off += len[i];
+        if (len[i] == 0)
+            continue;               // an empty slot
+        // the header must imply exactly the datagram, or the view would read past it
+        int wlen = wire_length(dc->cp, pktstr, len[i]);
+        struct packet *pkt = wlen == len[i] ? deserialize_packet_view(dc, pktstr) : NULL;
+        if (pkt == NULL) {
+            rejected++;
+            TRACE(dc->trace, TRACE_REJECT, len[i], wlen, 0);
+            continue;
+        }
+        receive_packet(dc, pkt);
+    }
+    inorder = dc->inorder;
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&data);
+    PyBuffer_Release(&lens);
+    return Py_BuildValue("(in)", inorder, rejected);
+}
+
+static PyObject *pb_recovered(PyObject *self, PyObject *args)
+{
+    struct decoder *dc;
+    int first, last = INT_MIN;
+    (void) self;
+    if (!PyArg_ParseTuple(args, "O&i|i", to_ptr, &dc, &first, &last))
+        return NULL;
+    if (last == INT_MIN)
+        last = dc->inorder;
+    if (last > dc->inorder || (first <= last && (first < 0 || first <= dc->inorder - dc->recvsize))) {
+        PyErr_SetString(PyExc_IndexError, "packets not (or no longer) in the recovered ring");
+        return NULL;
+    }
+    if (dc->deliver != NULL) {
+        PyErr_SetString(PyExc_ValueError, "recovered packets are handed to the delivery callback");
+        return NULL;
+    }
+    PyObject *list = PyList_New(last >= first ? last - first + 1 : 0);
+    if (list == NULL)
+        return NULL;
+    for (int sid=first; sid<=last; sid++) {
+        PyObject *mv = PyMemoryView_FromMemory((char *) RECOVERED(dc, sid), dc->cp->pktsize, PyBUF_READ);
+        if (mv == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, sid - first, mv);
+    }
+    return list;
+}
+
+static PyMethodDef pb_methods[] = {
+    {"enqueue",       pb_enqueue,       METH_VARARGS, "enqueue(ec, data) -> number of source packets enqueued"},
+    {"encode",        pb_encode,        METH_VARARGS, "encode(ec, data, repfreq, out, stride, lens) -> packets written"},
+    {"output_source", pb_output_source, METH_VARARGS, "output_source(ec, n, out, stride, lens) -> packets written"},
+    {"output_repair", pb_output_repair, METH_VARARGS, "output_repair(ec, n, ew, out, stride, lens) -> packets written"},
+    {"next_packets",  pb_next_packets,  METH_VARARGS, "next_packets(ec, n, out, stride, lens) -> packets written"},
+    {"receive",       pb_receive,       METH_VARARGS, "receive(dc, data, lens, stride=0) -> in-order id"},
+    {"recovered",     pb_recovered,     METH_VARARGS, "recovered(dc, first, last=inorder) -> list of memoryviews"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef pb_module = {
+    PyModuleDef_HEAD_INIT, "pybatch", "Batch codec entry points over buffer-protocol objects", -1, pb_methods,
+    NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_pybatch(void)
+{
+    return PyModule_Create(&pb_module);
+}
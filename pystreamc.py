@@ -1,8 +1,34 @@
 #This file wraps APIs from libstreamc.so in Python
-from ctypes import cdll, c_int, c_double, c_ubyte, c_ulong, Structure, POINTER
+from ctypes import cdll, c_int, c_uint, c_double, c_ubyte, c_ulong, c_ulonglong, c_long, c_char_p, c_void_p, Structure, POINTER, CFUNCTYPE
+try:
+    import pybatch                  # native batch entry points, see pybatch.c
+except ImportError:
+    pybatch = None
 N = 624
 EWIN = 100
+COE_MT19937 = 0
+COE_COUNTER = 1
+WIRE_LEGACY = 0
+WIRE_COMPACT = 1
+STATS_NBINS = 32
+STATS_TIME_EVERY = 64
 DEC_ALLOC = 10000
+DEC_DWMAX = 1 << 20
+DEC_EAGER = 0
+DEC_DEFERRED = 1
+FE_OPEN = 1
+FE_CLOSE = 2
+FE_SEND = 3
+FE_REPAIR = 4
+FE_RECEIVE = 5
+FE_ACK = 6
+FE_DELIVER = 7
+FE_TRACE = 8
+FE_FLUSHED = 9
+ENC_SEGSIZE = 1024
+FB_MAXRUNS = 16
+DEC_SLOT_RECV = 64
+WIRE_MAXFB = 4 + 5 * (5 + 2 * FB_MAXRUNS)
 
 
 class MT19937(Structure):
@@ -14,7 +40,59 @@ class parameters(Structure):
     _fields_ = [("gfpower"  , c_int),
                 ("pktsize"  , c_int),
                 ("repfreq"  , c_double),
-                ("seed"     , c_int)]
+                ("seed"     , c_int),
+                ("coemode"  , c_int)]
+
+
+class encoder_stats(Structure):
+    _fields_ = [("nsource"    , c_ulonglong),
+                ("nrepair"    , c_ulonglong),
+                ("madd_bytes" , c_ulonglong),
+                ("buf_hwm"    , c_int)]
+
+
+class decoder_stats(Structure):
+    _fields_ = [("nsource"       , c_ulonglong),
+                ("nrepair"       , c_ulonglong),
+                ("innovative"    , c_ulonglong),
+                ("noninnovative" , c_ulonglong),
+                ("redundant"     , c_ulonglong),
+                ("madd_bytes"    , c_ulonglong),
+                ("skipped_bytes" , c_ulonglong),
+                ("elim_ns"       , c_ulonglong),
+                ("dw_hist"       , c_ulonglong * STATS_NBINS),
+                ("delay_hist"    , c_ulonglong * STATS_NBINS),
+                ("buf_hwm"       , c_int)]
+
+
+class dec_feedback(Structure):
+    _fields_ = [("inorder" , c_int),
+                ("win_s"   , c_int),
+                ("win_e"   , c_int),
+                ("deficit" , c_int),
+                ("nruns"   , c_int),
+                ("runs"    , (c_int * 2) * FB_MAXRUNS)]
+
+
+class scheduler(Structure):
+    _fields_ = [("delay"    , c_double),
+                ("budget"   , c_double),
+                ("loss"     , c_double),
+                ("burst"    , c_double),
+                ("seen"     , c_int),
+                ("deficit"  , c_int),
+                ("oldest"   , c_int),
+                ("rfloor"   , c_double),
+                ("rtarget"  , c_double),
+                ("repfreq"  , c_double),
+                ("shortlen" , c_int),
+                ("pshort"   , c_double),
+                ("credit"   , c_double),
+                ("scredit"  , c_double),
+                ("idle"     , c_int),
+                ("nsource"  , c_ulonglong),
+                ("nfull"    , c_ulonglong),
+                ("nshort"   , c_ulonglong)]
 
 
 class packet(Structure) :
@@ -26,9 +104,9 @@ class packet(Structure) :
                 ("syms"     , POINTER(c_ubyte))]
     
 
-class ROW_VEC(Structure) :
-    pass
-    	
+# void (*RELEASE_FN)(int sourceid, GF_ELEMENT *syms, void *arg)
+RELEASE_FN = CFUNCTYPE(None, c_int, POINTER(c_ubyte), c_void_p)
+
 
 class encoder(Structure):
     _fields_ = [("cp" , POINTER(parameters)),
@@ -41,26 +119,121 @@ class encoder(Structure):
                 ("tail"    , c_int),
                 ("headsid" , c_int),
                 ("tailsid" , c_int),
-                ("srcpkt"  , POINTER(POINTER(c_ubyte)))]
+                ("nseg"    , c_int),
+                ("nreserve", c_int),
+                ("srcseg"  , POINTER(c_void_p)),
+                ("freeseg" , c_void_p),
+                ("release" , RELEASE_FN),
+                ("release_arg", c_void_p),
+                ("prng"    , POINTER(MT19937)),
+                ("gk"      , c_void_p),
+                ("wireformat", c_int),
+                ("stats"   , encoder_stats),
+                ("trace"   , c_void_p),
+                ("pool"    , c_void_p),
+                ("sched"   , c_void_p)]
     
 
 class decoder(Structure):
-    _fields_ = [("cp"         , POINTER(parameters)),
+    pass
+
+
+# void (*DELIVER_FN)(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg)
+DELIVER_FN = CFUNCTYPE(None, POINTER(decoder), c_int, POINTER(c_ubyte), c_void_p)
+
+
+decoder._fields_ = [("cp"         , POINTER(parameters)),
                 ("pbuf"     , POINTER(packet)),
                 ("active"    , c_int),
                 ("inorder"   , c_int),
                 ("win_s"     , c_int),
                 ("win_e"     , c_int),
                 ("dof"       , c_int),
-                ("row"       , POINTER(POINTER(ROW_VEC))),
-                ("message"   , POINTER(POINTER(c_ubyte))),
+                ("dwcap"     , c_int),
+                ("cstride"   , c_int),
+                ("mstride"   , c_int),
+                ("rlen"      , POINTER(c_int)),
+                ("coefs"     , POINTER(c_ubyte)),
+                ("msgs"      , POINTER(c_ubyte)),
                 ("recovered" , POINTER(POINTER(c_ubyte))),
+                ("recvsize"  , c_int),
+                ("deliver"   , DELIVER_FN),
+                ("deliver_arg", c_void_p),
                 ("prev_rep"  , c_int),
-                ("prng"      , MT19937)]
+                ("gk"        , c_void_p),
+                ("stats"     , decoder_stats),
+                ("trace"     , c_void_p),
+                ("pool"      , c_void_p),
+                ("mode"      , c_int),
+                ("oplog"     , c_void_p),
+                ("nlog"      , c_int),
+                ("logcap"    , c_int)]
+
+
+class dec_slot(Structure):
+    _fields_ = [("dc"          , POINTER(decoder)),
+                ("cp"          , POINTER(parameters)),
+                ("deliver"     , DELIVER_FN),
+                ("deliver_arg" , c_void_p),
+                ("nrecv"       , c_int),
+                ("inorder"     , c_int),
+                ("prev_rep"    , c_int),
+                ("recovered"   , POINTER(POINTER(c_ubyte))),
+                ("acked"       , c_int)]
+
+
+class fe_req(Structure):
+    _fields_ = [("flow"   , c_uint),
+                ("op"     , c_int),
+                ("data"   , POINTER(c_ubyte)),
+                ("len"    , c_int),
+                ("out"    , POINTER(c_ubyte)),
+                ("outcap" , c_int),
+                ("arg"    , c_int),
+                ("tag"    , c_ulonglong)]
+
+
+class fe_cpl(Structure):
+    _fields_ = [("flow"     , c_uint),
+                ("op"       , c_int),
+                ("status"   , c_int),
+                ("len"      , c_int),
+                ("sourceid" , c_int),
+                ("tag"      , c_ulonglong),
+                ("data"     , POINTER(c_ubyte)),
+                ("out"      , POINTER(c_ubyte))]
+
+
+# void (*FE_DELIVER_FN)(uint32_t flow, int sourceid, GF_ELEMENT *syms, int len, void *arg)
+FE_DELIVER_FN = CFUNCTYPE(None, c_uint, c_int, POINTER(c_ubyte), c_int, c_void_p)
+
+
+class ut_stats(Structure):
+    _fields_ = [("nsource"  , c_ulonglong),
+                ("nrepair"  , c_ulonglong),
+                ("nprobe"   , c_ulonglong),
+                ("nspared"  , c_ulonglong),
+                ("nrecv"    , c_ulonglong),
+                ("nbad"     , c_ulonglong),
+                ("fbsent"   , c_ulonglong),
+                ("fbrecv"   , c_ulonglong),
+                ("dropped"  , c_ulonglong),
+                ("oversize" , c_ulonglong),
+                ("nsyscall" , c_ulonglong)]
 
 
 streamc = cdll.LoadLibrary("libstreamc.so")
 
+
+# Entry points added after the first release are bound only if the loaded
+# libstreamc.so exports them, so that the wrapper still imports against an
+# older build; check hasattr(streamc, name) before calling one of them
+def _bind(name, argtypes, restype):
+    if hasattr(streamc, name):
+        fn = getattr(streamc, name)
+        fn.argtypes = argtypes
+        fn.restype  = restype
+
 ##########################
 # Wrap encoder functions #
 ##########################
@@ -68,15 +241,31 @@ streamc = cdll.LoadLibrary("libstreamc.so")
 streamc.initialize_encoder.argtypes = [POINTER(parameters), POINTER(c_ubyte), c_int]
 streamc.initialize_encoder.restype  = POINTER(encoder)
 
+_bind("reserve_encoder_buffer", [POINTER(encoder), c_int], c_int)
+
 streamc.enqueue_packet.argtypes = [POINTER(encoder), c_int, POINTER(c_ubyte)]
 streamc.enqueue_packet.restype  = c_int
 
+# The RELEASE_FN object passed to set_release_callback must be kept referenced
+# by the caller for as long as the encoder lives
+_bind("enqueue_packet_nocopy", [POINTER(encoder), c_int, POINTER(c_ubyte)], c_int)
+
+_bind("set_release_callback", [POINTER(encoder), RELEASE_FN, c_void_p], None)
+
 streamc.output_repair_packet.argtypes = [POINTER(encoder)]
 streamc.output_repair_packet.restype  = POINTER(packet)
 
 streamc.output_repair_packet_short.argtypes = [POINTER(encoder), c_int]
 streamc.output_repair_packet_short.restype  = POINTER(packet)
 
+_bind("output_repair_packets", [POINTER(encoder), c_int, c_int, POINTER(POINTER(packet))], c_int)
+
+_bind("output_repair_packet_range", [POINTER(encoder), c_int, c_int], POINTER(packet))
+
+_bind("output_targeted_repairs", [POINTER(encoder), POINTER(dec_feedback), POINTER(POINTER(packet)), c_int], c_int)
+
+_bind("next_packet", [POINTER(encoder)], POINTER(packet))
+
 streamc.output_source_packet.argtypes = [POINTER(encoder)]
 streamc.output_source_packet.restype  = POINTER(packet)
 
@@ -98,12 +287,59 @@ streamc.free_serialized_packet.restype  = None
 streamc.free_encoder.argtypes = [POINTER(encoder)]
 streamc.free_encoder.restype  = None
 
+_bind("set_wire_format", [POINTER(encoder), c_int], None)
+
+_bind("get_encoder_stats", [POINTER(encoder), POINTER(encoder_stats)], None)
+
+_bind("set_encoder_trace", [POINTER(encoder), c_void_p], None)
+
+_bind("set_encoder_pool", [POINTER(encoder), c_void_p], None)
+
+_bind("set_encoder_scheduler", [POINTER(encoder), POINTER(scheduler)], None)
+
+_bind("sched_create", [c_double, c_double], POINTER(scheduler))
+
+_bind("sched_free", [POINTER(scheduler)], None)
+
+_bind("sched_feedback", [POINTER(encoder), POINTER(dec_feedback)], None)
+
+_bind("serialized_size", [POINTER(encoder), POINTER(packet)], c_int)
+
+_bind("serialize_packet_into", [POINTER(encoder), POINTER(packet), POINTER(c_ubyte), c_int], c_int)
+
+_bind("output_source_packet_into", [POINTER(encoder), POINTER(c_ubyte), c_int], c_int)
+
+_bind("output_repair_packet_into", [POINTER(encoder), POINTER(c_ubyte), c_int], c_int)
+
+_bind("output_repair_packet_short_into", [POINTER(encoder), c_int, POINTER(c_ubyte), c_int], c_int)
+
 ##########################
 # Wrap decoder functions #
 ##########################
 
 streamc.initialize_decoder.argtypes = [POINTER(parameters)]
 streamc.initialize_decoder.restype  = POINTER(decoder)
+_bind("initialize_decoder_at", [POINTER(parameters), c_int], POINTER(decoder))
+
+_bind("resize_recovered_buffer", [POINTER(decoder), c_int], c_int)
+
+# The DELIVER_FN object passed to set_delivery_callback must be kept referenced
+# by the caller for as long as the decoder lives
+_bind("set_delivery_callback", [POINTER(decoder), DELIVER_FN, c_void_p], None)
+
+_bind("get_decoder_stats", [POINTER(decoder), POINTER(decoder_stats)], None)
+
+_bind("set_decoder_trace", [POINTER(decoder), c_void_p], None)
+
+_bind("set_decoder_pool", [POINTER(decoder), c_void_p], None)
+
+_bind("set_decoder_mode", [POINTER(decoder), c_int], None)
+
+_bind("get_decoder_feedback", [POINTER(decoder), POINTER(dec_feedback)], None)
+
+_bind("serialize_feedback", [POINTER(dec_feedback), POINTER(c_ubyte), c_int], c_int)
+
+_bind("deserialize_feedback", [POINTER(c_ubyte), c_int, POINTER(dec_feedback)], c_int)
 
 streamc.activate_decoder.argtypes = [POINTER(decoder), POINTER(packet)]
 streamc.activate_decoder.restype  = c_int
@@ -120,13 +356,167 @@ streamc.process_packet.restype  = c_int
 streamc.deserialize_packet.argtypes = [POINTER(decoder), POINTER(c_ubyte)]
 streamc.deserialize_packet.restype  = POINTER(packet)
 
+_bind("deserialize_packet_view", [POINTER(decoder), POINTER(c_ubyte)], POINTER(packet))
+
 streamc.free_decoder.argtypes = [POINTER(decoder)]
 streamc.free_decoder.restype  = None
 
+# The parameters and the DELIVER_FN object passed to dec_slot_init must be kept
+# referenced by the caller for as long as the slot lives
+_bind("dec_slot_init", [POINTER(dec_slot), POINTER(parameters), c_int, DELIVER_FN, c_void_p], None)
+
+_bind("dec_slot_get", [POINTER(dec_slot)], POINTER(decoder))
+
+_bind("dec_slot_park", [POINTER(dec_slot)], c_int)
+
+_bind("dec_slot_ack", [POINTER(dec_slot), c_int], None)
+
+_bind("dec_slot_free", [POINTER(dec_slot)], None)
+
+_bind("dec_slot_inorder", [POINTER(dec_slot)], c_int)
+
+_bind("decoder_footprint", [POINTER(decoder)], c_ulong)
+
+_bind("dec_slot_footprint", [POINTER(dec_slot)], c_ulong)
+
+#####################################
+# Wrap multi-flow engine functions  #
+#####################################
+
+# Requests of a batch are submitted with a single call, outside of the GIL-bound
+# per-packet path; the engine itself runs on native worker threads
+_bind("fe_create", [c_int, c_int, c_int], c_void_p)
+
+_bind("fe_set_delivery", [c_void_p, FE_DELIVER_FN, c_void_p], None)
+
+_bind("fe_submit", [c_void_p, POINTER(fe_req), c_int], c_int)
+
+_bind("fe_complete", [c_void_p, POINTER(fe_cpl), c_int], c_int)
+
+_bind("fe_nworkers", [c_void_p], c_int)
+
+_bind("fe_destroy", [c_void_p], None)
+
+#############################
+# Wrap UDP tunnel functions #
+#############################
+
+# A batch of source packets is sent with a single call (and sendmmsg() per 64
+# datagrams), and ut_poll() receives, decodes and acknowledges natively; only
+# the delivery callback of the decoder re-enters Python, per delivered packet
+_bind("ut_open", [POINTER(parameters), c_char_p, c_int, c_int], c_void_p)
+
+_bind("ut_connect", [c_void_p, c_char_p, c_int, c_int], c_int)
+
+_bind("ut_ports", [c_void_p, POINTER(c_int), POINTER(c_int)], None)
+
+_bind("ut_encoder", [c_void_p], POINTER(encoder))
+
+_bind("ut_decoder", [c_void_p], POINTER(decoder))
+
+_bind("ut_set_feedback", [c_void_p, c_int], None)
+
+_bind("ut_set_loss", [c_void_p, c_double, c_double, c_double, c_ulong], None)
+
+_bind("ut_send", [c_void_p, POINTER(c_ubyte), c_int], c_int)
+
+_bind("ut_flush", [c_void_p], c_int)
+
+_bind("ut_poll", [c_void_p, c_int], c_int)
+
+_bind("ut_unacked", [c_void_p], c_int)
+
+_bind("ut_get_stats", [c_void_p, POINTER(ut_stats)], None)
+
+_bind("ut_close", [c_void_p], None)
+
+###################################
+# Wrap column-striped worker pool #
+###################################
+
+_bind("gf_pool_create", [c_int, c_int, c_int], c_void_p)
+
+_bind("gf_pool_free", [c_void_p], None)
+
+##############################
+# Wrap event trace functions #
+##############################
+
+_bind("trace_create", [c_int, c_int], c_void_p)
+
+_bind("trace_free", [c_void_p], None)
+
+_bind("trace_dump_file", [c_void_p, c_char_p], c_long)
+
+################################
+# Wrap split encoder functions #
+################################
+
+# The producer, sender and feedback roles may run on different threads, see
+# splitenc.h; the encoder of se_encoder() belongs to the sender
+_bind("se_create", [POINTER(parameters), c_int], c_void_p)
+
+_bind("se_free", [c_void_p], None)
+
+_bind("se_enqueue", [c_void_p, POINTER(c_ubyte)], c_int)
+
+_bind("se_reserve", [c_void_p], POINTER(c_ubyte))
+
+_bind("se_commit", [c_void_p], c_int)
+
+_bind("se_ack", [c_void_p, c_int], None)
+
+_bind("se_encoder", [c_void_p], POINTER(encoder))
+
+_bind("se_sync", [c_void_p], c_int)
+
+_bind("se_output_source", [c_void_p], POINTER(packet))
+
+_bind("se_output_repair", [c_void_p, c_int], POINTER(packet))
+
+_bind("se_published", [c_void_p], c_int)
+
+_bind("se_sent", [c_void_p], c_int)
+
+_bind("se_acked", [c_void_p], c_int)
+
+###################################################
+# Batch entry points over buffer-protocol objects #
+###################################################
+
+# One call per batch of N packets held in bytes, bytearray, memoryview, array
+# or NumPy buffers instead of one ctypes call per packet, see pybatch.c. The
+# encoder or decoder is passed as the pointer returned by initialize_*().
+# Serialized packets are laid out in slots of stride bytes, with their lengths
+# in an int32 buffer, e.g., array('i', bytes(4 * N)). Requires the pybatch
+# extension, None otherwise
+if pybatch is not None:
+    # enqueue_batch(ec, data), encode_batch(ec, data, repfreq, out, stride, lens)
+    enqueue_batch = pybatch.enqueue
+    encode_batch = pybatch.encode
+    # output_*_batch(ec, n[, ew_width], out, stride, lens)
+    output_source_batch = pybatch.output_source
+    output_repair_batch = pybatch.output_repair
+    next_packets_batch = pybatch.next_packets
+    # receive_batch(dc, data, lens, stride=0), stride 0 for packets packed back
+    # to back; returns dc.contents.inorder afterwards and the number of packets
+    # rejected as truncated or padded, (inorder, rejected); empty slots are skipped
+    receive_batch = pybatch.receive
+    # recovered_views(dc, first, last=inorder): zero-copy memoryviews, valid until
+    # their slots are reused recvsize packets later; polling decoders only
+    recovered_views = pybatch.recovered
+else:
+    enqueue_batch = encode_batch = output_source_batch = output_repair_batch = None
+    next_packets_batch = receive_batch = recovered_views = None
+
 #################################################
 # Wrap pseudo-random number generator functions #
 #################################################
 
+_bind("coef_at", [c_int, c_int, c_int, c_int], c_int)
+
+_bind("coef_batch", [c_int, c_int, c_int, c_int, c_int, POINTER(c_ubyte)], None)
+
 #streamc.mt19937_init.argtypes = [c_ulong, c_ulong]
 #streamc.mt19937_init.restype  = None
 
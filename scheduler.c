@@ -0,0 +1,148 @@
+/*
+ * Adaptive repair scheduler. See scheduler.h.
+ */
+#include <math.h>
+#include "scheduler.h"
+
+static double clamp_rate(double r)
+{
+    return r < SCHED_RMIN ? SCHED_RMIN : (r > SCHED_RMAX ? SCHED_RMAX : r);
+}
+
+// rate bounds and short width from the current estimates
+static void decide(struct scheduler *sch)
+{
+    double p = sch->loss < 0.5 ? sch->loss : 0.5;
+    sch->rfloor = clamp_rate((1 + SCHED_MARGIN) * p / (1 - p));
+    sch->rtarget = sch->rfloor;
+    if (sch->delay > 0 && p > 0 && sch->burst / sch->delay > sch->rtarget)
+        sch->rtarget = clamp_rate(sch->burst / sch->delay);
+    sch->shortlen = (int) ceil(2 * sch->burst * (1 + 1 / sch->rtarget));
+    if (sch->shortlen < SCHED_MINSHORT)
+        sch->shortlen = SCHED_MINSHORT;
+}
+
+// repfreq and pshort for an EW of w source packets under the CPU budget
+static void plan(struct scheduler *sch, int w)
+{
+    double r = sch->rtarget;
+    double ps = 0;
+    int len = sch->shortlen;
+    if (sch->budget > 0 && w > len && r / (1 + r) * w > sch->budget) {
+        ps = (w - sch->budget * (1 + r) / r) / (w - len);
+        if (ps > SCHED_PSHORT) {
+            ps = SCHED_PSHORT;
+            double c = ps * len + (1 - ps) * w;     // per repair packet
+            double rc = sch->budget / (c - sch->budget);
+            if (rc < r)
+                r = rc > sch->rfloor ? rc : sch->rfloor;
+        }
+    }
+    sch->repfreq = r;
+    sch->pshort = ps;
+}
+
+struct scheduler *sched_create(double delay, double budget)
+{
+    struct scheduler *sch = calloc(1, sizeof(struct scheduler));
+    if (sch == NULL)
+        return NULL;
+    sch->delay  = delay;
+    sch->budget = budget;
+    sch->loss   = SCHED_LOSS0;
+    sch->burst  = 1;
+    sch->seen   = -1;
+    sch->oldest = -1;
+    decide(sch);
+    sch->repfreq = sch->rtarget;
+    return sch;
+}
+
+void sched_free(struct scheduler *sch)
+{
+    free(sch);
+}
+
+void set_encoder_scheduler(struct encoder *ec, struct scheduler *sch)
+{
+    ec->sched = sch;
+}
+
+void sched_feedback(struct encoder *ec, const struct dec_feedback *fb)
+{
+    if (fb->inorder >= ec->headsid)
+        flush_acked_packets(ec, fb->inorder);
+    struct scheduler *sch = ec->sched;
+    if (sch == NULL)
+        return;
+    sch->idle = 0;
+    sch->deficit = fb->deficit;
+    sch->oldest = fb->nruns > 0 ? fb->runs[0][0] : -1;
+    // ids beyond the decoding window are not known to the decoder yet
+    int covered = fb->win_e > fb->inorder ? fb->win_e : fb->inorder;
+    int n = covered - sch->seen;
+    if (n <= 0)
+        return;
+    // only the newly reported ids are sampled; ids recovered before the feedback
+    // was taken are missed, merged runs (beyond FB_MAXRUNS) are overcounted
+    int lost = 0, nruns = 0, runlen = 0;
+    for (int i=0; i<fb->nruns; i++) {
+        int s = fb->runs[i][0];
+        int e = s + fb->runs[i][1] - 1;
+        if (e <= sch->seen)
+            continue;
+        lost += e - (s > sch->seen ? s : sch->seen + 1) + 1;
+        runlen += fb->runs[i][1];
+        nruns++;
+    }
+    sch->loss = (sch->loss * SCHED_HORIZON + lost) / (SCHED_HORIZON + n);
+    if (nruns > 0)
+        sch->burst = (sch->burst * SCHED_BURSTS + runlen) / (SCHED_BURSTS + nruns);
+    sch->seen = covered;
+    decide(sch);
+}
+
+struct packet *next_packet(struct encoder *ec)
+{
+    struct scheduler *sch = ec->sched;
+    int waiting = ec->nextsid < ec->snum;
+    int w = ec->head == -1 ? 0 : ec->nextsid - ec->headsid;
+    if (sch == NULL) {
+        if (waiting)
+            return output_source_packet(ec);
+        return w > 0 ? output_repair_packet(ec) : NULL;
+    }
+    plan(sch, w);
+    if (waiting && (w == 0 || sch->credit < 1)) {
+        sch->credit += sch->repfreq;
+        if (sch->credit > 1 + SCHED_RMAX)
+            sch->credit = 1 + SCHED_RMAX;
+        sch->idle = 0;
+        sch->nsource++;
+        return output_source_packet(ec);
+    }
+    if (w == 0)
+        return NULL;
+    if (!waiting) {
+        // the tail: cover what the decoder may still miss, then wait for feedback
+        int unseen = ec->nextsid - 1 - sch->seen;
+        int due = sch->deficit + (unseen > 0 ? (int) ceil((1 + SCHED_MARGIN) * sch->loss * unseen) : 0);
+        if (sch->idle >= due)
+            return NULL;
+        sch->idle++;
+        sch->nfull++;
+        return output_repair_packet(ec);
+    }
+    sch->credit -= 1;
+    if (sch->scredit < 1)
+        sch->scredit += sch->pshort;
+    // short repairs cannot recover losses older than their window
+    int reach = sch->oldest < 0 || sch->oldest >= ec->nextsid - sch->shortlen;
+    if (sch->scredit >= 1 && sch->shortlen < w && reach) {
+        sch->scredit -= 1;
+        sch->nshort++;
+        return output_repair_packet_short(ec, sch->shortlen);
+    }
+    sch->nfull++;
+    return output_repair_packet(ec);
+}
@@ -0,0 +1,72 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+/*
+ * Adaptive repair scheduler of an encoder
+ *
+ * Instead of a fixed repfreq and a static mix of full and short repair packets
+ * chosen by the application, next_packet() decides what to send from online
+ * estimates of the loss rate and the mean loss burst length, which
+ * sched_feedback() updates from each decoder feedback summary (struct
+ * dec_feedback) with an EWMA weighted by the number of newly reported ids.
+ *
+ * From the estimates (p, b), with W the current EW width:
+ *  a) repairs per source packet r = max((1+margin) p/(1-p), b/delay), i.e.,
+ *     enough DoF for the loss rate, and a burst of b losses repaired within
+ *     the in-order delay target (in source packets)
+ *  b) short repair packets span the last L = 2b(1+1/r) source packets, enough
+ *     for a burst and the repairs following it
+ *  c) the fraction of short repairs is the lowest one that keeps the average
+ *     number of source packets mixed per sent packet, r/(1+r) of the EW width,
+ *     within the CPU budget. If even SCHED_PSHORT repairs being short do not,
+ *     r is lowered towards the rate bound, i.e., delay is traded for CPU. While
+ *     the decoder reports a missing id older than L, only full repairs are sent
+ * Repairs are interleaved deterministically by accumulated credit rather than
+ * by a coin toss. While no source packet is waiting, full repairs are sent until
+ * the last reported deficit plus the expected losses among the ids not yet
+ * reported are covered, then next_packet() returns NULL until new feedback or
+ * a new source packet arrives.
+ */
+#include "streamcodec.h"
+
+#define SCHED_LOSS0     0.05        // initial loss rate estimate, before any feedback
+#define SCHED_HORIZON   256         // newly reported ids weighing as much as the loss estimate
+#define SCHED_BURSTS    8           // newly reported runs weighing as much as the burst estimate
+#define SCHED_MARGIN    0.2         // DoF margin over the loss rate
+#define SCHED_RMIN      (1.0 / 64)  // repairs per source packet, bounds
+#define SCHED_RMAX      1.0
+#define SCHED_MINSHORT  8           // minimum width of short repair packets
+#define SCHED_PSHORT    0.75        // maximum fraction of short repairs, the rest sweep the EW
+
+struct scheduler {
+    // targets
+    double  delay;                  // in-order delay target, in source packets
+    double  budget;                 // CPU budget, in source packets mixed per sent packet
+    // estimates
+    double  loss;                   // loss rate
+    double  burst;                  // mean loss burst length
+    int     seen;                   // highest id covered by feedback so far
+    int     deficit;                // rank deficit of the last feedback
+    int     oldest;                 // first missing id of the last feedback, -1 if none
+    // decisions
+    double  rfloor;                 // repairs per source packet for the loss rate
+    double  rtarget;                // ... and for the delay target
+    double  repfreq;                // ... after the CPU budget, of the last packet
+    int     shortlen;               // width of short repair packets
+    double  pshort;                 // fraction of short repairs at the last repair
+    double  credit;                 // accumulated repairs due
+    double  scredit;                // accumulated short repairs due
+    int     idle;                   // repairs sent since the last source packet or feedback
+    // counters
+    unsigned long long  nsource;
+    unsigned long long  nfull;
+    unsigned long long  nshort;
+};
+
+// delay and budget <= 0 for no target
+struct scheduler *sched_create(double delay, double budget);
+void sched_free(struct scheduler *sch);
+// Update the estimates and decisions of the encoder's scheduler from a decoder
+// feedback summary, and flush up to fb->inorder
+void sched_feedback(struct encoder *ec, const struct dec_feedback *fb);
+
+#endif  // SCHEDULER_H
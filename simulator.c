@@ -0,0 +1,431 @@
+/*
+ * Monte Carlo simulation engine. See simulator.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "simulator.h"
+
+// per-trial state, which used to be the globals of the example simulations
+struct sim_state {
+    const struct sim_config *sc;
+    uint64_t        rng;            // xorshift64* state
+    int             slot;
+    int             *sent_time;     // slot each source packet is sent uncoded
+    unsigned char   *data;
+    int             bad;            // Gilbert-Elliott state
+    int             toff;           // offset into the loss trace
+    int             ndelivered;
+    long            delay_sum;
+    int             delay_max;
+    int             correct;
+    unsigned long   *hist;
+};
+
+struct sim_pool {
+    const struct sim_config *sc;
+    struct sim_trial    *trials;
+    atomic_int          next;       // next trial to run
+    unsigned long       *hist;      // 2 * SIM_DELAY_BINS per thread
+};
+
+struct sim_worker_arg {
+    struct sim_pool     *pool;
+    unsigned long       *hist;      // delay histogram of the thread
+    unsigned long       *thist;     // ... of its current trial, zero between trials
+};
+
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t rng_next(struct sim_state *s)
+{
+    s->rng ^= s->rng >> 12;
+    s->rng ^= s->rng << 25;
+    s->rng ^= s->rng >> 27;
+    return s->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_uniform(struct sim_state *s)
+{
+    return (rng_next(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void sim_default_config(struct sim_config *sc)
+{
+    memset(sc, 0, sizeof(struct sim_config));
+    sc->cp.gfpower = 8;
+    sc->cp.pktsize = 200;
+    sc->cp.repfreq = 4;
+    sc->cp.coemode = COE_MT19937;
+    sc->snum       = 1000;
+    sc->T_ACK      = 1;
+    sc->ch.type    = SIM_BERNOULLI;
+    sc->ch.pe      = 0.1;
+    sc->ntrials    = 100;
+    sc->nthreads   = 0;             // one per online CPU
+    sc->seed       = 1;
+}
+
+unsigned char *sim_load_trace(const char *path, int *len)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return NULL;
+    int n = 0, cap = 4096, c;
+    unsigned char *trace = malloc(cap);
+    while (trace != NULL && (c = fgetc(fp)) != EOF) {
+        if (c != '0' && c != '1')
+            continue;
+        if (n == cap) {
+            cap *= 2;
+            unsigned char *t = realloc(trace, cap);
+            if (t == NULL) {
+                free(trace);
+                trace = NULL;
+                break;
+            }
+            trace = t;
+        }
+        trace[n++] = c - '0';
+    }
+    fclose(fp);
+    if (trace != NULL && n == 0) {
+        free(trace);
+        trace = NULL;
+    }
+    *len = n;
+    return trace;
+}
+
+static void deliver(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    (void) dc;
+    struct sim_state *s = arg;
+    int pktsize = s->sc->cp.pktsize;
+    if (memcmp(syms, s->data + (size_t) sourceid * pktsize, pktsize) != 0)
+        s->correct = 0;
+    int delay = s->slot - s->sent_time[sourceid];
+    s->ndelivered++;
+    s->delay_sum += delay;
+    if (delay > s->delay_max)
+        s->delay_max = delay;
+    if (s->hist != NULL)
+        s->hist[delay < SIM_DELAY_BINS ? delay : SIM_DELAY_BINS - 1]++;
+}
+
+static int erased(struct sim_state *s, int nuse)
+{
+    const struct sim_channel *ch = &s->sc->ch;
+    int e;
+    switch (ch->type) {
+    case SIM_GILBERT_ELLIOTT:
+        e = rng_uniform(s) < (s->bad ? ch->pe_bad : ch->pe_good);
+        if (rng_uniform(s) < (s->bad ? ch->p_bg : ch->p_gb))
+            s->bad = !s->bad;
+        return e;
+    case SIM_TRACE:
+        return ch->trace[(s->toff + nuse) % ch->tracelen];
+    default:
+        return rng_uniform(s) < ch->pe;
+    }
+}
+
+static int time_to_send_repair(struct sim_state *s, struct encoder *ec)
+{
+    const struct sim_config *sc = s->sc;
+    int nextsid = ec->nextsid;
+    if (nextsid >= ec->snum)
+        return 1;                   // no more source packets to send
+    if (nextsid == 0 || nextsid <= ec->headsid)
+        return 0;                   // nothing sent is unacknowledged
+    if (sc->irreg_range != 0) {
+        int sent = nextsid + ec->rcount;
+        for (int i=0; i<sc->irreg_snum; i++) {
+            if (sent % sc->irreg_range == sc->irreg_spos[i])
+                return 0;
+        }
+        return 1;
+    }
+    if (sc->cp.repfreq < 1)
+        return rng_uniform(s) < sc->cp.repfreq;
+    return (ec->count + 1) % ((int) sc->cp.repfreq + 1) == 0;
+}
+
+static struct packet *generate_packet(struct sim_state *s, struct encoder *ec)
+{
+    if (ec->snum == 0 || ec->head == -1)
+        return NULL;                // nothing queued, or all queued packets are flushed
+    if (time_to_send_repair(s, ec))
+        return output_repair_packet(ec);
+    struct packet *pkt = output_source_packet(ec);
+    s->sent_time[pkt->sourceid] = s->slot;
+    return pkt;
+}
+
+int sim_run_trial(const struct sim_config *sc, int trial, struct sim_trial *res, unsigned long *hist)
+{
+    const struct sim_channel *ch = &sc->ch;
+    int snum = sc->snum, T_P = ch->T_P;
+    int T_ACK = sc->T_ACK > 0 ? sc->T_ACK : 1;
+    int maxslots = sc->maxslots > 0 ? sc->maxslots : 100 * snum;
+    struct sim_state s;
+    memset(&s, 0, sizeof(s));
+    memset(res, 0, sizeof(struct sim_trial));
+    s.sc      = sc;
+    s.rng     = splitmix64(sc->seed ^ splitmix64(trial)) | 1;
+    s.slot    = -1;
+    s.correct = 1;
+    s.hist    = hist;
+
+    struct parameters cp = sc->cp;
+    cp.seed = rng_next(&s) & 0x7fffffff;
+    if (ch->type == SIM_TRACE)
+        s.toff = rng_next(&s) % ch->tracelen;
+    size_t datasize = (size_t) snum * cp.pktsize;
+    s.data      = malloc(datasize);
+    s.sent_time = calloc(snum, sizeof(int));
+    unsigned char **queue = calloc(T_P+1, sizeof(unsigned char *));  // propagation delayed packets
+    int *feedback = malloc(sizeof(int) * (T_P+1));                     // propagation delayed in-order feedback
+    if (s.data == NULL || s.sent_time == NULL || queue == NULL || feedback == NULL) {
+        free(s.data);
+        free(s.sent_time);
+        free(queue);
+        free(feedback);
+        return -1;
+    }
+    for (size_t i=0; i<datasize; i+=8) {
+        uint64_t r = rng_next(&s);
+        memcpy(s.data + i, &r, datasize - i < 8 ? datasize - i : 8);
+    }
+    for (int i=0; i<=T_P; i++)
+        feedback[i] = -1;
+
+    struct encoder *ec = initialize_encoder(&cp, NULL, 0);
+    struct decoder *dc = initialize_decoder(&cp);
+    if (ec == NULL || dc == NULL) {
+        free_encoder(ec);
+        free_decoder(dc);
+        free(s.data);
+        free(s.sent_time);
+        free(queue);
+        free(feedback);
+        return -1;
+    }
+    set_delivery_callback(dc, deliver, &s);
+    int eqnsid = 0;
+    if (sc->arrival == 0) {
+        for (; eqnsid<snum; eqnsid++)
+            enqueue_packet(ec, eqnsid, s.data + (size_t) eqnsid * cp.pktsize);
+    }
+    while (dc->inorder < snum-1 && s.slot < maxslots) {
+        s.slot += 1;
+        if (sc->arrival != 0 && eqnsid < snum && rng_uniform(&s) < sc->arrival) {
+            enqueue_packet(ec, eqnsid, s.data + (size_t) eqnsid * cp.pktsize);
+            eqnsid++;
+        }
+        int pos1 = s.slot % (T_P+1);        // where the packet sent in this slot is queued
+        int pos2 = (s.slot-T_P) % (T_P+1);  // which packet is received in this slot
+        // Unlike the examples, in-flight packets are still received in slots
+        // where the encoder has nothing to send
+        struct packet *pkt = generate_packet(&s, ec);
+        free(queue[pos1]);
+        queue[pos1] = NULL;
+        if (pkt != NULL) {
+            if (erased(&s, res->nuse)) {
+                res->nerased++;
+            } else {
+                queue[pos1] = serialize_packet(ec, pkt);
+            }
+            res->nuse++;
+            free_packet(pkt);
+        }
+        if (T_P > 0 && ch->reorder > 0 && rng_uniform(&s) < ch->reorder) {
+            int ro1 = rng_next(&s) % (T_P+1);
+            int ro2 = rng_next(&s) % (T_P+1);
+            unsigned char *tmp = queue[ro1];
+            queue[ro1] = queue[ro2];
+            queue[ro2] = tmp;
+        }
+        if (s.slot >= T_P && queue[pos2] != NULL) {
+            struct packet *rpkt = deserialize_packet(dc, queue[pos2]);
+            if (rpkt != NULL)
+                receive_packet(dc, rpkt);
+            free(queue[pos2]);
+            queue[pos2] = NULL;
+        }
+        // lossless in-order feedback, delayed by T_P as well
+        if (dc->inorder >= 0 && s.slot >= T_P && s.slot % T_ACK == 0) {
+            feedback[pos1] = dc->inorder;
+            if (feedback[pos2] != -1) {
+                flush_acked_packets(ec, feedback[pos2]);
+                feedback[pos2] = -1;
+            }
+        }
+    }
+    res->nslots = s.slot + 1;
+    res->correct = s.correct && dc->inorder == snum-1;
+    res->delay_mean = s.ndelivered ? (double) s.delay_sum / s.ndelivered : 0;
+    res->delay_max = s.delay_max;
+    res->throughput = res->nuse ? (double) (dc->inorder+1) / res->nuse : 0;
+
+    for (int i=0; i<=T_P; i++)
+        free(queue[i]);
+    free(queue);
+    free(feedback);
+    free_encoder(ec);
+    free_decoder(dc);
+    free(s.sent_time);
+    free(s.data);
+    return 0;
+}
+
+static void *sim_worker(void *arg)
+{
+    struct sim_worker_arg *wa = arg;
+    struct sim_pool *pool = wa->pool;
+    int t;
+    while ((t = atomic_fetch_add(&pool->next, 1)) < pool->sc->ntrials) {
+        struct sim_trial *r = &pool->trials[t];
+        if (sim_run_trial(pool->sc, t, r, wa->thist) != 0)
+            r->correct = -1;
+        // delays of failed trials are left out, as they are of the other statistics
+        int nbins = r->delay_max < SIM_DELAY_BINS ? r->delay_max + 1 : SIM_DELAY_BINS;
+        for (int d=0; d<nbins; d++) {
+            if (r->correct == 1)
+                wa->hist[d] += wa->thist[d];
+            wa->thist[d] = 0;
+        }
+    }
+    return NULL;
+}
+
+static int percentile(const unsigned long *hist, unsigned long total, double q)
+{
+    unsigned long cum = 0;
+    for (int d=0; d<SIM_DELAY_BINS; d++) {
+        cum += hist[d];
+        if (cum >= q * total)
+            return d;
+    }
+    return SIM_DELAY_BINS - 1;
+}
+
+int sim_run(const struct sim_config *sc, struct sim_trial *trials, struct sim_stats *st)
+{
+    if (sc->ntrials <= 0 || sc->snum <= 0 || sc->ch.T_P < 0
+        || (sc->ch.type == SIM_TRACE && (sc->ch.trace == NULL || sc->ch.tracelen <= 0)))
+        return -1;
+    int nthreads = sc->nthreads > 0 ? sc->nthreads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > sc->ntrials)
+        nthreads = sc->ntrials;
+
+    struct sim_pool pool;
+    pool.sc     = sc;
+    pool.trials = trials != NULL ? trials : calloc(sc->ntrials, sizeof(struct sim_trial));
+    pool.hist   = calloc((size_t) 2 * nthreads * SIM_DELAY_BINS, sizeof(unsigned long));
+    pthread_t *tids = malloc(sizeof(pthread_t) * nthreads);
+    struct sim_worker_arg *args = malloc(sizeof(struct sim_worker_arg) * nthreads);
+    if (pool.trials == NULL || pool.hist == NULL || tids == NULL || args == NULL) {
+        if (trials == NULL)
+            free(pool.trials);
+        free(pool.hist);
+        free(tids);
+        free(args);
+        return -1;
+    }
+    atomic_init(&pool.next, 0);
+
+    double t0 = now();
+    int nstarted = 0;
+    for (int i=0; i<nthreads; i++) {
+        args[i].pool = &pool;
+        args[i].hist = pool.hist + (size_t) i * SIM_DELAY_BINS;
+        args[i].thist = pool.hist + (size_t) (nthreads + i) * SIM_DELAY_BINS;
+        if (pthread_create(&tids[i], NULL, sim_worker, &args[i]) != 0)
+            break;
+        nstarted++;
+    }
+    if (nstarted == 0)
+        sim_worker(&args[0]);       // run on the calling thread
+    for (int i=0; i<nstarted; i++)
+        pthread_join(tids[i], NULL);
+
+    // aggregate in trial order, so that floating-point sums do not depend on scheduling
+    memset(st, 0, sizeof(struct sim_stats));
+    st->ntrials = sc->ntrials;
+    st->throughput_min = 1;
+    double dsq = 0, tsq = 0;
+    long nuse = 0, nerased = 0;
+    int nok = 0;
+    for (int t=0; t<sc->ntrials; t++) {
+        struct sim_trial *r = &pool.trials[t];
+        nuse += r->nuse;
+        nerased += r->nerased;
+        if (r->correct != 1) {
+            st->nfailed++;
+            continue;
+        }
+        nok++;
+        st->delay_mean += r->delay_mean;
+        dsq += r->delay_mean * r->delay_mean;
+        st->throughput_mean += r->throughput;
+        tsq += r->throughput * r->throughput;
+        if (r->throughput < st->throughput_min)
+            st->throughput_min = r->throughput;
+        if (r->delay_max > st->delay_max)
+            st->delay_max = r->delay_max;
+    }
+    if (nok > 0) {
+        st->delay_mean /= nok;
+        st->throughput_mean /= nok;
+        st->delay_std = sqrt(fmax(dsq / nok - st->delay_mean * st->delay_mean, 0));
+        st->throughput_std = sqrt(fmax(tsq / nok - st->throughput_mean * st->throughput_mean, 0));
+    } else {
+        st->throughput_min = 0;
+    }
+    st->nuse_mean = (double) nuse / sc->ntrials;
+    st->erasure_rate = nuse ? (double) nerased / nuse : 0;
+
+    // per-thread histograms hold integer counts, whose sum is order-independent
+    unsigned long *hist = pool.hist, total = 0;
+    for (int i=1; i<nthreads; i++) {
+        for (int d=0; d<SIM_DELAY_BINS; d++)
+            hist[d] += pool.hist[(size_t) i * SIM_DELAY_BINS + d];
+    }
+    for (int d=0; d<SIM_DELAY_BINS; d++)
+        total += hist[d];
+    if (total > 0) {
+        st->delay_p50 = percentile(hist, total, 0.50);
+        st->delay_p95 = percentile(hist, total, 0.95);
+        st->delay_p99 = percentile(hist, total, 0.99);
+    }
+    st->seconds = now() - t0;
+
+    if (trials == NULL)
+        free(pool.trials);
+    free(pool.hist);
+    free(tids);
+    free(args);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+/*
+ * Monte Carlo simulation engine of streaming coding over an erasure channel
+ *
+ * A trial is the loop of examples/test.bernoulli.full.c: snum source packets
+ * arrive at the sending queue, a source or repair packet is sent every time
+ * slot, packets not erased by the channel are received T_P slots later, and the
+ * in-order feedback of the decoder flushes the encoder (lossless, every T_ACK
+ * slots, also delayed by T_P). All state of a trial is local to it, so that
+ * independent trials run in parallel on a pool of threads.
+ *
+ * Channels:
+ *  - SIM_BERNOULLI: i.i.d. erasures with probability pe
+ *  - SIM_GILBERT_ELLIOTT: two-state Markov chain, good->bad with probability
+ *    p_gb and bad->good with p_bg per slot, erasing with pe_good/pe_bad
+ *  - SIM_TRACE: a recorded loss sequence (1: erased), cycled from a random
+ *    offset per trial, see sim_load_trace()
+ * With probability `reorder` per slot, two in-flight packets swap places.
+ *
+ * Results are deterministic per seed: every trial draws its data, channel and
+ * code seed from a PRNG seeded by (seed, trial index) only, and aggregates are
+ * accumulated in trial order, whatever the number of threads.
+ */
+#include "streamcodec.h"
+
+#define SIM_DELAY_BINS  4096        // histogram of in-order delays, one bin per slot, last one overflows
+
+enum sim_channel_type {
+    SIM_BERNOULLI = 0,
+    SIM_GILBERT_ELLIOTT,
+    SIM_TRACE,
+};
+
+struct sim_channel {
+    int         type;               // one of sim_channel_type
+    double      pe;                 // SIM_BERNOULLI: erasure probability
+    double      p_gb;               // SIM_GILBERT_ELLIOTT: transition probabilities per slot
+    double      p_bg;
+    double      pe_good;            // erasure probabilities in the good/bad states
+    double      pe_bad;
+    const unsigned char *trace;     // SIM_TRACE: loss sequence, 1 if erased
+    int         tracelen;
+    double      reorder;            // probability of swapping two in-flight packets per slot
+    int         T_P;                // propagation delay in slots
+};
+
+struct sim_config {
+    struct parameters cp;           // code parameters; cp.seed is re-drawn for each trial
+    int         snum;               // source packets per trial
+    double      arrival;            // Bernoulli arrival rate, 0 if all are queued before slot 0
+    int         T_ACK;              // feedback period in slots
+    int         irreg_range;        // period of an irregular pattern of source/repair packets, 0 if none
+    int         irreg_snum;         // number of positions sending source packets in the period
+    const int   *irreg_spos;
+    int         maxslots;           // a trial fails if not all packets are in order by then, 0: 100*snum
+    struct sim_channel ch;
+    int         ntrials;
+    int         nthreads;
+    unsigned long seed;
+};
+
+// result of one trial
+struct sim_trial {
+    int         correct;            // all delivered in order before maxslots and identical to the data
+    int         nslots;             // slots until the last source packet is in order
+    int         nuse;               // channel uses, i.e., packets sent
+    int         nerased;
+    double      delay_mean;         // in-order delay, slot of delivery - slot sent uncoded
+    int         delay_max;
+    double      throughput;         // snum / nuse
+};
+
+// aggregate over the trials that did not fail (means and deviations are over
+// trials, percentiles over all their packets); nfailed counts the others
+struct sim_stats {
+    int         ntrials;
+    int         nfailed;
+    double      delay_mean;
+    double      delay_std;
+    int         delay_max;
+    int         delay_p50;
+    int         delay_p95;
+    int         delay_p99;
+    double      throughput_mean;
+    double      throughput_std;
+    double      throughput_min;
+    double      nuse_mean;
+    double      erasure_rate;       // fraction of channel uses erased
+    double      seconds;            // wall-clock time of sim_run()
+};
+
+void sim_default_config(struct sim_config *sc);
+// Run one trial; hist, if not NULL, accumulates SIM_DELAY_BINS delay counts
+int sim_run_trial(const struct sim_config *sc, int trial, struct sim_trial *res, unsigned long *hist);
+// Run sc->ntrials trials on sc->nthreads threads; trials, if not NULL, receives
+// every result in trial order. Returns 0 on success, -1 on error
+int sim_run(const struct sim_config *sc, struct sim_trial *trials, struct sim_stats *st);
+// Load a loss trace of '0'/'1' characters (1: erased), anything else is skipped
+unsigned char *sim_load_trace(const char *path, int *len);
+
+#endif  // SIMULATOR_H
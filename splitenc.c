@@ -0,0 +1,154 @@
+/*
+ * Split encoder for concurrent enqueue, output and acknowledgement. See
+ * splitenc.h.
+ */
+#include <stdatomic.h>
+#include "splitenc.h"
+
+struct split_encoder {
+    struct encoder      *ec;        // sender only
+    GF_ELEMENT          *ring;      // capacity slots of pktsize bytes
+    int                 capacity;   // a power of 2
+    int                 pktsize;
+    _Alignas(CACHELINE) atomic_int tail;    // next source id, written by the producer
+    _Alignas(CACHELINE) atomic_int head;    // first unflushed source id, written by the sender
+    _Alignas(CACHELINE) atomic_int ack;     // highest acknowledgement, written by feedback threads
+    _Alignas(CACHELINE) atomic_int sent;    // nextsid of the encoder, written by the sender
+};
+
+#define SE_SLOT(se, sid)    ((se)->ring + (size_t) ((sid) & ((se)->capacity - 1)) * (se)->pktsize)
+
+// Called by flush_acked_packets() on the sender thread, in source id order
+static void release_slot(int sourceid, GF_ELEMENT *syms, void *arg)
+{
+    struct split_encoder *se = arg;
+    (void) syms;
+    atomic_store_explicit(&se->head, sourceid + 1, memory_order_release);
+}
+
+struct split_encoder *se_create(struct parameters *cp, int capacity)
+{
+    struct split_encoder *se = aligned_alloc(CACHELINE, ALIGN(sizeof(struct split_encoder), CACHELINE) * CACHELINE);
+    if (se == NULL)
+        return NULL;
+    memset(se, 0, sizeof(struct split_encoder));
+    se->capacity = 1;
+    while (se->capacity < capacity)
+        se->capacity <<= 1;
+    se->pktsize = cp->pktsize;
+    se->ring = aligned_alloc(CACHELINE, ALIGN((size_t) se->capacity * se->pktsize, CACHELINE) * CACHELINE);
+    se->ec = initialize_encoder(cp, NULL, 0);
+    if (se->ring == NULL || se->ec == NULL) {
+        se_free(se);
+        return NULL;
+    }
+    set_release_callback(se->ec, release_slot, se);
+    atomic_init(&se->tail, 0);
+    atomic_init(&se->head, 0);
+    atomic_init(&se->ack, -1);
+    atomic_init(&se->sent, 0);
+    return se;
+}
+
+void se_free(struct split_encoder *se)
+{
+    if (se == NULL)
+        return;
+    if (se->ec != NULL)
+        free_encoder(se->ec);
+    free(se->ring);
+    free(se);
+}
+
+GF_ELEMENT *se_reserve(struct split_encoder *se)
+{
+    int tail = atomic_load_explicit(&se->tail, memory_order_relaxed);
+    // acquire: the encoder is done reading the slot before it is handed back
+    if (tail - atomic_load_explicit(&se->head, memory_order_acquire) >= se->capacity)
+        return NULL;
+    return SE_SLOT(se, tail);
+}
+
+int se_commit(struct split_encoder *se)
+{
+    int tail = atomic_load_explicit(&se->tail, memory_order_relaxed);
+    atomic_store_explicit(&se->tail, tail + 1, memory_order_release);
+    return tail;
+}
+
+int se_enqueue(struct split_encoder *se, const GF_ELEMENT *syms)
+{
+    GF_ELEMENT *slot = se_reserve(se);
+    if (slot == NULL)
+        return -1;
+    memcpy(slot, syms, se->pktsize);
+    return se_commit(se);
+}
+
+void se_ack(struct split_encoder *se, int ack_sid)
+{
+    int cur = atomic_load_explicit(&se->ack, memory_order_relaxed);
+    while (ack_sid > cur) {
+        if (atomic_compare_exchange_weak_explicit(&se->ack, &cur, ack_sid,
+                                                  memory_order_relaxed, memory_order_relaxed))
+            break;
+    }
+}
+
+struct encoder *se_encoder(struct split_encoder *se)
+{
+    return se->ec;
+}
+
+int se_sync(struct split_encoder *se)
+{
+    struct encoder *ec = se->ec;
+    // acquire: the payloads of the published slots are visible
+    int tail = atomic_load_explicit(&se->tail, memory_order_acquire);
+    while (ec->snum < tail) {
+        if (enqueue_packet_nocopy(ec, ec->snum, SE_SLOT(se, ec->snum)) < 0)
+            break;
+    }
+    // an acknowledgement never covers a packet not sent yet
+    int ack = atomic_load_explicit(&se->ack, memory_order_relaxed);
+    if (ack >= ec->nextsid)
+        ack = ec->nextsid - 1;
+    if (ack >= ec->headsid && ec->head != -1)
+        flush_acked_packets(ec, ack);
+    atomic_store_explicit(&se->sent, ec->nextsid, memory_order_relaxed);
+    return ec->snum - ec->nextsid;
+}
+
+struct packet *se_output_source(struct split_encoder *se)
+{
+    if (se_sync(se) == 0)
+        return NULL;
+    struct packet *pkt = output_source_packet(se->ec);
+    atomic_store_explicit(&se->sent, se->ec->nextsid, memory_order_relaxed);
+    return pkt;
+}
+
+struct packet *se_output_repair(struct split_encoder *se, int ew_width)
+{
+    se_sync(se);
+    if (se->ec->head == -1 || se->ec->nextsid <= se->ec->headsid)
+        return NULL;                // nothing unacknowledged
+    if (ew_width > 0)
+        return output_repair_packet_short(se->ec, ew_width);
+    return output_repair_packet(se->ec);
+}
+
+int se_published(struct split_encoder *se)
+{
+    return atomic_load_explicit(&se->tail, memory_order_relaxed);
+}
+
+int se_sent(struct split_encoder *se)
+{
+    return atomic_load_explicit(&se->sent, memory_order_relaxed);
+}
+
+int se_acked(struct split_encoder *se)
+{
+    return atomic_load_explicit(&se->ack, memory_order_relaxed);
+}
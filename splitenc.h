@@ -0,0 +1,67 @@
+#ifndef SPLITENC_H
+#define SPLITENC_H
+/*
+ * Split encoder for concurrent enqueue, output and acknowledgement
+ *
+ * An encoder's ring (head/tail, headsid/nextsid) is mutated by
+ * enqueue_packet(), output_*_packet() and flush_acked_packets() alike, so a
+ * plain encoder must be driven by a single thread. A split encoder divides the
+ * work among three roles, each of which may run on its own thread:
+ *  a) one producer fills source packets into a ring of capacity slots and
+ *     publishes them by advancing the ring's tail, see se_enqueue() and
+ *     se_reserve()/se_commit(). The ring also bounds the unacknowledged
+ *     packets: a slot is reused only once its packet was flushed, so the
+ *     producer gets -1 or NULL while capacity packets are unacknowledged
+ *  b) one sender owns the encoder. se_sync() borrows the newly published slots
+ *     into it (enqueue_packet_nocopy(), no copy) and flushes it up to the
+ *     latest acknowledgement; the flushed slots are handed back to the
+ *     producer by advancing the ring's head. se_output_source() and
+ *     se_output_repair() sync first. Anything else done with the encoder (wire
+ *     format, scheduler, serialization, next_packet() after se_sync()) is done
+ *     on the sender thread only
+ *  c) any number of feedback threads publish in-order acknowledgements with
+ *     se_ack(), which keeps the highest one. The encoder is not flushed there,
+ *     as it belongs to the sender: an acknowledgement takes effect at the next
+ *     se_sync(), so a sender with nothing to send should still call it for the
+ *     producer to get its slots back
+ * The roles only share the three indices, each written by one role and read
+ * with acquire/release ordering, and no lock is taken. The encoder must not be
+ * given a release callback of its own.
+ */
+#include "streamcodec.h"
+
+struct split_encoder;
+
+// capacity: slots of the producer ring, i.e., unacknowledged source packets,
+// rounded up to a power of 2. cp must outlive the split encoder; NULL on error
+struct split_encoder *se_create(struct parameters *cp, int capacity);
+void se_free(struct split_encoder *se);
+
+// producer
+// Copy a source packet of pktsize bytes into the ring and publish it. Returns
+// its source id, or -1 if the ring is full
+int se_enqueue(struct split_encoder *se, const GF_ELEMENT *syms);
+// Zero-copy variant: the slot of the next source packet to be filled in place,
+// NULL if the ring is full, then published by se_commit(), which returns its id
+GF_ELEMENT *se_reserve(struct split_encoder *se);
+int se_commit(struct split_encoder *se);
+
+// feedback
+// Publish an acknowledgement up to ack_sid, applied by the sender's next se_sync()
+void se_ack(struct split_encoder *se, int ack_sid);
+
+// sender
+struct encoder *se_encoder(struct split_encoder *se);
+// Take in the published source packets and the latest acknowledgement. Returns
+// the number of source packets waiting to be sent
+int se_sync(struct split_encoder *se);
+struct packet *se_output_source(struct split_encoder *se);
+// full repair packet if ew_width <= 0, otherwise over the last ew_width packets
+struct packet *se_output_repair(struct split_encoder *se, int ew_width);
+
+// any thread
+int se_published(struct split_encoder *se);     // source packets published by the producer
+int se_sent(struct split_encoder *se);          // ... sent by the sender, as of its last call
+int se_acked(struct split_encoder *se);         // highest acknowledgement, -1 if none
+
+#endif  // SPLITENC_H
@@ -0,0 +1,1249 @@
+/*
+ * Sliding-window streaming network code: encoder and decoder. See
+ * streamcodec.h.
+ */
+#include <time.h>
+#include <limits.h>
+#include "streamcodec.h"
+#include "wireformat.h"
+
+#define ENC_BLOCK   64              // source packets per block of coefficients generated on the stack
+#define DEC_DWMIN   64              // initial capacity of the decoding window, in rows
+
+// Statistics are written by the owning thread only, and may be read by any
+// other with get_*_stats(): a relaxed atomic load and store, which compiles to
+// a plain add, as no other thread writes them
+#define STAT_ADD(f, n)  __atomic_store_n(&(f), __atomic_load_n(&(f), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+#define STAT_MAX(f, v)  do { if ((v) > (f)) __atomic_store_n(&(f), (v), __ATOMIC_RELAXED); } while (0)
+#define STAT_GET(f)     __atomic_load_n(&(f), __ATOMIC_RELAXED)
+
+// The decoder context with the state that is not part of the API
+struct decoder_ctx {
+    struct decoder      dc;         // must be first
+    GF_ELEMENT          *psyms;     // payload of pbuf in copy mode
+    GF_ELEMENT          *pcoes;     // coefficients of pbuf, copied or regenerated
+    int                 pcap;       // bytes of pcoes
+    unsigned long long  *first;     // per row of the band, packets received when its source id
+                                    // entered the decoding window
+    unsigned long long  nrecv;      // packets received
+};
+#define DEC_CTX(dc)     ((struct decoder_ctx *) (dc))
+// scratch coefficient row of the band, holding the packet being eliminated
+#define SCRATCH_ROW(dc) ((dc)->coefs + (size_t) (dc)->dwcap * (dc)->cstride)
+
+static inline int get_coe(const GF_ELEMENT *coes, int i, int nb)
+{
+    return nb == 2 ? coes[2*i] | coes[2*i+1] << 8 : coes[i];
+}
+
+static inline void set_coe(GF_ELEMENT *coes, int i, int nb, int c)
+{
+    if (nb == 2) {
+        coes[2*i]   = c & 0xff;
+        coes[2*i+1] = c >> 8;
+    } else {
+        coes[i] = c;
+    }
+}
+
+static int stat_bin(unsigned long long v)
+{
+    int b = v == 0 ? 0 : 64 - __builtin_clzll(v);
+    return b < STATS_NBINS ? b : STATS_NBINS - 1;
+}
+
+/******************************************
+ * MT19937, see M. Matsumoto and T. Nishimura, "Mersenne twister: a
+ * 623-dimensionally equidistributed uniform pseudo-random number generator,"
+ * ACM TOMACS, 1998.
+ ******************************************/
+static void mt19937_seed(MT19937 *rng, unsigned long s)
+{
+    rng->mt[0] = s & 0xffffffffUL;
+    for (rng->mti=1; rng->mti<N; rng->mti++) {
+        rng->mt[rng->mti] = 1812433253UL * (rng->mt[rng->mti-1] ^ (rng->mt[rng->mti-1] >> 30)) + rng->mti;
+        rng->mt[rng->mti] &= 0xffffffffUL;
+    }
+}
+
+static unsigned long mt19937_next(MT19937 *rng)
+{
+    static const unsigned long mag01[2] = { 0x0UL, 0x9908b0dfUL };
+    unsigned long y;
+    if (rng->mti >= N) {
+        int kk;
+        for (kk=0; kk<N-397; kk++) {
+            y = (rng->mt[kk] & 0x80000000UL) | (rng->mt[kk+1] & 0x7fffffffUL);
+            rng->mt[kk] = rng->mt[kk+397] ^ (y >> 1) ^ mag01[y & 0x1UL];
+        }
+        for (; kk<N-1; kk++) {
+            y = (rng->mt[kk] & 0x80000000UL) | (rng->mt[kk+1] & 0x7fffffffUL);
+            rng->mt[kk] = rng->mt[kk+(397-N)] ^ (y >> 1) ^ mag01[y & 0x1UL];
+        }
+        y = (rng->mt[N-1] & 0x80000000UL) | (rng->mt[0] & 0x7fffffffUL);
+        rng->mt[N-1] = rng->mt[396] ^ (y >> 1) ^ mag01[y & 0x1UL];
+        rng->mti = 0;
+    }
+    y = rng->mt[rng->mti++];
+    y ^= (y >> 11);
+    y ^= (y << 7) & 0x9d2c5680UL;
+    y ^= (y << 15) & 0xefc60000UL;
+    y ^= (y >> 18);
+    return y & 0xffffffffUL;
+}
+
+static MT19937 *new_prng(struct parameters *cp)
+{
+    MT19937 *rng = malloc(sizeof(MT19937));
+    if (rng != NULL)
+        mt19937_seed(rng, cp->seed);
+    return rng;
+}
+
+/******************************************
+ * Encoder
+ ******************************************/
+static void update_indices(struct encoder *ec)
+{
+    int size = ec->nseg * ENC_SEGSIZE;
+    ec->head = ec->headsid <= ec->tailsid ? ec->headsid % size : -1;
+    ec->tail = ec->tailsid >= 0 ? ec->tailsid % size : -1;
+}
+
+// Double the segment directory until it has need entries, re-placing the
+// attached segments, i.e., those of the source ids from headsid to snum-1
+static int grow_directory(struct encoder *ec, int need)
+{
+    int nseg = ec->nseg;
+    while (nseg < need)
+        nseg *= 2;
+    SRC_SEG **dir = calloc(nseg, sizeof(SRC_SEG *));
+    if (dir == NULL)
+        return -1;
+    for (int k=ec->headsid/ENC_SEGSIZE; ec->snum>0 && k<=(ec->snum-1)/ENC_SEGSIZE; k++)
+        dir[k % nseg] = ec->srcseg[k % ec->nseg];
+    free(ec->srcseg);
+    ec->srcseg = dir;
+    ec->nseg = nseg;
+    update_indices(ec);
+    return 0;
+}
+
+// Attach a segment for the source ids from sid on, sid a multiple of ENC_SEGSIZE
+static int attach_segment(struct encoder *ec, int sid)
+{
+    int need = sid / ENC_SEGSIZE - ec->headsid / ENC_SEGSIZE + 1;
+    if (need > ec->nseg && grow_directory(ec, need) < 0)
+        return -1;
+    SRC_SEG *seg = ec->freeseg;
+    if (seg != NULL) {
+        ec->freeseg = seg->next;
+    } else {
+        if ((seg = calloc(1, sizeof(SRC_SEG))) == NULL)
+            return -1;
+        ec->bufsize += ENC_SEGSIZE;
+    }
+    seg->next = NULL;
+    ec->srcseg[(sid / ENC_SEGSIZE) % ec->nseg] = seg;
+    return 0;
+}
+
+// Detach segment k, whose source packets were all flushed
+static void release_segment(struct encoder *ec, int k)
+{
+    SRC_SEG *seg = ec->srcseg[k % ec->nseg];
+    ec->srcseg[k % ec->nseg] = NULL;
+    if (ec->bufsize / ENC_SEGSIZE <= ec->nreserve) {
+        seg->next = ec->freeseg;
+        ec->freeseg = seg;
+    } else {
+        free(seg->slab);
+        free(seg);
+        ec->bufsize -= ENC_SEGSIZE;
+    }
+}
+
+static int enqueue(struct encoder *ec, int sourceid, GF_ELEMENT *syms, int borrow)
+{
+    int pktsize = ec->cp->pktsize;
+    if (sourceid != ec->snum)
+        return -1;
+    if (sourceid % ENC_SEGSIZE == 0 && attach_segment(ec, sourceid) < 0)
+        return -1;
+    SRC_SEG *seg = ec->srcseg[(sourceid / ENC_SEGSIZE) % ec->nseg];
+    int i = sourceid % ENC_SEGSIZE;
+    if (borrow) {
+        seg->syms[i] = syms;
+    } else {
+        if (seg->slab == NULL && (seg->slab = malloc((size_t) ENC_SEGSIZE * pktsize)) == NULL)
+            return -1;
+        seg->syms[i] = seg->slab + (size_t) i * pktsize;
+        memcpy(seg->syms[i], syms, pktsize);
+    }
+    seg->borrowed[i] = borrow;
+    ec->tailsid = sourceid;
+    ec->snum++;
+    update_indices(ec);
+    STAT_MAX(ec->stats.buf_hwm, ec->tailsid - ec->headsid + 1);
+    TRACE(ec->trace, TRACE_ENQUEUE, sourceid, 0, 0);
+    return 0;
+}
+
+struct encoder *initialize_encoder(struct parameters *cp, unsigned char *buf, int nbytes)
+{
+    struct encoder *ec = calloc(1, sizeof(struct encoder));
+    if (ec == NULL)
+        return NULL;
+    ec->cp       = cp;
+    ec->head     = -1;
+    ec->tail     = -1;
+    ec->tailsid  = -1;
+    ec->nseg     = 1;
+    ec->nreserve = 1;
+    ec->srcseg   = calloc(ec->nseg, sizeof(SRC_SEG *));
+    ec->gk       = gf_select_kernel(cp->gfpower);
+    if (cp->coemode != COE_COUNTER)
+        ec->prng = new_prng(cp);
+    if (ec->srcseg == NULL || ec->gk == NULL || (cp->coemode != COE_COUNTER && ec->prng == NULL)) {
+        free_encoder(ec);
+        return NULL;
+    }
+    // buf holds the first source packets, the last one zero-padded
+    for (int off=0; buf!=NULL && off<nbytes; off+=cp->pktsize) {
+        int ret;
+        if (nbytes - off >= cp->pktsize) {
+            ret = enqueue_packet(ec, ec->snum, buf + off);
+        } else {
+            GF_ELEMENT *last = calloc(1, cp->pktsize);
+            if (last != NULL)
+                memcpy(last, buf + off, nbytes - off);
+            ret = last != NULL ? enqueue_packet(ec, ec->snum, last) : -1;
+            free(last);
+        }
+        if (ret < 0) {
+            free_encoder(ec);
+            return NULL;
+        }
+    }
+    return ec;
+}
+
+int reserve_encoder_buffer(struct encoder *ec, int npkts)
+{
+    // a window of npkts packets spans up to one more segment than it fills
+    int nreserve = ALIGN(npkts, ENC_SEGSIZE) + 1;
+    if (nreserve > ec->nseg && grow_directory(ec, nreserve) < 0)
+        return -1;
+    ec->nreserve = nreserve;
+    while (ec->bufsize / ENC_SEGSIZE < nreserve) {
+        SRC_SEG *seg = calloc(1, sizeof(SRC_SEG));
+        if (seg == NULL || (seg->slab = malloc((size_t) ENC_SEGSIZE * ec->cp->pktsize)) == NULL) {
+            free(seg);
+            return -1;
+        }
+        // fault the pages in now rather than on the enqueue path
+        memset(seg->slab, 0, (size_t) ENC_SEGSIZE * ec->cp->pktsize);
+        seg->next = ec->freeseg;
+        ec->freeseg = seg;
+        ec->bufsize += ENC_SEGSIZE;
+    }
+    return 0;
+}
+
+int enqueue_packet(struct encoder *ec, int sourceid, GF_ELEMENT *syms)
+{
+    return enqueue(ec, sourceid, syms, 0);
+}
+
+int enqueue_packet_nocopy(struct encoder *ec, int sourceid, GF_ELEMENT *syms)
+{
+    return enqueue(ec, sourceid, syms, 1);
+}
+
+void set_release_callback(struct encoder *ec, RELEASE_FN release, void *arg)
+{
+    ec->release     = release;
+    ec->release_arg = arg;
+}
+
+// Coefficients of repair packet repairid for the source ids in [win_s, win_e].
+// COE_MT19937 coefficients are the next ones of the encoder's stream
+static void encoder_coefs(struct encoder *ec, int repairid, int win_s, int win_e, GF_ELEMENT *coes)
+{
+    int gfpower = ec->cp->gfpower;
+    int nb = COEBYTES(gfpower);
+    if (ec->prng == NULL) {
+        coef_batch(ec->cp->seed, repairid, win_s, win_e, gfpower, coes);
+        return;
+    }
+    for (int i=0; i<=win_e-win_s; i++) {
+        unsigned long w = mt19937_next(ec->prng);
+        set_coe(coes, i, nb, gfpower == 1 ? (int) (w & 1) : gfpower > 8 ? 1 + w % 65535 : 1 + w % 255);
+    }
+}
+
+/*
+ * syms += the source packets in [win_s, win_e] weighted by the coefficients of
+ * repair packet repairid, which are generated in blocks of ENC_BLOCK on the
+ * stack and also stored to coes unless it is NULL
+ */
+static void encode_repair(struct encoder *ec, int repairid, int win_s, int win_e, GF_ELEMENT *coes, GF_ELEMENT *syms)
+{
+    int nb = COEBYTES(ec->cp->gfpower);
+    GF_ELEMENT blk[ENC_BLOCK * 2];
+    struct gf_op ops[ENC_BLOCK];
+    for (int s=win_s; s<=win_e; s+=ENC_BLOCK) {
+        int e = win_e - s >= ENC_BLOCK ? s + ENC_BLOCK - 1 : win_e;
+        encoder_coefs(ec, repairid, s, e, blk);
+        if (coes != NULL)
+            memcpy(coes + (size_t) (s - win_s) * nb, blk, (size_t) (e - s + 1) * nb);
+        int nops = 0;
+        for (int sid=s; sid<=e; sid++) {
+            int c = get_coe(blk, sid - s, nb);
+            if (c == 0)
+                continue;
+            ops[nops].dst = syms;
+            ops[nops].src = SRCPKT(ec, sid);
+            ops[nops].c   = c;
+            nops++;
+        }
+        gf_pool_madd(ec->pool, ec->gk, ops, nops, ec->cp->pktsize);
+        STAT_ADD(ec->stats.madd_bytes, (unsigned long long) nops * ec->cp->pktsize);
+    }
+}
+
+// Clip [*win_s, *win_e] to the EW; 0 if the result is empty
+static int clip_window(struct encoder *ec, int *win_s, int *win_e)
+{
+    if (*win_s < ec->headsid)
+        *win_s = ec->headsid;
+    if (*win_e > ec->nextsid - 1)
+        *win_e = ec->nextsid - 1;
+    return *win_s <= *win_e;
+}
+
+// Account for the repair packet pkt once it is encoded
+static void sent_repair(struct encoder *ec, const struct packet *pkt)
+{
+    ec->rcount++;
+    ec->count++;
+    STAT_ADD(ec->stats.nrepair, 1);
+    TRACE(ec->trace, TRACE_REPAIR, pkt->repairid, pkt->win_s, pkt->win_e);
+}
+
+// Repair packet of the next repair id over [win_s, win_e], with zeroed symbols
+static struct packet *new_repair(struct encoder *ec, int win_s, int win_e)
+{
+    struct packet *pkt = calloc(1, sizeof(struct packet));
+    if (pkt == NULL)
+        return NULL;
+    pkt->sourceid = -1;
+    pkt->repairid = ec->rcount;
+    pkt->win_s    = win_s;
+    pkt->win_e    = win_e;
+    pkt->coes     = malloc((size_t) (win_e - win_s + 1) * COEBYTES(ec->cp->gfpower));
+    pkt->syms     = calloc(1, ec->cp->pktsize);
+    if (pkt->coes == NULL || pkt->syms == NULL) {
+        free_packet(pkt);
+        return NULL;
+    }
+    return pkt;
+}
+
+static struct packet *repair_packet(struct encoder *ec, int win_s, int win_e)
+{
+    if (!clip_window(ec, &win_s, &win_e))
+        return NULL;
+    struct packet *pkt = new_repair(ec, win_s, win_e);
+    if (pkt == NULL)
+        return NULL;
+    encode_repair(ec, pkt->repairid, win_s, win_e, pkt->coes, pkt->syms);
+    sent_repair(ec, pkt);
+    return pkt;
+}
+
+struct packet *output_source_packet(struct encoder *ec)
+{
+    if (ec->nextsid > ec->tailsid)
+        return NULL;                // nothing waiting
+    struct packet *pkt = calloc(1, sizeof(struct packet));
+    if (pkt == NULL || (pkt->syms = malloc(ec->cp->pktsize)) == NULL) {
+        free(pkt);
+        return NULL;
+    }
+    pkt->sourceid = ec->nextsid;
+    pkt->repairid = -1;
+    pkt->win_s    = -1;
+    pkt->win_e    = -1;
+    memcpy(pkt->syms, SRCPKT(ec, pkt->sourceid), ec->cp->pktsize);
+    ec->nextsid++;
+    ec->count++;
+    STAT_ADD(ec->stats.nsource, 1);
+    TRACE(ec->trace, TRACE_SOURCE, pkt->sourceid, 0, 0);
+    return pkt;
+}
+
+struct packet *output_repair_packet(struct encoder *ec)
+{
+    return repair_packet(ec, ec->headsid, ec->nextsid - 1);
+}
+
+struct packet *output_repair_packet_short(struct encoder *ec, int ew_width)
+{
+    if (ew_width <= 0)
+        return output_repair_packet(ec);
+    return repair_packet(ec, ec->nextsid - ew_width, ec->nextsid - 1);
+}
+
+struct packet *output_repair_packet_range(struct encoder *ec, int win_s, int win_e)
+{
+    return repair_packet(ec, win_s, win_e);
+}
+
+int output_repair_packets(struct encoder *ec, int k, int ew_width, struct packet **pkts)
+{
+    int nb = COEBYTES(ec->cp->gfpower);
+    int win_e = ec->nextsid - 1;
+    int win_s = ew_width > 0 ? win_e - ew_width + 1 : ec->headsid;
+    if (k <= 0 || !clip_window(ec, &win_s, &win_e))
+        return 0;
+    int n = win_e - win_s + 1;
+    int *coefs = malloc(sizeof(int) * n * k);
+    GF_ELEMENT **dsts = malloc(sizeof(GF_ELEMENT *) * k);
+    const GF_ELEMENT **srcs = malloc(sizeof(GF_ELEMENT *) * n);
+    if (coefs == NULL || dsts == NULL || srcs == NULL) {
+        free(coefs);
+        free(dsts);
+        free(srcs);
+        return 0;
+    }
+    // the coefficients of each packet in turn, as k output_repair_packet*() calls draw them
+    int m;
+    unsigned long long nonzero = 0;
+    for (m=0; m<k; m++) {
+        struct packet *pkt = pkts[m] = new_repair(ec, win_s, win_e);
+        if (pkt == NULL)
+            break;
+        encoder_coefs(ec, pkt->repairid, win_s, win_e, pkt->coes);
+        for (int i=0; i<n; i++) {
+            coefs[m*n+i] = get_coe(pkt->coes, i, nb);
+            nonzero += coefs[m*n+i] != 0;
+        }
+        dsts[m] = pkt->syms;
+        sent_repair(ec, pkt);
+    }
+    for (int i=0; i<n; i++)
+        srcs[i] = SRCPKT(ec, win_s + i);
+    gf_pool_madd_multi(ec->pool, ec->gk, dsts, m, srcs, n, coefs, ec->cp->pktsize);
+    STAT_ADD(ec->stats.madd_bytes, nonzero * ec->cp->pktsize);
+    free(coefs);
+    free(dsts);
+    free(srcs);
+    return m;
+}
+
+void flush_acked_packets(struct encoder *ec, int ack_sid)
+{
+    // an acknowledgement never covers a packet not sent yet
+    if (ack_sid > ec->nextsid - 1)
+        ack_sid = ec->nextsid - 1;
+    for (int sid=ec->headsid; sid<=ack_sid; sid++) {
+        SRC_SEG *seg = ec->srcseg[(sid / ENC_SEGSIZE) % ec->nseg];
+        int i = sid % ENC_SEGSIZE;
+        if (seg->borrowed[i] && ec->release != NULL)
+            ec->release(sid, seg->syms[i], ec->release_arg);
+        seg->syms[i] = NULL;
+        seg->borrowed[i] = 0;
+        if (i == ENC_SEGSIZE - 1)
+            release_segment(ec, sid / ENC_SEGSIZE);
+    }
+    if (ack_sid >= ec->headsid) {
+        ec->headsid = ack_sid + 1;
+        update_indices(ec);
+    }
+    TRACE(ec->trace, TRACE_FLUSH, ack_sid, ec->headsid, 0);
+}
+
+void visualize_buffer(struct encoder *ec)
+{
+    printf("encoder: snum %d sent %d (%d repair) EW [%d, %d] waiting %d\n",
+           ec->snum, ec->count, ec->rcount, ec->headsid, ec->nextsid - 1, ec->tailsid - ec->nextsid + 1);
+    printf("buffer: %d segments allocated, %d directory entries, head %d tail %d\n",
+           ec->bufsize / ENC_SEGSIZE, ec->nseg, ec->head, ec->tail);
+    for (int k=0; k<ec->nseg; k++) {
+        SRC_SEG *seg = ec->srcseg[k];
+        if (seg == NULL)
+            continue;
+        int n = 0, nborrowed = 0;
+        for (int i=0; i<ENC_SEGSIZE; i++) {
+            n += seg->syms[i] != NULL;
+            nborrowed += seg->borrowed[i];
+        }
+        printf("  [%d] %d packets (%d borrowed)\n", k, n, nborrowed);
+    }
+}
+
+void free_packet(struct packet *pkt)
+{
+    if (pkt == NULL)
+        return;
+    free(pkt->coes);
+    free(pkt->syms);
+    free(pkt);
+}
+
+int serialized_size(struct encoder *ec, struct packet *pkt)
+{
+    if (ec->wireformat == WIRE_COMPACT)
+        return compact_size(ec->cp, pkt);
+    int ncoes = pkt->repairid >= 0 ? (pkt->win_e - pkt->win_s + 1) * COEBYTES(ec->cp->gfpower) : 0;
+    return 4 * sizeof(int) + ncoes + ec->cp->pktsize;
+}
+
+int serialize_packet_into(struct encoder *ec, struct packet *pkt, unsigned char *buf, int cap)
+{
+    if (pkt == NULL)
+        return -1;
+    if (ec->wireformat == WIRE_COMPACT)
+        return serialize_compact(ec->cp, pkt, buf, cap);
+    int n = serialized_size(ec, pkt);
+    if (n > cap)
+        return -1;
+    int hdr[4] = { pkt->sourceid, pkt->repairid, pkt->win_s, pkt->win_e };
+    int ncoes = n - (int) sizeof(hdr) - ec->cp->pktsize;
+    memcpy(buf, hdr, sizeof(hdr));
+    if (ncoes > 0)
+        memcpy(buf + sizeof(hdr), pkt->coes, ncoes);
+    memcpy(buf + sizeof(hdr) + ncoes, pkt->syms, ec->cp->pktsize);
+    return n;
+}
+
+unsigned char *serialize_packet(struct encoder *ec, struct packet *pkt)
+{
+    if (pkt == NULL)
+        return NULL;
+    int n = serialized_size(ec, pkt);
+    unsigned char *pktstr = malloc(n);
+    if (pktstr != NULL && serialize_packet_into(ec, pkt, pktstr, n) < 0) {
+        free(pktstr);
+        return NULL;
+    }
+    return pktstr;
+}
+
+void free_serialized_packet(unsigned char *pktstr)
+{
+    free(pktstr);
+}
+
+int output_source_packet_into(struct encoder *ec, unsigned char *buf, int cap)
+{
+    if (ec->nextsid > ec->tailsid)
+        return -1;
+    struct packet pkt = { ec->nextsid, -1, -1, -1, NULL, SRCPKT(ec, ec->nextsid) };
+    int n = serialize_packet_into(ec, &pkt, buf, cap);
+    if (n < 0)
+        return -1;
+    ec->nextsid++;
+    ec->count++;
+    STAT_ADD(ec->stats.nsource, 1);
+    TRACE(ec->trace, TRACE_SOURCE, pkt.sourceid, 0, 0);
+    return n;
+}
+
+// Serialize the header of a repair packet over [win_s, win_e] into buf and
+// encode its coefficients and symbols in place, after it
+static int repair_packet_into(struct encoder *ec, int win_s, int win_e, unsigned char *buf, int cap)
+{
+    if (!clip_window(ec, &win_s, &win_e))
+        return -1;
+    struct packet pkt = { -1, ec->rcount, win_s, win_e, NULL, NULL };
+    int n = serialized_size(ec, &pkt);
+    if (n > cap)
+        return -1;
+    int hlen;
+    if (ec->wireformat == WIRE_COMPACT) {
+        hlen = compact_header(ec->cp, &pkt, buf);
+        if (buf[4] & WIRE_F_COES)
+            pkt.coes = buf + hlen;
+    } else {
+        int hdr[4] = { pkt.sourceid, pkt.repairid, pkt.win_s, pkt.win_e };
+        memcpy(buf, hdr, sizeof(hdr));
+        hlen = sizeof(hdr);
+        pkt.coes = buf + hlen;
+    }
+    pkt.syms = buf + n - ec->cp->pktsize;
+    memset(pkt.syms, 0, ec->cp->pktsize);
+    encode_repair(ec, pkt.repairid, win_s, win_e, pkt.coes, pkt.syms);
+    sent_repair(ec, &pkt);
+    return n;
+}
+
+int output_repair_packet_into(struct encoder *ec, unsigned char *buf, int cap)
+{
+    return repair_packet_into(ec, ec->headsid, ec->nextsid - 1, buf, cap);
+}
+
+int output_repair_packet_short_into(struct encoder *ec, int ew_width, unsigned char *buf, int cap)
+{
+    if (ew_width <= 0)
+        return output_repair_packet_into(ec, buf, cap);
+    return repair_packet_into(ec, ec->nextsid - ew_width, ec->nextsid - 1, buf, cap);
+}
+
+void free_encoder(struct encoder *ec)
+{
+    if (ec == NULL)
+        return;
+    if (ec->srcseg != NULL) {
+        // hand the borrowed packets back, then free the attached segments
+        for (int sid=ec->headsid; sid<=ec->tailsid; sid++) {
+            SRC_SEG *seg = ec->srcseg[(sid / ENC_SEGSIZE) % ec->nseg];
+            if (seg->borrowed[sid % ENC_SEGSIZE] && ec->release != NULL)
+                ec->release(sid, seg->syms[sid % ENC_SEGSIZE], ec->release_arg);
+        }
+        for (int k=0; k<ec->nseg; k++) {
+            if (ec->srcseg[k] != NULL) {
+                free(ec->srcseg[k]->slab);
+                free(ec->srcseg[k]);
+            }
+        }
+        free(ec->srcseg);
+    }
+    while (ec->freeseg != NULL) {
+        SRC_SEG *seg = ec->freeseg;
+        ec->freeseg = seg->next;
+        free(seg->slab);
+        free(seg);
+    }
+    free(ec->prng);
+    free(ec);
+}
+
+void set_wire_format(struct encoder *ec, int format)
+{
+    ec->wireformat = format;
+}
+
+void get_encoder_stats(struct encoder *ec, struct encoder_stats *st)
+{
+    st->nsource    = STAT_GET(ec->stats.nsource);
+    st->nrepair    = STAT_GET(ec->stats.nrepair);
+    st->madd_bytes = STAT_GET(ec->stats.madd_bytes);
+    st->buf_hwm    = STAT_GET(ec->stats.buf_hwm);
+}
+
+void set_encoder_trace(struct encoder *ec, struct tracer *tr)
+{
+    if (tr != NULL) {
+        tr->gfpower = ec->cp->gfpower;
+        tr->pktsize = ec->cp->pktsize;
+        tr->seed    = ec->cp->seed;
+        tr->coemode = ec->cp->coemode;
+    }
+    ec->trace = tr;
+}
+
+void set_encoder_pool(struct encoder *ec, struct gf_pool *pool)
+{
+    ec->pool = pool;
+}
+
+/******************************************
+ * Decoder
+ ******************************************/
+struct decoder *initialize_decoder(struct parameters *cp)
+{
+    return initialize_decoder_at(cp, -1);
+}
+
+struct decoder *initialize_decoder_at(struct parameters *cp, int inorder)
+{
+    struct decoder_ctx *ctx = calloc(1, sizeof(struct decoder_ctx));
+    if (ctx == NULL)
+        return NULL;
+    struct decoder *dc = &ctx->dc;
+    dc->cp        = cp;
+    dc->inorder   = inorder;
+    dc->win_s     = inorder + 1;
+    dc->win_e     = inorder;
+    dc->prev_rep  = -1;
+    dc->recvsize  = DEC_ALLOC;
+    dc->recovered = calloc(dc->recvsize, sizeof(GF_ELEMENT *));
+    dc->pbuf      = calloc(1, sizeof(struct packet));
+    dc->gk        = gf_select_kernel(cp->gfpower);
+    ctx->psyms    = malloc(cp->pktsize);
+    if (dc->recovered == NULL || dc->pbuf == NULL || dc->gk == NULL || ctx->psyms == NULL) {
+        free_decoder(dc);
+        return NULL;
+    }
+    dc->pbuf->syms = ctx->psyms;
+    return dc;
+}
+
+static void replay_log(struct decoder *dc);
+
+int resize_recovered_buffer(struct decoder *dc, int nslots)
+{
+    if (nslots <= 0)
+        return -1;
+    GF_ELEMENT **recovered = calloc(nslots, sizeof(GF_ELEMENT *));
+    if (recovered == NULL)
+        return -1;
+    // deferred operations may read delivered packets about to be freed
+    replay_log(dc);
+    // the last min(nslots, recvsize) delivered packets are kept
+    int keep = nslots < dc->recvsize ? nslots : dc->recvsize;
+    for (int sid=dc->inorder-keep+1; sid<=dc->inorder; sid++) {
+        if (sid < 0)
+            continue;
+        recovered[sid % nslots] = RECOVERED(dc, sid);
+        RECOVERED(dc, sid) = NULL;
+    }
+    for (int i=0; i<dc->recvsize; i++)
+        free(dc->recovered[i]);
+    free(dc->recovered);
+    dc->recovered = recovered;
+    dc->recvsize  = nslots;
+    return 0;
+}
+
+void set_delivery_callback(struct decoder *dc, DELIVER_FN deliver, void *arg)
+{
+    dc->deliver     = deliver;
+    dc->deliver_arg = arg;
+}
+
+void get_decoder_stats(struct decoder *dc, struct decoder_stats *st)
+{
+    st->nsource       = STAT_GET(dc->stats.nsource);
+    st->nrepair       = STAT_GET(dc->stats.nrepair);
+    st->innovative    = STAT_GET(dc->stats.innovative);
+    st->noninnovative = STAT_GET(dc->stats.noninnovative);
+    st->redundant     = STAT_GET(dc->stats.redundant);
+    st->madd_bytes    = STAT_GET(dc->stats.madd_bytes);
+    st->skipped_bytes = STAT_GET(dc->stats.skipped_bytes);
+    st->elim_ns       = STAT_GET(dc->stats.elim_ns);
+    for (int b=0; b<STATS_NBINS; b++) {
+        st->dw_hist[b]    = STAT_GET(dc->stats.dw_hist[b]);
+        st->delay_hist[b] = STAT_GET(dc->stats.delay_hist[b]);
+    }
+    st->buf_hwm = STAT_GET(dc->stats.buf_hwm);
+}
+
+void set_decoder_trace(struct decoder *dc, struct tracer *tr)
+{
+    if (tr != NULL) {
+        tr->gfpower = dc->cp->gfpower;
+        tr->pktsize = dc->cp->pktsize;
+        tr->seed    = dc->cp->seed;
+        tr->coemode = dc->cp->coemode;
+    }
+    dc->trace = tr;
+    // the state the trace starts from, where a replay can begin if idle
+    TRACE(dc->trace, TRACE_INORDER, dc->inorder, dc->inorder, !dc->active);
+}
+
+void set_decoder_pool(struct decoder *dc, struct gf_pool *pool)
+{
+    dc->pool = pool;
+}
+
+// Apply the pending payload row operations
+static void replay_log(struct decoder *dc)
+{
+    if (dc->nlog == 0)
+        return;
+    gf_pool_madd(dc->pool, dc->gk, dc->oplog, dc->nlog, dc->cp->pktsize);
+    STAT_ADD(dc->stats.madd_bytes, (unsigned long long) dc->nlog * dc->cp->pktsize);
+    dc->nlog = 0;
+}
+
+// Make room in the log for n more operations
+static int reserve_log(struct decoder *dc, int n)
+{
+    if (dc->nlog + n <= dc->logcap)
+        return 0;
+    int logcap = dc->logcap > 0 ? dc->logcap : 64;
+    while (logcap < dc->nlog + n)
+        logcap *= 2;
+    struct gf_op *oplog = realloc(dc->oplog, sizeof(struct gf_op) * logcap);
+    if (oplog == NULL)
+        return -1;
+    dc->oplog  = oplog;
+    dc->logcap = logcap;
+    return 0;
+}
+
+static int log_op(struct decoder *dc, GF_ELEMENT *dst, const GF_ELEMENT *src, int c)
+{
+    if (reserve_log(dc, 1) < 0)
+        return -1;
+    dc->oplog[dc->nlog].dst = dst;
+    dc->oplog[dc->nlog].src = src;
+    dc->oplog[dc->nlog].c   = c;
+    dc->nlog++;
+    return 0;
+}
+
+static void row_madd(struct decoder *dc, GF_ELEMENT *dst, const GF_ELEMENT *src, int c)
+{
+    struct gf_op op = { dst, src, c };
+    gf_pool_madd(dc->pool, dc->gk, &op, 1, dc->cp->pktsize);
+    STAT_ADD(dc->stats.madd_bytes, dc->cp->pktsize);
+}
+
+void set_decoder_mode(struct decoder *dc, int mode)
+{
+    if (mode != DEC_DEFERRED)
+        replay_log(dc);
+    dc->mode = mode;
+}
+
+/*
+ * Grow the band to hold a decoding window of width rows, plus the scratch
+ * coefficient row, re-placing the rows of the current window
+ */
+static int reserve_window(struct decoder *dc, int width)
+{
+    struct decoder_ctx *ctx = DEC_CTX(dc);
+    int nb = COEBYTES(dc->cp->gfpower);
+    int pktsize = dc->cp->pktsize;
+    if (width <= dc->dwcap)
+        return 0;
+    int dwcap = dc->dwcap > 0 ? dc->dwcap : DEC_DWMIN;
+    while (dwcap < width)
+        dwcap *= 2;
+    int cstride = ALIGN(dwcap * nb, CACHELINE) * CACHELINE;
+    int mstride = ALIGN(pktsize, CACHELINE) * CACHELINE;
+    int *rlen = calloc(dwcap, sizeof(int));
+    unsigned long long *first = calloc(dwcap, sizeof(unsigned long long));
+    GF_ELEMENT *coefs = aligned_alloc(CACHELINE, (size_t) (dwcap + 1) * cstride);
+    GF_ELEMENT *msgs = aligned_alloc(CACHELINE, (size_t) dwcap * mstride);
+    if (rlen == NULL || first == NULL || coefs == NULL || msgs == NULL) {
+        free(rlen);
+        free(first);
+        free(coefs);
+        free(msgs);
+        return -1;
+    }
+    replay_log(dc);                 // the log points into the old slabs
+    for (int i=dc->win_s; i<=dc->win_e; i++) {
+        int r = i % dwcap;
+        rlen[r]  = dc->rlen[i % dc->dwcap];
+        first[r] = ctx->first[i % dc->dwcap];
+        if (rlen[r] == 0)
+            continue;
+        memcpy(coefs + (size_t) r * cstride, DEC_ROW(dc, i), (size_t) rlen[r] * nb);
+        memcpy(msgs + (size_t) r * mstride, DEC_MSG(dc, i), pktsize);
+    }
+    free(dc->rlen);
+    free(ctx->first);
+    free(dc->coefs);
+    free(dc->msgs);
+    dc->rlen    = rlen;
+    ctx->first  = first;
+    dc->coefs   = coefs;
+    dc->msgs    = msgs;
+    dc->dwcap   = dwcap;
+    dc->cstride = cstride;
+    dc->mstride = mstride;
+    return 0;
+}
+
+// Extend the decoding window to end at win_e
+static int extend_window(struct decoder *dc, int win_e)
+{
+    struct decoder_ctx *ctx = DEC_CTX(dc);
+    if (win_e <= dc->win_e)
+        return 0;
+    // bounded before reserving, so that the capacity cannot overflow
+    if (win_e - dc->win_s >= DEC_DWMAX)
+        return -1;
+    if (reserve_window(dc, win_e - dc->win_s + 1) < 0)
+        return -1;
+    for (int i=dc->win_e+1; i<=win_e; i++) {
+        dc->rlen[i % dc->dwcap] = 0;
+        ctx->first[i % dc->dwcap] = ctx->nrecv;
+    }
+    dc->win_e  = win_e;
+    dc->active = 1;
+    return 0;
+}
+
+int activate_decoder(struct decoder *dc, struct packet *pkt)
+{
+    return extend_window(dc, pkt->repairid >= 0 ? pkt->win_e : pkt->sourceid);
+}
+
+// Drop the rows of the decoding window and free the band
+int deactivate_decoder(struct decoder *dc)
+{
+    struct decoder_ctx *ctx = DEC_CTX(dc);
+    int dropped = dc->dof;
+    STAT_ADD(dc->stats.skipped_bytes, (unsigned long long) dc->nlog * dc->cp->pktsize);
+    dc->nlog = 0;
+    free(dc->rlen);
+    free(ctx->first);
+    free(dc->coefs);
+    free(dc->msgs);
+    dc->rlen    = NULL;
+    ctx->first  = NULL;
+    dc->coefs   = NULL;
+    dc->msgs    = NULL;
+    dc->dwcap   = 0;
+    dc->cstride = 0;
+    dc->mstride = 0;
+    dc->dof     = 0;
+    dc->active  = 0;
+    dc->win_s   = dc->inorder + 1;
+    dc->win_e   = dc->inorder;
+    return dropped;
+}
+
+// Make sure the slots of the recovered ring of [s, e] are allocated
+static int reserve_recovered(struct decoder *dc, int s, int e)
+{
+    for (int sid=s; sid<=e && sid<s+dc->recvsize; sid++) {
+        if (RECOVERED(dc, sid) == NULL && (RECOVERED(dc, sid) = malloc(dc->cp->pktsize)) == NULL)
+            return -1;
+    }
+    return 0;
+}
+
+// Deliver sid after the previous in-order packet
+static void deliver_one(struct decoder *dc, int sid, const GF_ELEMENT *syms, unsigned long long delay)
+{
+    memcpy(RECOVERED(dc, sid), syms, dc->cp->pktsize);
+    dc->inorder = sid;
+    dc->win_s   = sid + 1;
+    if (dc->win_e < sid)
+        dc->win_e = sid;
+    STAT_ADD(dc->stats.delay_hist[stat_bin(delay)], 1);
+    if (dc->deliver != NULL)
+        dc->deliver(dc, sid, RECOVERED(dc, sid), dc->deliver_arg);
+}
+
+/*
+ * Back-substitute rows [s, e] of the decoding window, which cover no column
+ * beyond e, and deliver them
+ */
+static int deliver_rows(struct decoder *dc, int s, int e)
+{
+    struct decoder_ctx *ctx = DEC_CTX(dc);
+    int nb = COEBYTES(dc->cp->gfpower);
+    if (reserve_recovered(dc, s, e) < 0)
+        return -1;
+    replay_log(dc);
+    // the operations of the block run in one batch, from the last row up
+    for (int i=e; i>=s; i--) {
+        GF_ELEMENT *row = DEC_ROW(dc, i);
+        for (int j=1; j<dc->rlen[i % dc->dwcap]; j++) {
+            int c = get_coe(row, j, nb);
+            if (c == 0 || log_op(dc, DEC_MSG(dc, i), DEC_MSG(dc, i + j), c) == 0)
+                continue;
+            replay_log(dc);
+            row_madd(dc, DEC_MSG(dc, i), DEC_MSG(dc, i + j), c);
+        }
+    }
+    replay_log(dc);
+    int prev = dc->inorder;
+    for (int i=s; i<=e; i++) {
+        dc->rlen[i % dc->dwcap] = 0;
+        dc->dof--;
+        deliver_one(dc, i, DEC_MSG(dc, i), ctx->nrecv - ctx->first[i % dc->dwcap]);
+    }
+    if (dc->win_s > dc->win_e)
+        dc->active = 0;
+    TRACE(dc->trace, TRACE_INORDER, e, prev, !dc->active);
+    return 0;
+}
+
+// Deliver the rows from win_s on that can be back-substituted, i.e., blocks of
+// consecutive rows whose coefficients end within the block
+static void deliver_ready(struct decoder *dc)
+{
+    int s = dc->inorder + 1, ext = dc->inorder;
+    for (int i=s; i<=dc->win_e; i++) {
+        int len = dc->rlen[i % dc->dwcap];
+        if (len == 0)
+            break;
+        if (i + len - 1 > ext)
+            ext = i + len - 1;
+        if (ext > i)
+            continue;
+        if (deliver_rows(dc, s, i) < 0)
+            break;
+        s = i + 1;
+    }
+}
+
+/*
+ * Eliminate a packet with coefficients coes over [win_s, win_e] (a source
+ * packet if coes is NULL, win_s = win_e = sourceid) and payload syms into the
+ * decoding window. The delivered packets it covers are subtracted, then its
+ * coefficient row is reduced by the rows of the window in increasing column
+ * order until it reaches a column without a row, which becomes its pivot.
+ * The payload row operations are logged for the row it is stored to, and
+ * applied in one batch at the end (DEC_EAGER) or when the row is delivered.
+ * Returns 1 if it was innovative, 0 if it was reduced to zero, -1 if it covers
+ * a delivered packet no longer held or memory ran out.
+ */
+static int eliminate_packet(struct decoder *dc, const GF_ELEMENT *coes, int win_s, int win_e, const GF_ELEMENT *syms)
+{
+    const struct gf_kernel *gk = dc->gk;
+    int nb = COEBYTES(dc->cp->gfpower);
+    int pktsize = dc->cp->pktsize;
+    int s = dc->inorder + 1;
+    for (int i=win_s; i<s; i++) {
+        if (get_coe(coes, i - win_s, nb) != 0 && (i <= dc->inorder - dc->recvsize || RECOVERED(dc, i) == NULL))
+            return -1;
+    }
+    if (extend_window(dc, win_e) < 0)
+        return -1;
+    GF_ELEMENT *row = SCRATCH_ROW(dc);
+    int c0 = win_s > s ? win_s : s;
+    memset(row, 0, (size_t) (dc->win_e - s + 1) * nb);
+    if (coes != NULL)
+        memcpy(row + (size_t) (c0 - s) * nb, coes + (size_t) (c0 - win_s) * nb, (size_t) (win_e - c0 + 1) * nb);
+    else
+        set_coe(row, c0 - s, nb, 1);
+    int start = dc->nlog;
+    for (int i=win_s; i<s; i++) {
+        int c = get_coe(coes, i - win_s, nb);
+        if (c != 0 && log_op(dc, NULL, RECOVERED(dc, i), c) < 0)
+            goto nomem;
+    }
+    int last = win_e, piv = -1;
+    for (int i=s; i<=last; i++) {
+        int c = get_coe(row, i - s, nb);
+        if (c == 0)
+            continue;
+        int len = dc->rlen[i % dc->dwcap];
+        if (len == 0) {
+            piv = i;
+            break;
+        }
+        gk->madd(row + (size_t) (i - s) * nb, DEC_ROW(dc, i), c, len * nb);
+        if (i + len - 1 > last)
+            last = i + len - 1;
+        if (log_op(dc, NULL, DEC_MSG(dc, i), c) < 0)
+            goto nomem;
+    }
+    if (piv < 0) {
+        // the operations and the payload of a non-innovative packet are dropped unapplied
+        STAT_ADD(dc->stats.skipped_bytes, (unsigned long long) (dc->nlog - start + 1) * pktsize);
+        dc->nlog = start;
+        return 0;
+    }
+    if (reserve_log(dc, 1) < 0)
+        goto nomem;
+    while (get_coe(row, last - s, nb) == 0)
+        last--;
+    int len = last - piv + 1;
+    int inv = gk->div(1, get_coe(row, piv - s, nb));
+    GF_ELEMENT *prow = DEC_ROW(dc, piv);
+    GF_ELEMENT *pmsg = DEC_MSG(dc, piv);
+    if (inv == 1) {
+        memcpy(prow, row + (size_t) (piv - s) * nb, (size_t) len * nb);
+    } else {
+        memset(prow, 0, (size_t) len * nb);
+        gk->madd(prow, row + (size_t) (piv - s) * nb, inv, len * nb);
+    }
+    dc->rlen[piv % dc->dwcap] = len;
+    // the payload is scaled by inv in place: x + (inv+1)x = inv*x
+    memcpy(pmsg, syms, pktsize);
+    for (int j=start; j<dc->nlog; j++)
+        dc->oplog[j].dst = pmsg;
+    if (inv != 1)
+        log_op(dc, pmsg, pmsg, inv ^ 1);
+    if (dc->mode == DEC_EAGER)
+        replay_log(dc);
+    dc->dof++;
+    STAT_MAX(dc->stats.buf_hwm, dc->dof);
+    TRACE(dc->trace, TRACE_PIVOT, piv, len, dc->win_e - dc->win_s + 1);
+    return 1;
+
+nomem:
+    dc->nlog = start;
+    return -1;
+}
+
+// Coefficients of a COE_COUNTER packet whose coefficients were elided
+static const GF_ELEMENT *regenerate_coefs(struct decoder *dc, const struct packet *pkt)
+{
+    struct decoder_ctx *ctx = DEC_CTX(dc);
+    int ncoes = (pkt->win_e - pkt->win_s + 1) * COEBYTES(dc->cp->gfpower);
+    if (dc->cp->coemode != COE_COUNTER)
+        return NULL;
+    if (ncoes > ctx->pcap) {
+        GF_ELEMENT *pcoes = realloc(ctx->pcoes, ncoes);
+        if (pcoes == NULL)
+            return NULL;
+        ctx->pcoes = pcoes;
+        ctx->pcap  = ncoes;
+    }
+    coef_batch(dc->cp->seed, pkt->repairid, pkt->win_s, pkt->win_e, dc->cp->gfpower, ctx->pcoes);
+    return ctx->pcoes;
+}
+
+int process_packet(struct decoder *dc, struct packet *pkt)
+{
+    int ret;
+    if (pkt->repairid < 0) {
+        if (pkt->sourceid <= dc->inorder)
+            return 0;
+        ret = eliminate_packet(dc, NULL, pkt->sourceid, pkt->sourceid, pkt->syms);
+    } else {
+        if (pkt->win_s < 0 || pkt->win_e < pkt->win_s || pkt->win_e - pkt->win_s >= DEC_DWMAX)
+            return -1;
+        if (pkt->win_e <= dc->inorder)
+            return 0;
+        const GF_ELEMENT *coes = pkt->coes != NULL ? pkt->coes : regenerate_coefs(dc, pkt);
+        if (coes == NULL)
+            return -1;
+        ret = eliminate_packet(dc, coes, pkt->win_s, pkt->win_e, pkt->syms);
+    }
+    if (ret > 0)
+        deliver_ready(dc);
+    return ret;
+}
+
+/*
+ * Receive a source or repair packet. Returns 1 if it was innovative (a new
+ * source packet, or a repair packet that increased the rank of the decoding
+ * window), 0 if it was not, and -1 if it could not be used.
+ */
+int receive_packet(struct decoder *dc, struct packet *pkt)
+{
+    struct decoder_ctx *ctx = DEC_CTX(dc);
+    struct timespec t0, t1;
+    ctx->nrecv++;
+    if (pkt->repairid < 0) {
+        STAT_ADD(dc->stats.nsource, 1);
+        if (pkt->sourceid <= dc->inorder) {
+            STAT_ADD(dc->stats.redundant, 1);
+            return 0;
+        }
+        // the next in-order packet without a decoding window is delivered right away
+        if (!dc->active && pkt->sourceid == dc->inorder + 1) {
+            if (reserve_recovered(dc, pkt->sourceid, pkt->sourceid) < 0)
+                return -1;
+            int prev = dc->inorder;
+            deliver_one(dc, pkt->sourceid, pkt->syms, 0);
+            TRACE(dc->trace, TRACE_INORDER, dc->inorder, prev, 1);
+            return 1;
+        }
+    } else {
+        STAT_ADD(dc->stats.nrepair, 1);
+        STAT_ADD(dc->stats.dw_hist[stat_bin(dc->active ? dc->win_e - dc->win_s + 1 : 0)], 1);
+        dc->prev_rep = pkt->repairid;
+        if (pkt->win_e <= dc->inorder && pkt->win_e >= pkt->win_s) {
+            STAT_ADD(dc->stats.redundant, 1);
+            return 0;
+        }
+    }
+    // two clock reads per packet would cost as much as eliminating a short one
+    int timed = (ctx->nrecv & (STATS_TIME_EVERY - 1)) == 0;
+    if (timed)
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+    int ret = process_packet(dc, pkt);
+    if (timed) {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        STAT_ADD(dc->stats.elim_ns, ((t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec) * STATS_TIME_EVERY);
+    }
+    if (ret == 1 && pkt->repairid >= 0)
+        STAT_ADD(dc->stats.innovative, 1);
+    else if (ret == 0 && pkt->repairid >= 0)
+        STAT_ADD(dc->stats.noninnovative, 1);
+    else if (ret == 0)
+        STAT_ADD(dc->stats.redundant, 1);
+    return ret;
+}
+
+// Parse a packet of at most cap bytes, copying its coefficients and symbols
+// unless view
+static struct packet *deserialize(struct decoder *dc, unsigned char *pktstr, int cap, int view)
+{
+    struct decoder_ctx *ctx = DEC_CTX(dc);
+    struct packet *pkt = dc->pbuf;
+    int nb = COEBYTES(dc->cp->gfpower);
+    int pktsize = dc->cp->pktsize;
+    const GF_ELEMENT *coes = NULL, *syms;
+    int len = wire_length(dc->cp, pktstr, cap);
+    if (len < 0)
+        return NULL;
+    if (wire_format(pktstr) == WIRE_LEGACY) {
+        int hdr[4];
+        memcpy(hdr, pktstr, sizeof(hdr));
+        pkt->sourceid = hdr[0];
+        pkt->repairid = hdr[1];
+        pkt->win_s    = hdr[1] >= 0 ? hdr[2] : -1;
+        pkt->win_e    = hdr[1] >= 0 ? hdr[3] : -1;
+        coes = pkt->repairid >= 0 ? pktstr + sizeof(hdr) : NULL;
+        syms = pktstr + len - pktsize;
+    } else {
+        if (deserialize_compact(dc->cp, pktstr, len, pkt) < 0)
+            return NULL;
+        coes = pkt->coes;
+        syms = pkt->syms;
+    }
+    pkt->coes = NULL;
+    if (pkt->repairid >= 0) {
+        if (coes == NULL) {
+            if ((coes = regenerate_coefs(dc, pkt)) == NULL)
+                return NULL;
+        } else if (!view) {
+            int ncoes = (pkt->win_e - pkt->win_s + 1) * nb;
+            if (ncoes > ctx->pcap) {
+                GF_ELEMENT *pcoes = realloc(ctx->pcoes, ncoes);
+                if (pcoes == NULL)
+                    return NULL;
+                ctx->pcoes = pcoes;
+                ctx->pcap  = ncoes;
+            }
+            memcpy(ctx->pcoes, coes, ncoes);
+            coes = ctx->pcoes;
+        }
+        pkt->coes = (GF_ELEMENT *) coes;
+    }
+    if (!view) {
+        memcpy(ctx->psyms, syms, pktsize);
+        syms = ctx->psyms;
+    }
+    pkt->syms = (GF_ELEMENT *) syms;
+    if (dc->trace != NULL)
+        trace_packet(dc->trace, TRACE_RECEIVE, pkt->sourceid, pkt->repairid, 0, pktstr, len);
+    return pkt;
+}
+
+struct packet *deserialize_packet(struct decoder *dc, unsigned char *pktstr)
+{
+    return deserialize(dc, pktstr, INT_MAX, 0);
+}
+
+struct packet *deserialize_packet_view(struct decoder *dc, unsigned char *pktstr)
+{
+    return deserialize(dc, pktstr, INT_MAX, 1);
+}
+
+void free_decoder(struct decoder *dc)
+{
+    struct decoder_ctx *ctx = DEC_CTX(dc);
+    if (dc == NULL)
+        return;
+    if (dc->recovered != NULL) {
+        for (int i=0; i<dc->recvsize; i++)
+            free(dc->recovered[i]);
+        free(dc->recovered);
+    }
+    free(dc->rlen);
+    free(ctx->first);
+    free(dc->coefs);
+    free(dc->msgs);
+    free(dc->oplog);
+    free(dc->pbuf);
+    free(ctx->psyms);
+    free(ctx->pcoes);
+    free(ctx);
+}
@@ -1,105 +1,284 @@
-#ifndef STREAMCODEC_H
-#define STREAMCODEC_H
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#ifdef DEBUG
-# define DEBUG_PRINT(x) printf x
-#else
-# define DEBUG_PRINT(x) do {} while (0)
-#endif
-
-#ifndef GALOIS
-#define GALOIS
-typedef unsigned char GF_ELEMENT;
-#endif
-#define N       624                 // used by mt-19937 PRNG
-#define EWIN    100                 // "encoding window" for seeding PRNG (for coefficient synchronization)
-#define DEC_ALLOC   10000           // buffer space allocated at decoder for recovered packets
-
-#define ALIGN(a, b) ((a) % (b) == 0 ? (a)/(b) : (a)/(b) + 1)
-
-typedef struct mt19937_rng {
-    unsigned long   mt[N];          // the array for the state vector
-    int             mti;            // initialize to mti==N+1, means mt[N] is not initialized
-} MT19937;
-
-struct parameters {
-    int     gfpower;                // n of GF(2^n)
-    int     pktsize;                // number of bytes per packet
-    double  repfreq;                // frequency (probability) of sending repair packet
-    int     seed;                   // seed for random coding coefficients
-};
-
-struct packet {
-    int     sourceid;               // source packet id
-    int     repairid;               // repair packet id, -1 if it's a source packet
-    int     win_s;                  // start of repair encoding window
-    int     win_e;                  // end of repair encoding window
-    GF_ELEMENT  *coes;              // (win_e-win_s+1) encoding coefficients 
-    GF_ELEMENT  *syms;              // source or coded symbols
-};
-
-struct encoder {
-    struct parameters *cp;          // code parameter
-    int         count;              // total number of sent packets
-    int         nextsid;            // id of source packet next to send
-    int         rcount;             // number of sent repair packets 
-    // A ring buffer
-    // a) Buffer size is doubled (initial ENC_ALLOC) when buffer is full
-    // b) Acknowledged packets are flushed from the buffer
-    // c) Encoding window [headsid, nextsid-1] (watch for wrap around of their location)
-    int         bufsize;            // current buffer size
-    int         snum;               // number of queued source packets (including flushed)
-    int         head;               // head index of buffered source packets 
-    int         tail;               // tail index of bufferred source packets
-    int         headsid;            // source packet id of head
-    int         tailsid;            // source packet id of tail
-    GF_ELEMENT  **srcpkt;           // available source packets for encoding
-    // A mt19973 PRNG for synchronizing encoding coefficients
-    MT19937     prng;
-};
-
-typedef struct row_vector {
-    int         len;
-    GF_ELEMENT  *elem;
-} ROW_VEC;
-
-struct decoder {
-    struct parameters *cp;           // code parameter    
-    struct packet *pbuf;            // a single packet buffer for deserialize
-    int         active;             // whether the decoder is active
-    int         inorder;            // index of the last in-order received packet
-    int         win_s;              // start of decoding window
-    int         win_e;              // end of decoding window
-    int         dof;                // received DoF in the decoding window
-    ROW_VEC     **row;
-    GF_ELEMENT  **message;
-    GF_ELEMENT  **recovered;
-    int         prev_rep;           // id of the previous received repair packet
-    MT19937     prng;
-};
-
-// encoder functions
-struct encoder *initialize_encoder(struct parameters *cp, unsigned char *buf, int nbytes);
-int enqueue_packet(struct encoder *ec, int sourceid, GF_ELEMENT *syms);
-struct packet *output_source_packet(struct encoder *ec);
-struct packet *output_repair_packet(struct encoder *ec);
-struct packet *output_repair_packet_short(struct encoder *ec, int ew_width);
-void flush_acked_packets(struct encoder *ec, int ack_sid);
-void visualize_buffer(struct encoder *ec);
-void free_packet(struct packet *pkt);
-unsigned char *serialize_packet(struct encoder *ec, struct packet *pkt);
-void free_serialized_packet(unsigned char *pktstr);
-void free_encoder(struct encoder *ec);
-
-// decoder functions
-struct decoder *initialize_decoder(struct parameters *cp);
-int activate_decoder(struct decoder *dc, struct packet *pkt);
-int deactivate_decoder(struct decoder *dc);
-int receive_packet(struct decoder *dc, struct packet *pkt);
-int process_packet(struct decoder *dc, struct packet *pkt);
-struct packet *deserialize_packet(struct decoder *dc, unsigned char *pktstr);
-void free_decoder(struct decoder *dc);
-
-#endif  // STREAMCODEC_H
\ No newline at end of file
+#ifndef STREAMCODEC_H
+#define STREAMCODEC_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfkernel.h"
+#include "gfpool.h"
+#include "coefgen.h"
+#include "trace.h"
+#ifdef DEBUG
+# define DEBUG_PRINT(x) printf x
+#else
+# define DEBUG_PRINT(x) do {} while (0)
+#endif
+
+#ifndef GALOIS
+#define GALOIS
+typedef unsigned char GF_ELEMENT;
+#endif
+#define N       624                 // used by mt-19937 PRNG
+#define EWIN    100                 // "encoding window" for seeding PRNG (for coefficient synchronization)
+#define COE_MT19937 0               // coefficients drawn from a sequential MT19937 stream seeded via seed/EWIN,
+                                    // the default of a zero-initialized struct parameters
+#define COE_COUNTER 1               // coefficients regenerated from (seed, repairid, sourceid), see coefgen.h
+#define DEC_ALLOC   10000           // default buffer space allocated at decoder for recovered packets
+#define DEC_DWMAX   (1 << 20)       // widest decoding window and packet window, wider ones are rejected
+#define DEC_EAGER   0               // payloads reduced in one batch as each arriving packet is eliminated
+#define DEC_DEFERRED 1              // payload row operations deferred until they can deliver packets
+#define ENC_SEGSIZE 1024            // number of source packets per segment of the encoder buffer
+#define CACHELINE   64              // alignment and row padding of the decoder storage
+
+#define ALIGN(a, b) ((a) % (b) == 0 ? (a)/(b) : (a)/(b) + 1)
+// bytes per coefficient; GF(2^16) coefficients are little-endian 16-bit words
+#define COEBYTES(gfpower)   ((gfpower) > 8 ? 2 : 1)
+// buffered source packet of id sid, headsid <= sid <= tailsid
+#define SRCPKT(ec, sid) ((ec)->srcseg[((sid) / ENC_SEGSIZE) % (ec)->nseg]->syms[(sid) % ENC_SEGSIZE])
+// coefficient and payload rows pivoted at source id i of the decoding window
+#define DEC_ROW(dc, i)  ((dc)->coefs + (size_t) ((i) % (dc)->dwcap) * (dc)->cstride)
+#define DEC_MSG(dc, i)  ((dc)->msgs + (size_t) ((i) % (dc)->dwcap) * (dc)->mstride)
+// recovered source packet of id sid, valid for dc->inorder-dc->recvsize < sid <= dc->inorder
+#define RECOVERED(dc, sid)  ((dc)->recovered[(sid) % (dc)->recvsize])
+
+typedef struct mt19937_rng {
+    unsigned long   mt[N];          // the array for the state vector
+    int             mti;            // initialize to mti==N+1, means mt[N] is not initialized
+} MT19937;
+
+// Zero-initialize before setting fields (e.g., struct parameters cp = {0};), so that
+// fields left unset, including ones added in later versions, take their zero default
+struct parameters {
+    int     gfpower;                // n of GF(2^n), 1, 8 or 16, which selects the field at runtime
+    int     pktsize;                // number of bytes per packet
+    double  repfreq;                // frequency (probability) of sending repair packet
+    int     seed;                   // seed for random coding coefficients
+    int     coemode;                // coefficient generator, COE_MT19937 (0) or COE_COUNTER
+};
+
+// Runtime statistics, updated by the owning context without locks
+#define STATS_NBINS 32              // histogram bin b counts values in [2^(b-1), 2^b), bin 0 counts 0
+#define STATS_TIME_EVERY 64         // elim_ns times one received packet in this many (a power of 2)
+
+struct encoder_stats {
+    unsigned long long  nsource;            // number of sent source packets
+    unsigned long long  nrepair;            // number of sent repair packets
+    unsigned long long  madd_bytes;         // bytes processed by GF multiply-add
+    int                 buf_hwm;            // high-water mark of buffered source packets
+};
+
+struct decoder_stats {
+    unsigned long long  nsource;            // number of received source packets
+    unsigned long long  nrepair;            // number of received repair packets
+    unsigned long long  innovative;         // repair packets that increased the rank of the decoding window
+    unsigned long long  noninnovative;      // repair packets reduced to zero by the decoding window
+    unsigned long long  redundant;          // packets covering only already-delivered source packets
+    unsigned long long  madd_bytes;         // bytes processed by GF multiply-add
+    unsigned long long  skipped_bytes;      // payload bytes of row operations that were dropped unapplied
+    unsigned long long  elim_ns;            // time spent in elimination, in nanoseconds, sampled and scaled
+    unsigned long long  dw_hist[STATS_NBINS];       // decoding-window width seen by arriving repair packets
+    unsigned long long  delay_hist[STATS_NBINS];    // in-order delay, in received packets from first
+                                                    // covering a source packet to delivering it
+    int                 buf_hwm;            // high-water mark of decoding-window rows
+};
+
+// Decoder feedback summary, see get_decoder_feedback(); source ids in [win_s, win_e]
+// are either decoded or pending, except for the missing ones listed as runs of
+// (first id, count), which the decoder needs deficit more repair packets to recover
+#define FB_MAXRUNS  16              // further runs are merged into the last one
+struct dec_feedback {
+    int     inorder;
+    int     win_s;                  // decoding window, empty (win_e < win_s) if inactive
+    int     win_e;
+    int     deficit;                // rank deficit of the decoding window
+    int     nruns;
+    int     runs[FB_MAXRUNS][2];
+};
+
+struct packet {
+    int     sourceid;               // source packet id
+    int     repairid;               // repair packet id, -1 if it's a source packet
+    int     win_s;                  // start of repair encoding window
+    int     win_e;                  // end of repair encoding window
+    GF_ELEMENT  *coes;              // (win_e-win_s+1) encoding coefficients, COEBYTES(gfpower) bytes each
+    GF_ELEMENT  *syms;              // source or coded symbols
+};
+
+// A segment of ENC_SEGSIZE source packets, whose copied payloads share one slab
+typedef struct source_segment {
+    GF_ELEMENT  *slab;                  // ENC_SEGSIZE * pktsize bytes, NULL until a packet is copied in
+    GF_ELEMENT  *syms[ENC_SEGSIZE];     // source packets stored in the segment
+    unsigned char borrowed[ENC_SEGSIZE];// whether syms[i] is the caller's buffer (enqueue_packet_nocopy())
+    struct source_segment *next;        // link of released segments kept for reuse
+} SRC_SEG;
+
+// Called when a borrowed source packet is flushed from the encoder and its buffer
+// is handed back to the application
+typedef void (*RELEASE_FN)(int sourceid, GF_ELEMENT *syms, void *arg);
+
+struct scheduler;
+
+struct encoder {
+    struct parameters *cp;          // code parameter
+    int         count;              // total number of sent packets
+    int         nextsid;            // id of source packet next to send
+    int         rcount;             // number of sent repair packets 
+    // A segmented ring buffer
+    // a) Source packet sid lives in segment sid/ENC_SEGSIZE, slot sid%ENC_SEGSIZE. A segment
+    //    is added when the buffer is full, so buffered packets never move (only the
+    //    directory of segment pointers is doubled, when it runs out of entries)
+    // b) Acknowledged packets are flushed from the buffer. Segments flushed entirely are
+    //    kept for reuse up to the reserved capacity, and freed beyond that
+    // c) Encoding window [headsid, nextsid-1]
+    int         bufsize;            // current buffer size (allocated segments * ENC_SEGSIZE)
+    int         snum;               // number of queued source packets (including flushed)
+    int         head;               // head index of buffered source packets, -1 if empty
+    int         tail;               // tail index of bufferred source packets
+    int         headsid;            // source packet id of head
+    int         tailsid;            // source packet id of tail
+    int         nseg;               // number of entries of the segment directory
+    int         nreserve;           // number of segments kept allocated (reserve_encoder_buffer())
+    SRC_SEG     **srcseg;           // segment directory, indexed by (sid/ENC_SEGSIZE) % nseg
+    SRC_SEG     *freeseg;           // released segments kept for reuse
+    RELEASE_FN  release;            // release callback of borrowed source packets
+    void        *release_arg;       // opaque argument passed to release
+    // A mt19973 PRNG for synchronizing encoding coefficients, NULL for COE_COUNTER
+    MT19937     *prng;
+    const struct gf_kernel *gk;     // GF region kernel, selected at initialize_encoder()
+    int         wireformat;         // format of serialized packets, WIRE_LEGACY (default) or WIRE_COMPACT
+    struct encoder_stats stats;
+    struct tracer *trace;           // binary event trace, NULL if not traced
+    struct gf_pool *pool;           // stripes repair packets of jumbo payloads, NULL if serial
+    struct scheduler *sched;        // adaptive repair scheduler of next_packet(), see scheduler.h
+};
+
+struct decoder;
+// Called for each source packet in order as soon as it becomes deliverable; syms
+// is its recovered slot, valid until the slot is overwritten (see recovered below)
+typedef void (*DELIVER_FN)(struct decoder *dc, int sourceid, GF_ELEMENT *syms, void *arg);
+
+struct decoder {
+    struct parameters *cp;           // code parameter    
+    struct packet *pbuf;            // a single packet buffer for deserialize
+    int         active;             // whether the decoder is active
+    int         inorder;            // index of the last in-order received packet
+    int         win_s;              // start of decoding window
+    int         win_e;              // end of decoding window
+    int         dof;                // received DoF in the decoding window
+    // Band storage of the decoding window
+    // a) The row pivoted at source id i (win_s <= i <= win_e) is at ring position i % dwcap,
+    //    and holds rlen coefficients of columns i, i+1, ... (the band right of the diagonal)
+    // b) Coefficient and payload rows are each one cache-line aligned slab with rows padded
+    //    to cache lines, so elimination streams through memory
+    // c) Both slabs are doubled (and rows re-placed) when the window outgrows dwcap
+    // d) Row dwcap of the coefficient slab is scratch, holding the packet being eliminated;
+    //    its payload row operations are logged in oplog (see below) for the row it is stored to
+    int         dwcap;              // capacity of the decoding window, in rows
+    int         cstride;            // bytes per coefficient row, multiple of CACHELINE
+    int         mstride;            // bytes per payload row, multiple of CACHELINE
+    int         *rlen;              // number of coefficients of each row, 0 if the row is empty
+    GF_ELEMENT  *coefs;             // (dwcap + 1) * cstride bytes
+    GF_ELEMENT  *msgs;              // dwcap * mstride bytes
+    // Recovered packets, a ring of recvsize slots indexed by sourceid % recvsize
+    // a) Without a delivery callback, the application polls inorder and must copy packets
+    //    out before they are overwritten recvsize packets later
+    // b) With a delivery callback, each packet is also handed out once deliverable; slots
+    //    are kept as in a), since later repair packets may still cover delivered packets
+    // c) A packet covering a delivered packet no longer in the ring is rejected, so the
+    //    ring must span the packets sent but not yet acknowledged to the encoder
+    GF_ELEMENT  **recovered;
+    int         recvsize;           // number of slots of recovered, DEC_ALLOC by default
+    DELIVER_FN  deliver;            // in-order delivery callback, NULL for polling
+    void        *deliver_arg;       // opaque argument passed to deliver
+    int         prev_rep;           // id of the previous received repair packet
+    const struct gf_kernel *gk;     // GF region kernel, selected at initialize_decoder()
+    struct decoder_stats stats;
+    struct tracer *trace;           // binary event trace, NULL if not traced
+    struct gf_pool *pool;           // stripes payload row operations of jumbo payloads, NULL if serial
+    // Payload row operations
+    // a) An arriving packet is reduced on its coefficient row first, and the payload row
+    //    operations are appended to oplog in order instead of being applied one by one
+    // b) DEC_EAGER replays them through gf_pool_madd() in one batch once the packet is
+    //    pivoted; DEC_DEFERRED (deferred elimination) keeps them until the rank covers the
+    //    next in-order gap, i.e., rows win_s.. can be back-substituted and delivered, and
+    //    replays the whole log then, or before flushing
+    // c) Operations on a row reduced to zero (non-innovative) are dropped from the log
+    //    unreplayed, as are the rows' own payloads, counted in stats.skipped_bytes
+    int         mode;               // DEC_EAGER (default) or DEC_DEFERRED
+    struct gf_op *oplog;            // pending payload row operations, on DEC_MSG() rows
+    int         nlog;
+    int         logcap;
+};
+
+// encoder functions
+struct encoder *initialize_encoder(struct parameters *cp, unsigned char *buf, int nbytes);
+int reserve_encoder_buffer(struct encoder *ec, int npkts);
+int enqueue_packet(struct encoder *ec, int sourceid, GF_ELEMENT *syms);
+// borrow syms without copying; it must stay valid until released via the callback
+int enqueue_packet_nocopy(struct encoder *ec, int sourceid, GF_ELEMENT *syms);
+void set_release_callback(struct encoder *ec, RELEASE_FN release, void *arg);
+struct packet *output_source_packet(struct encoder *ec);
+struct packet *output_repair_packet(struct encoder *ec);
+struct packet *output_repair_packet_short(struct encoder *ec, int ew_width);
+// k repair packets over the same EW (the full EW if ew_width <= 0) in one cache-blocked pass,
+// where each buffered source packet is loaded once for all k, see gf_pool_madd_multi(); repair
+// ids and coefficients are those of k successive output_repair_packet*() calls. Returns the
+// number of packets stored to pkts, 0 if there is no packet to encode
+int output_repair_packets(struct encoder *ec, int k, int ew_width, struct packet **pkts);
+void flush_acked_packets(struct encoder *ec, int ack_sid);
+// repair packet over [win_s, win_e] clipped to the EW [headsid, nextsid-1], NULL if empty
+struct packet *output_repair_packet_range(struct encoder *ec, int win_s, int win_e);
+// Flush up to fb->inorder, then store to pkts min(fb->deficit, max) repair packets over
+// the span of the missing runs only; returns the number of packets stored
+int output_targeted_repairs(struct encoder *ec, const struct dec_feedback *fb, struct packet **pkts, int max);
+// Source or repair packet, as decided by the attached scheduler; without one, source
+// packets while any is waiting, then full repair packets. NULL if there is nothing to send
+struct packet *next_packet(struct encoder *ec);
+void visualize_buffer(struct encoder *ec);
+void free_packet(struct packet *pkt);
+unsigned char *serialize_packet(struct encoder *ec, struct packet *pkt);
+void free_serialized_packet(unsigned char *pktstr);
+void free_encoder(struct encoder *ec);
+void set_wire_format(struct encoder *ec, int format);
+void get_encoder_stats(struct encoder *ec, struct encoder_stats *st);
+void set_encoder_trace(struct encoder *ec, struct tracer *tr);
+// output_repair_packet*() run the multiply-adds over the EW through gf_pool_madd(),
+// in parallel column stripes when pktsize reaches the pool's threshold; the pool
+// is shared, not owned, and may serve several encoders and decoders
+void set_encoder_pool(struct encoder *ec, struct gf_pool *pool);
+void set_encoder_scheduler(struct encoder *ec, struct scheduler *sch);
+// zero-allocation variants, which serialize into a caller-owned buffer of cap bytes
+// and return the number of bytes written, or -1 if no packet or cap is too small
+int serialized_size(struct encoder *ec, struct packet *pkt);
+int serialize_packet_into(struct encoder *ec, struct packet *pkt, unsigned char *buf, int cap);
+int output_source_packet_into(struct encoder *ec, unsigned char *buf, int cap);
+int output_repair_packet_into(struct encoder *ec, unsigned char *buf, int cap);
+int output_repair_packet_short_into(struct encoder *ec, int ew_width, unsigned char *buf, int cap);
+
+// decoder functions
+struct decoder *initialize_decoder(struct parameters *cp);
+// a decoder for a stream whose packets up to inorder were delivered elsewhere
+struct decoder *initialize_decoder_at(struct parameters *cp, int inorder);
+int resize_recovered_buffer(struct decoder *dc, int nslots);
+void set_delivery_callback(struct decoder *dc, DELIVER_FN deliver, void *arg);
+void get_decoder_stats(struct decoder *dc, struct decoder_stats *st);
+// deserialize_packet() records TRACE_RECEIVE with the serialized packet attached;
+// attaching records a TRACE_INORDER of the current state, from which a replay starts
+void set_decoder_trace(struct decoder *dc, struct tracer *tr);
+// payload row operations of an elimination step are batched through gf_pool_madd(),
+// while the coefficient rows are still eliminated on the calling thread
+void set_decoder_pool(struct decoder *dc, struct gf_pool *pool);
+// switch between DEC_EAGER and DEC_DEFERRED; pending operations are replayed first
+void set_decoder_mode(struct decoder *dc, int mode);
+void get_decoder_feedback(struct decoder *dc, struct dec_feedback *fb);
+int activate_decoder(struct decoder *dc, struct packet *pkt);
+int deactivate_decoder(struct decoder *dc);
+int receive_packet(struct decoder *dc, struct packet *pkt);
+int process_packet(struct decoder *dc, struct packet *pkt);
+// accepts both wire formats, returns NULL if the header of a compact packet is corrupt
+struct packet *deserialize_packet(struct decoder *dc, unsigned char *pktstr);
+// view mode: dc->pbuf->coes/syms point into pktstr instead of being copied, so
+// pktstr must stay untouched until the returned packet is received
+struct packet *deserialize_packet_view(struct decoder *dc, unsigned char *pktstr);
+void free_decoder(struct decoder *dc);
+
+#endif  // STREAMCODEC_H
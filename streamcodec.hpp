@@ -0,0 +1,685 @@
+#ifndef STREAMCODEC_HPP
+#define STREAMCODEC_HPP
+/*
+ * Compile-time specialized C++ codec templates (header-only, C++17)
+ *
+ *      streamc::StreamEncoder<Field, PktSize>
+ *      streamc::StreamDecoder<Field, PktSize>
+ *
+ * The C API selects the field and the packet size at runtime from struct
+ * parameters. Here both are template arguments: the field (GF2, GF256 or
+ * GF65536) has its log/exp tables built at compile time for the element
+ * arithmetic on coefficients, and every region operation on a payload is
+ * madd<PktSize>(). For the fields of the C API, region operations run the
+ * kernels of gfkernel.h, the fastest the running CPU supports (PSHUFB, AVX2,
+ * AVX-512, GFNI), whatever the flags the program is built with; other
+ * polynomials use the split-nibble tables, with PSHUFB only when built with
+ * -mssse3/-mavx2.
+ *
+ * Packets are move-only values owning their payload, so there is no
+ * free_packet(). The codec is wire compatible with the C API: serialize()
+ * writes WIRE_LEGACY or WIRE_COMPACT (see wireformat.h), and the decoder parses
+ * packets of either format from a C or C++ encoder. Coefficients are always
+ * COE_COUNTER ones (see coefgen.h), so a C peer must use coemode = COE_COUNTER
+ * and the same seed; the decoder also accepts packets carrying their own
+ * coefficients (WIRE_LEGACY, or WIRE_COMPACT from a COE_MT19937 encoder).
+ * params() returns the struct parameters of the matching C encoder/decoder.
+ * Only the coefficient generator (coef_batch()) and the compact format come
+ * from the library, so programs link with -lstreamc like C ones.
+ *
+ * Source ids are assigned by enqueue() from 0 in order. Storage is allocated
+ * in slabs that are reused, not per packet: the encoder buffers source packets
+ * in a ring that doubles when full, and the decoder keeps its decoding window
+ * in a band of rows like the C decoder (see struct decoder), row i holding the
+ * packet pivoted at source id i in ring position i % dwcap, back-substituted
+ * and copied to the recovered ring once a block of consecutive rows closes.
+ * Packets returned by the encoder own their payload, one allocation each.
+ */
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+extern "C" {
+#include "streamcodec.h"
+#include "wireformat.h"
+}
+
+namespace streamc {
+
+namespace detail {
+
+struct gf256_tables {
+    uint8_t exp[512];
+    uint8_t log[256];
+    alignas(32) uint8_t lo[256][16];    // lo[c][x] = c * x
+    alignas(32) uint8_t hi[256][16];    // hi[c][x] = c * (x << 4)
+};
+
+constexpr gf256_tables make_gf256(int poly)
+{
+    gf256_tables t{};
+    int x = 1;
+    for (int i=0; i<255; i++) {
+        t.exp[i] = t.exp[i+255] = x;
+        t.log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= poly;
+    }
+    for (int c=1; c<256; c++) {
+        for (int v=1; v<16; v++) {
+            t.lo[c][v] = t.exp[t.log[c] + t.log[v]];
+            t.hi[c][v] = t.exp[t.log[c] + t.log[v << 4]];
+        }
+    }
+    return t;
+}
+
+struct gf65536_tables {
+    uint16_t exp[2 * 65535];
+    uint16_t log[65536];
+};
+
+constexpr gf65536_tables make_gf65536(int poly)
+{
+    gf65536_tables t{};
+    int x = 1;
+    for (int i=0; i<65535; i++) {
+        t.exp[i] = t.exp[i+65535] = x;
+        t.log[x] = i;
+        x <<= 1;
+        if (x & 0x10000)
+            x ^= poly;
+    }
+    return t;
+}
+
+// The region kernel of gfkernel.h for GF(2^power), selected once
+template <int Power>
+inline const struct gf_kernel *kernel()
+{
+    static const struct gf_kernel *const gk = gf_select_kernel(Power);
+    return gk;
+}
+
+}  // namespace detail
+
+// Fields: element arithmetic, dst += c * src over Len bytes (madd<Len>()), and
+// over len bytes, e.g., of coefficient rows (madd()). The tables of a field are
+// built when it is first used, GF256 and GF65536 are the fields of the C API
+
+struct GF2 {
+    static constexpr int power = 1;
+    static constexpr int coebytes = 1;
+    static constexpr int mul(int a, int b) { return a & b; }
+    static constexpr int div(int a, int) { return a; }
+    static void madd(uint8_t *dst, const uint8_t *src, int c, std::size_t len)
+    {
+        detail::kernel<1>()->madd(dst, src, c, len);
+    }
+    template <std::size_t Len>
+    static void madd(uint8_t *dst, const uint8_t *src, int c)
+    {
+        madd(dst, src, c, Len);
+    }
+};
+
+template <int Poly>
+struct GF2_8 {
+    static constexpr int power = 8;
+    static constexpr int coebytes = 1;
+    static constexpr detail::gf256_tables tab = detail::make_gf256(Poly);
+    static constexpr int mul(int a, int b)
+    {
+        return a == 0 || b == 0 ? 0 : tab.exp[tab.log[a] + tab.log[b]];
+    }
+    static constexpr int div(int a, int b)
+    {
+        return a == 0 ? 0 : tab.exp[tab.log[a] + 255 - tab.log[b]];
+    }
+    static void madd(uint8_t *dst, const uint8_t *src, int c, std::size_t len)
+    {
+        if constexpr (Poly == GF_POLY_8) {
+            detail::kernel<8>()->madd(dst, src, c, len);
+        } else if (c != 0) {
+            for (std::size_t i=0; i<len; i++)
+                dst[i] ^= tab.lo[c][src[i] & 0x0f] ^ tab.hi[c][src[i] >> 4];
+        }
+    }
+    template <std::size_t Len>
+    static void madd(uint8_t *__restrict dst, const uint8_t *__restrict src, int c)
+    {
+        if constexpr (Poly == GF_POLY_8) {
+            madd(dst, src, c, Len);
+            return;
+        }
+        if (c == 0)
+            return;
+        if (c == 1) {
+            GF2::madd<Len>(dst, src, 1);
+            return;
+        }
+        std::size_t i = 0;
+#if defined(__AVX2__)
+        {
+            const __m256i lo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) tab.lo[c]));
+            const __m256i hi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) tab.hi[c]));
+            const __m256i mask = _mm256_set1_epi8(0x0f);
+            for (; i+32<=Len; i+=32) {
+                __m256i s = _mm256_loadu_si256((const __m256i *) (src + i));
+                __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(lo, _mm256_and_si256(s, mask)),
+                                             _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask)));
+                __m256i d = _mm256_loadu_si256((const __m256i *) (dst + i));
+                _mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(d, p));
+            }
+        }
+#endif
+#if defined(__SSSE3__)
+        {
+            const __m128i lo = _mm_load_si128((const __m128i *) tab.lo[c]);
+            const __m128i hi = _mm_load_si128((const __m128i *) tab.hi[c]);
+            const __m128i mask = _mm_set1_epi8(0x0f);
+            for (; i+16<=Len; i+=16) {
+                __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+                __m128i p = _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(s, mask)),
+                                          _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask)));
+                __m128i d = _mm_loadu_si128((const __m128i *) (dst + i));
+                _mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(d, p));
+            }
+        }
+#endif
+        for (; i<Len; i++)
+            dst[i] ^= tab.lo[c][src[i] & 0x0f] ^ tab.hi[c][src[i] >> 4];
+    }
+};
+
+// symbols are little-endian 16-bit words, as in the C API
+template <int Poly>
+struct GF2_16 {
+    static constexpr int power = 16;
+    static constexpr int coebytes = 2;
+    static constexpr detail::gf65536_tables tab = detail::make_gf65536(Poly);
+    static constexpr int mul(int a, int b)
+    {
+        return a == 0 || b == 0 ? 0 : tab.exp[tab.log[a] + tab.log[b]];
+    }
+    static constexpr int div(int a, int b)
+    {
+        return a == 0 ? 0 : tab.exp[tab.log[a] + 65535 - tab.log[b]];
+    }
+    static void madd(uint8_t *dst, const uint8_t *src, int c, std::size_t len)
+    {
+        if constexpr (Poly == GF_POLY_16) {
+            detail::kernel<16>()->madd(dst, src, c, len);
+            return;
+        }
+        if (c == 0)
+            return;
+        if (c == 1) {
+            GF2::madd(dst, src, 1, len);
+            return;
+        }
+        const int lc = tab.log[c];
+        for (std::size_t i=0; i+1<len; i+=2) {
+            int w = src[i] | src[i+1] << 8;
+            if (w == 0)
+                continue;
+            int p = tab.exp[tab.log[w] + lc];
+            dst[i]   ^= p & 0xff;
+            dst[i+1] ^= p >> 8;
+        }
+    }
+    template <std::size_t Len>
+    static void madd(uint8_t *dst, const uint8_t *src, int c)
+    {
+        static_assert(Len % 2 == 0, "GF(2^16) symbols are 16-bit words");
+        madd(dst, src, c, Len);
+    }
+};
+
+using GF256   = GF2_8<GF_POLY_8>;
+using GF65536 = GF2_16<GF_POLY_16>;
+
+template <class Field>
+inline int get_coef(const uint8_t *coes, int j)
+{
+    return Field::coebytes == 2 ? coes[2*j] | coes[2*j+1] << 8 : coes[j];
+}
+
+template <class Field>
+inline void set_coef(uint8_t *coes, int j, int c)
+{
+    if (Field::coebytes == 2) {
+        coes[2*j]   = c & 0xff;
+        coes[2*j+1] = c >> 8;
+    } else {
+        coes[j] = c;
+    }
+}
+
+// Payload of a packet, cache-line aligned
+template <std::size_t PktSize>
+struct alignas(CACHELINE) Block {
+    uint8_t     b[PktSize];
+};
+
+template <class Field, std::size_t PktSize> class StreamEncoder;
+template <class Field, std::size_t PktSize> class StreamDecoder;
+
+// A source or repair packet; empty (false) if there was nothing to output
+template <std::size_t PktSize>
+class Packet {
+public:
+    int     sourceid = -1;          // source packet id, -1 if it's a repair packet
+    int     repairid = -1;          // repair packet id, -1 if it's a source packet
+    int     win_s    = -1;          // encoding window of a repair packet
+    int     win_e    = -1;
+
+    Packet() = default;
+    Packet(Packet &&) noexcept = default;
+    Packet &operator=(Packet &&) noexcept = default;
+    Packet(const Packet &) = delete;
+    Packet &operator=(const Packet &) = delete;
+
+    explicit operator bool() const { return syms_ != nullptr; }
+    bool is_repair() const { return repairid >= 0; }
+    uint8_t *syms() { return syms_->b; }
+    const uint8_t *syms() const { return syms_->b; }
+    // COEBYTES(Field::power) bytes per source packet of the window, empty for source packets
+    const std::vector<uint8_t> &coes() const { return coes_; }
+
+private:
+    template <class F, std::size_t P> friend class StreamEncoder;
+    template <class F, std::size_t P> friend class StreamDecoder;
+    std::unique_ptr<Block<PktSize>> syms_;
+    std::vector<uint8_t>            coes_;
+};
+
+template <class Field, std::size_t PktSize>
+inline struct parameters make_parameters(int seed)
+{
+    struct parameters cp = {};
+    cp.gfpower = Field::power;
+    cp.pktsize = PktSize;
+    cp.repfreq = 0;
+    cp.seed    = seed;
+    cp.coemode = COE_COUNTER;
+    return cp;
+}
+
+template <class Field, std::size_t PktSize>
+class StreamEncoder {
+public:
+    using packet_type = Packet<PktSize>;
+
+    explicit StreamEncoder(int seed, int wireformat = WIRE_LEGACY)
+        : cp_(make_parameters<Field, PktSize>(seed)), wireformat_(wireformat) {}
+    StreamEncoder(StreamEncoder &&) noexcept = default;
+    StreamEncoder &operator=(StreamEncoder &&) noexcept = default;
+    StreamEncoder(const StreamEncoder &) = delete;
+    StreamEncoder &operator=(const StreamEncoder &) = delete;
+
+    // copy PktSize bytes into the buffer; returns the source id
+    int enqueue(const uint8_t *syms)
+    {
+        if (snum_ - headsid_ == (int) buf_.size())
+            grow();
+        std::memcpy(buf_[snum_ & (buf_.size() - 1)].b, syms, PktSize);
+        return snum_++;
+    }
+
+    packet_type output_source()
+    {
+        packet_type pkt;
+        if (nextsid_ >= snum_)
+            return pkt;
+        pkt.sourceid = nextsid_++;
+        pkt.syms_ = std::make_unique<Block<PktSize>>(*src(pkt.sourceid));
+        count_++;
+        return pkt;
+    }
+
+    packet_type output_repair() { return repair(headsid_, nextsid_ - 1); }
+
+    packet_type output_repair_short(int ew_width)
+    {
+        int ws = nextsid_ - ew_width;
+        return repair(ws > headsid_ ? ws : headsid_, nextsid_ - 1);
+    }
+
+    void flush_acked(int ack_sid)
+    {
+        if (ack_sid >= headsid_)
+            headsid_ = ack_sid < nextsid_ ? ack_sid + 1 : nextsid_;
+    }
+
+    std::size_t serialized_size(const packet_type &pkt) const
+    {
+        if (wireformat_ == WIRE_COMPACT) {
+            struct packet v = view(pkt);
+            return compact_size(&cp_, &v);
+        }
+        return 4 * sizeof(int) + pkt.coes_.size() + PktSize;
+    }
+
+    // Write pkt to buf of cap bytes; returns the number of bytes written, -1 if cap is too small
+    int serialize(const packet_type &pkt, uint8_t *buf, std::size_t cap) const
+    {
+        if (wireformat_ == WIRE_COMPACT) {
+            struct packet v = view(pkt);
+            return serialize_compact(&cp_, &v, buf, cap);
+        }
+        if (serialized_size(pkt) > cap)
+            return -1;
+        int hdr[4] = { pkt.sourceid, pkt.repairid, pkt.win_s, pkt.win_e };
+        std::memcpy(buf, hdr, sizeof(hdr));
+        std::memcpy(buf + sizeof(hdr), pkt.coes_.data(), pkt.coes_.size());
+        std::memcpy(buf + sizeof(hdr) + pkt.coes_.size(), pkt.syms(), PktSize);
+        return sizeof(hdr) + pkt.coes_.size() + PktSize;
+    }
+
+    int nextsid() const { return nextsid_; }
+    int headsid() const { return headsid_; }
+    int snum() const { return snum_; }
+    int count() const { return count_; }
+    int rcount() const { return rcount_; }
+    const struct parameters &params() const { return cp_; }
+
+private:
+    struct parameters   cp_;
+    int                 wireformat_;
+    std::vector<Block<PktSize>> buf_;      // ring of source packets headsid_, ..., snum_-1, power-of-2 size
+    int                 headsid_ = 0;
+    int                 nextsid_ = 0;
+    int                 snum_    = 0;
+    int                 count_   = 0;
+    int                 rcount_  = 0;
+
+    const Block<PktSize> *src(int sid) const { return &buf_[sid & (buf_.size() - 1)]; }
+
+    // double the ring, which is full, re-placing the buffered packets
+    void grow()
+    {
+        std::vector<Block<PktSize>> buf(buf_.empty() ? 64 : 2 * buf_.size());
+        for (int sid=headsid_; sid<snum_; sid++)
+            buf[sid & (buf.size() - 1)] = buf_[sid & (buf_.size() - 1)];
+        buf_ = std::move(buf);
+    }
+
+    packet_type repair(int ws, int we)
+    {
+        packet_type pkt;
+        if (we < ws)
+            return pkt;
+        pkt.repairid = rcount_++;
+        pkt.win_s = ws;
+        pkt.win_e = we;
+        pkt.coes_.resize((we - ws + 1) * Field::coebytes);
+        coef_batch(cp_.seed, pkt.repairid, ws, we, Field::power, pkt.coes_.data());
+        pkt.syms_ = std::make_unique<Block<PktSize>>();
+        std::memset(pkt.syms_->b, 0, PktSize);
+        for (int sid=ws; sid<=we; sid++)
+            Field::template madd<PktSize>(pkt.syms_->b, src(sid)->b, get_coef<Field>(pkt.coes_.data(), sid - ws));
+        count_++;
+        return pkt;
+    }
+
+    static struct packet view(const packet_type &pkt)
+    {
+        struct packet v;
+        v.sourceid = pkt.sourceid;
+        v.repairid = pkt.repairid;
+        v.win_s    = pkt.win_s;
+        v.win_e    = pkt.win_e;
+        v.coes     = const_cast<GF_ELEMENT *>(pkt.coes_.data());
+        v.syms     = const_cast<GF_ELEMENT *>(pkt.syms());
+        return v;
+    }
+};
+
+template <class Field, std::size_t PktSize>
+class StreamDecoder {
+public:
+    using packet_type = Packet<PktSize>;
+
+    explicit StreamDecoder(int seed, int recvsize = DEC_ALLOC)
+        : cp_(make_parameters<Field, PktSize>(seed)), recvsize_(recvsize) {}
+    StreamDecoder(StreamDecoder &&) noexcept = default;
+    StreamDecoder &operator=(StreamDecoder &&) noexcept = default;
+    StreamDecoder(const StreamDecoder &) = delete;
+    StreamDecoder &operator=(const StreamDecoder &) = delete;
+
+    // Parse and process a serialized packet of len bytes, in either wire format.
+    // Returns 1 if it was innovative, 0 if not, -1 if it is malformed or refers to
+    // source packets no longer held
+    int receive(const uint8_t *pktstr, std::size_t len)
+    {
+        if (len < 6 + PktSize)         // shorter than any packet of either format
+            return -1;
+        int fmt = wire_format(pktstr);
+        if (fmt == WIRE_COMPACT) {
+            struct packet v;
+            int cap = len < (std::size_t) INT_MAX ? (int) len : INT_MAX;
+            if (deserialize_compact(&cp_, const_cast<unsigned char *>(pktstr), cap, &v) < 0)
+                return -1;
+            if (v.repairid >= 0 && v.win_e - v.win_s >= DEC_DWMAX)
+                return -1;
+            if (v.repairid >= 0 && v.coes == NULL) {
+                coes_.resize((v.win_e - v.win_s + 1) * Field::coebytes);
+                coef_batch(cp_.seed, v.repairid, v.win_s, v.win_e, Field::power, coes_.data());
+                v.coes = coes_.data();
+            }
+            return process(v.sourceid, v.repairid, v.win_s, v.win_e, v.coes, v.syms);
+        }
+        if (fmt != WIRE_LEGACY || len < 4 * sizeof(int) + PktSize)
+            return -1;
+        int hdr[4];
+        std::memcpy(hdr, pktstr, sizeof(hdr));
+        std::size_t ncoes = 0;
+        if (hdr[1] >= 0) {
+            if (hdr[2] < 0 || hdr[3] < hdr[2]
+                || (std::size_t) (hdr[3] - hdr[2]) >= (len - sizeof(hdr) - PktSize) / Field::coebytes)
+                return -1;
+            ncoes = (hdr[3] - hdr[2] + 1) * Field::coebytes;
+        } else if (hdr[0] < 0) {
+            return -1;
+        }
+        return process(hdr[0], hdr[1], hdr[2], hdr[3], pktstr + sizeof(hdr), pktstr + sizeof(hdr) + ncoes);
+    }
+
+    // process a packet of a StreamEncoder of the same code directly
+    int receive(const packet_type &pkt)
+    {
+        return process(pkt.sourceid, pkt.repairid, pkt.win_s, pkt.win_e, pkt.coes_.data(), pkt.syms());
+    }
+
+    int inorder() const { return inorder_; }
+    // recovered source packet of id sid, valid for inorder()-recvsize < sid <= inorder()
+    const uint8_t *recovered(int sid) const { return recovered_[sid % recvsize_].b; }
+    // number of rows of the decoding window
+    int dof() const { return dof_; }
+    const struct parameters &params() const { return cp_; }
+
+private:
+    static constexpr int nb = Field::coebytes;
+
+    struct parameters   cp_;
+    int                 recvsize_;
+    std::vector<Block<PktSize>> recovered_;     // ring of recvsize_ slots, grown up to it as used
+    std::vector<uint8_t> coes_;                 // regenerated coefficients
+    int                 inorder_ = -1;
+    // decoding window [inorder_+1, win_e_]: dwcap_ rows plus a scratch row for
+    // the packet being eliminated, rlen_ coefficients from the pivot each, 0 if
+    // no row is pivoted there
+    int                 win_e_   = -1;
+    int                 dof_     = 0;
+    int                 dwcap_   = 0;
+    std::size_t         cstride_ = 0;
+    std::vector<int>    rlen_;
+    std::vector<uint8_t> coefs_;
+    std::vector<Block<PktSize>> msgs_;
+
+    uint8_t *row(int i) { return coefs_.data() + (std::size_t) (i % dwcap_) * cstride_; }
+    uint8_t *msg(int i) { return msgs_[i % dwcap_].b; }
+    int &rlen(int i) { return rlen_[i % dwcap_]; }
+
+    uint8_t *recovered_slot(int sid)
+    {
+        std::size_t r = sid % recvsize_;
+        if (r >= recovered_.size()) {
+            std::size_t n = recovered_.empty() ? 64 : 2 * recovered_.size();
+            if (n <= r)
+                n = r + 1;
+            recovered_.resize(n < (std::size_t) recvsize_ ? n : recvsize_);
+        }
+        return recovered_[r].b;
+    }
+
+    // grow the band to a window of width columns, re-placing the rows
+    void reserve(int width)
+    {
+        if (width <= dwcap_)
+            return;
+        int dwcap = dwcap_ > 0 ? dwcap_ : 64;
+        while (dwcap < width)
+            dwcap *= 2;
+        std::size_t cstride = (std::size_t) ALIGN(dwcap * nb, CACHELINE) * CACHELINE;
+        std::vector<int> rlen(dwcap, 0);
+        std::vector<uint8_t> coefs((dwcap + 1) * cstride);
+        std::vector<Block<PktSize>> msgs(dwcap + 1);
+        for (int i=inorder_+1; i<=win_e_; i++) {
+            int len = rlen_[i % dwcap_];
+            if (len == 0)
+                continue;
+            rlen[i % dwcap] = len;
+            std::memcpy(&coefs[(i % dwcap) * cstride], row(i), len * nb);
+            msgs[i % dwcap] = msgs_[i % dwcap_];
+        }
+        rlen_    = std::move(rlen);
+        coefs_   = std::move(coefs);
+        msgs_    = std::move(msgs);
+        dwcap_   = dwcap;
+        cstride_ = cstride;
+    }
+
+    void deliver_one(int sid, const uint8_t *syms)
+    {
+        std::memcpy(recovered_slot(sid), syms, PktSize);
+        inorder_ = sid;
+        if (win_e_ < sid)
+            win_e_ = sid;
+    }
+
+    int process(int sourceid, int repairid, int ws, int we, const uint8_t *coes, const uint8_t *syms)
+    {
+        if (repairid < 0) {
+            if (sourceid <= inorder_)
+                return 0;
+            if (dof_ == 0 && sourceid == inorder_ + 1) {
+                deliver_one(sourceid, syms);
+                return 1;
+            }
+            ws = we = sourceid;
+            coes = nullptr;
+        } else if (we <= inorder_) {
+            return 0;
+        }
+        // delivered source packets must still be held to be subtracted
+        int s = inorder_ + 1;
+        for (int sid=ws; sid<s; sid++) {
+            if (get_coef<Field>(coes, sid - ws) != 0 && sid <= inorder_ - recvsize_)
+                return -1;
+        }
+        if (we > win_e_) {
+            if (we - s >= DEC_DWMAX)
+                return -1;
+            reserve(we - s + 1);
+            for (int i=win_e_+1; i<=we; i++)
+                rlen(i) = 0;
+            win_e_ = we;
+        }
+        uint8_t *co = coefs_.data() + (std::size_t) dwcap_ * cstride_;
+        uint8_t *m = msgs_[dwcap_].b;
+        int c0 = ws > s ? ws : s;
+        std::memset(co, 0, (std::size_t) (win_e_ - s + 1) * nb);
+        if (coes != nullptr)
+            std::memcpy(co + (c0 - s) * nb, coes + (c0 - ws) * nb, (std::size_t) (we - c0 + 1) * nb);
+        else
+            set_coef<Field>(co, c0 - s, 1);
+        std::memcpy(m, syms, PktSize);
+        for (int sid=ws; sid<s; sid++)
+            Field::template madd<PktSize>(m, recovered(sid), get_coef<Field>(coes, sid - ws));
+        // reduce by the rows of the window in increasing column order; the
+        // first column without a row left non-zero is the pivot of the new row
+        int last = we, piv = -1;
+        for (int i=s; i<=last; i++) {
+            int c = get_coef<Field>(co, i - s);
+            if (c == 0)
+                continue;
+            int len = rlen(i);
+            if (len == 0) {
+                piv = i;
+                break;
+            }
+            Field::madd(co + (i - s) * nb, row(i), c, (std::size_t) len * nb);
+            if (i + len - 1 > last)
+                last = i + len - 1;
+            Field::template madd<PktSize>(m, msg(i), c);
+        }
+        if (piv < 0)
+            return 0;
+        while (get_coef<Field>(co, last - s) == 0)
+            last--;
+        int len = last - piv + 1;
+        int inv = Field::div(1, get_coef<Field>(co, piv - s));
+        if (inv == 1) {
+            std::memcpy(row(piv), co + (piv - s) * nb, (std::size_t) len * nb);
+            std::memcpy(msg(piv), m, PktSize);
+        } else {
+            std::memset(row(piv), 0, (std::size_t) len * nb);
+            Field::madd(row(piv), co + (piv - s) * nb, inv, (std::size_t) len * nb);
+            std::memset(msg(piv), 0, PktSize);
+            Field::template madd<PktSize>(msg(piv), m, inv);
+        }
+        rlen(piv) = len;
+        dof_++;
+        deliver_ready();
+        return 1;
+    }
+
+    // deliver the blocks of consecutive rows from inorder_+1 on whose
+    // coefficients end within the block, back-substituted from the last row up
+    void deliver_ready()
+    {
+        int s = inorder_ + 1, ext = inorder_;
+        for (int i=s; i<=win_e_; i++) {
+            int len = rlen(i);
+            if (len == 0)
+                break;
+            if (i + len - 1 > ext)
+                ext = i + len - 1;
+            if (ext > i)
+                continue;
+            for (int r=i; r>=s; r--) {
+                for (int j=1; j<rlen(r); j++)
+                    Field::template madd<PktSize>(msg(r), msg(r + j), get_coef<Field>(row(r), j));
+            }
+            for (int r=s; r<=i; r++) {
+                rlen(r) = 0;
+                dof_--;
+                deliver_one(r, msg(r));
+            }
+            s = i + 1;
+        }
+    }
+};
+
+}  // namespace streamc
+
+#endif  // STREAMCODEC_HPP
@@ -0,0 +1,190 @@
+/*
+ * Binary event trace of an encoder or decoder. See trace.h.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+
+static int pow2_ceil(int n)
+{
+    int p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+static uint64_t trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct tracer *trace_create(int nevents, int blobsize)
+{
+    struct tracer *tr = calloc(1, sizeof(struct tracer));
+    if (tr == NULL)
+        return NULL;
+    tr->nevents  = pow2_ceil(nevents);
+    tr->blobsize = pow2_ceil(blobsize);
+    tr->events   = calloc(tr->nevents, sizeof(struct trace_event));
+    tr->seqs     = calloc(tr->nevents, sizeof(*tr->seqs));
+    tr->blobs    = malloc(tr->blobsize);
+    if (tr->events == NULL || tr->seqs == NULL || tr->blobs == NULL) {
+        trace_free(tr);
+        return NULL;
+    }
+    atomic_init(&tr->head, 0);
+    atomic_init(&tr->bhead, 0);
+    return tr;
+}
+
+void trace_free(struct tracer *tr)
+{
+    if (tr == NULL)
+        return;
+    free(tr->events);
+    free((void *) tr->seqs);
+    free(tr->blobs);
+    free(tr);
+}
+
+void trace_packet(struct tracer *tr, int type, int a, int b, int c, const unsigned char *pkt, int len)
+{
+    uint64_t h = atomic_load_explicit(&tr->head, memory_order_relaxed);
+    int slot = h & (tr->nevents - 1);
+    struct trace_event *ev = &tr->events[slot];
+    // the slot reads as being written until its sequence number is set again
+    atomic_store_explicit(&tr->seqs[slot], 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    ev->ts   = trace_now();
+    ev->type = type;
+    ev->a    = a;
+    ev->b    = b;
+    ev->c    = c;
+    ev->len  = 0;
+    if (pkt != NULL && len > 0 && len <= tr->blobsize && len <= UINT16_MAX) {
+        uint64_t bh = atomic_load_explicit(&tr->bhead, memory_order_relaxed);
+        // claim the bytes before overwriting them, so a dump knows they are stale
+        atomic_store_explicit(&tr->bhead, bh + len, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        int off = bh & (tr->blobsize - 1);
+        int n1 = len < tr->blobsize - off ? len : tr->blobsize - off;
+        memcpy(tr->blobs + off, pkt, n1);
+        memcpy(tr->blobs, pkt + n1, len - n1);
+        ev->blob = bh;
+        ev->len  = len;
+    }
+    atomic_store_explicit(&tr->seqs[slot], h + 1, memory_order_release);
+    atomic_store_explicit(&tr->head, h + 1, memory_order_release);
+}
+
+void trace_event(struct tracer *tr, int type, int a, int b, int c)
+{
+    trace_packet(tr, type, a, b, c, NULL, 0);
+}
+
+/*
+ * Write the recorded events, oldest first, with their attached packets to fp.
+ * Events overwritten while copied are dropped along with all older ones, so
+ * the dump is one contiguous run starting at event number th.first. Return
+ * the number of events written, or -1 on I/O error.
+ */
+long trace_dump(struct tracer *tr, FILE *fp)
+{
+    uint64_t h1 = atomic_load_explicit(&tr->head, memory_order_acquire);
+    uint64_t bh1 = atomic_load_explicit(&tr->bhead, memory_order_acquire);
+    uint64_t first = h1 > (uint64_t) tr->nevents ? h1 - tr->nevents : 0;
+    long n = h1 - first;
+    struct trace_event *evs = malloc(sizeof(struct trace_event) * (n ? n : 1));
+    char *ok = malloc(n ? n : 1);
+    unsigned char *blobs = malloc(tr->blobsize);
+    if (evs == NULL || ok == NULL || blobs == NULL) {
+        free(evs);
+        free(ok);
+        free(blobs);
+        return -1;
+    }
+    // An event is kept if its slot held it both before and after the copy, and
+    // its attached bytes if the byte ring was not claimed past them meanwhile
+    for (long i=0; i<n; i++) {
+        int slot = (first + i) & (tr->nevents - 1);
+        uint64_t s1 = atomic_load_explicit(&tr->seqs[slot], memory_order_acquire);
+        evs[i] = tr->events[slot];
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t s2 = atomic_load_explicit(&tr->seqs[slot], memory_order_relaxed);
+        ok[i] = s1 == first + i + 1 && s2 == s1;
+    }
+    memcpy(blobs, tr->blobs, tr->blobsize);
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t bh2 = atomic_load_explicit(&tr->bhead, memory_order_relaxed);
+    // bytes from bvalid on were neither overwritten before nor during the copy
+    uint64_t bvalid = bh2 > (uint64_t) tr->blobsize ? bh2 - tr->blobsize : 0;
+
+    struct trace_header th = { TRACE_MAGIC, TRACE_VERSION, tr->gfpower, tr->pktsize, tr->seed, tr->coemode, 0, 0 };
+    for (long i=n-1; i>=0; i--) {
+        if (!ok[i])
+            break;              // older slots were overwritten past this one
+        th.nevents++;
+    }
+    long skip = n - th.nevents;
+    th.first = first + skip;
+    if (fwrite(&th, sizeof(th), 1, fp) != 1)
+        goto ioerror;
+    for (long i=skip; i<n; i++) {
+        struct trace_event *ev = &evs[i];
+        if (ev->len && (ev->blob < bvalid || ev->blob + ev->len > bh1))
+            ev->len = 0;            // attached packet already overwritten
+        if (fwrite(ev, sizeof(*ev), 1, fp) != 1)
+            goto ioerror;
+        if (ev->len) {
+            int off = ev->blob & (tr->blobsize - 1);
+            int n1 = ev->len < tr->blobsize - off ? ev->len : tr->blobsize - off;
+            if (fwrite(blobs + off, 1, n1, fp) != (size_t) n1
+                || fwrite(blobs, 1, ev->len - n1, fp) != (size_t) (ev->len - n1))
+                goto ioerror;
+        }
+    }
+    free(evs);
+    free(ok);
+    free(blobs);
+    return th.nevents;
+
+ioerror:
+    free(evs);
+    free(ok);
+    free(blobs);
+    return -1;
+}
+
+long trace_dump_file(struct tracer *tr, const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return -1;
+    long n = trace_dump(tr, fp);
+    if (fclose(fp) != 0)
+        return -1;
+    return n;
+}
+
+int trace_read_header(FILE *fp, struct trace_header *th)
+{
+    if (fread(th, sizeof(*th), 1, fp) != 1 || th->magic != TRACE_MAGIC || th->version != TRACE_VERSION)
+        return -1;
+    return 0;
+}
+
+/*
+ * Read the next event of a dump; its attached packet, if any, is copied into
+ * buf of cap bytes. Return 0, or -1 at the end of the dump or on error.
+ */
+int trace_read_event(FILE *fp, struct trace_event *ev, unsigned char *buf, int cap)
+{
+    if (fread(ev, sizeof(*ev), 1, fp) != 1)
+        return -1;
+    if (ev->len > cap || fread(buf, 1, ev->len, fp) != ev->len)
+        return -1;
+    return 0;
+}
@@ -0,0 +1,97 @@
+#ifndef TRACE_H
+#define TRACE_H
+/*
+ * Binary event trace of an encoder or decoder
+ *
+ * A tracer is a flight recorder: a ring of fixed-size binary events, plus a
+ * byte ring holding serialized packets attached to TRACE_RECEIVE events, both
+ * overwriting the oldest entries when full. It is written only by the thread
+ * owning the traced context, without locks; trace_dump() may run concurrently
+ * from another thread and skips entries overwritten while it copies them: each
+ * event slot carries a sequence number, cleared while the slot is rewritten,
+ * and the byte ring head is advanced before attached bytes are written.
+ *
+ * A dump covers the most recent events only once the ring wrapped, so it may
+ * start in the middle of a stream (see trace_header.first), which a replay
+ * must take into account.
+ *
+ * Attach a tracer with set_encoder_trace()/set_decoder_trace(), which also
+ * record the code parameters in it; contexts without one only pay a NULL check
+ * per event. A dumped decoder trace can be
+ * replayed through receive_packet() by examples/replay.c.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C++" {                      // for C++ users of streamcodec.h, same layout
+#include <atomic>
+}
+#define TRACE_ATOMIC(t) std::atomic<t>
+#else
+#include <stdatomic.h>
+#define TRACE_ATOMIC(t) _Atomic(t)
+#endif
+
+enum trace_type {
+    TRACE_ENQUEUE = 1,              // a: sourceid
+    TRACE_SOURCE,                   // a: sourceid
+    TRACE_REPAIR,                   // a: repairid, b: win_s, c: win_e
+    TRACE_RECEIVE,                  // a: sourceid, b: repairid; the serialized packet is attached
+    TRACE_PIVOT,                    // a: pivot column, b: row length, c: decoding-window width
+    TRACE_INORDER,                  // a: new inorder, b: previous inorder, c: 1 if no decoding window is left
+    TRACE_FLUSH,                    // a: ack_sid, b: headsid after the flush
+    TRACE_REJECT,                   // a: bytes received, b: length told by the header, -1 if invalid
+    TRACE_FEEDBACK,                 // a: inorder, b: deficit, c: nruns of received decoder feedback
+    TRACE_PARK,                     // a: inorder of a decoder parked by its dec_slot
+};
+
+struct trace_event {
+    uint64_t    ts;                 // CLOCK_MONOTONIC in nanoseconds
+    uint64_t    blob;               // offset of the attached packet in the byte ring
+    uint16_t    type;
+    uint16_t    len;                // bytes of the attached packet, 0 if none
+    int32_t     a;
+    int32_t     b;
+    int32_t     c;
+};
+
+struct tracer {
+    int                 nevents;    // capacity of the event ring, a power of 2
+    int                 blobsize;   // capacity of the byte ring, a power of 2
+    struct trace_event  *events;
+    TRACE_ATOMIC(uint64_t) *seqs;   // per event slot, 1 + number of the event held, 0 while written
+    unsigned char       *blobs;
+    TRACE_ATOMIC(uint64_t) head;    // number of events ever recorded
+    TRACE_ATOMIC(uint64_t) bhead;   // number of bytes ever attached
+    int                 gfpower;    // code parameters recorded in dumps, for replay
+    int                 pktsize;
+    int                 seed;
+    int                 coemode;
+};
+
+// file header of trace_dump(), followed by each event and its attached bytes
+#define TRACE_MAGIC     0x52544353  // "SCTR"
+#define TRACE_VERSION   2
+struct trace_header {
+    uint32_t    magic;
+    uint32_t    version;
+    int32_t     gfpower;
+    int32_t     pktsize;
+    int32_t     seed;
+    int32_t     coemode;
+    uint64_t    nevents;
+    uint64_t    first;              // number of the first event dumped, non-zero if the ring wrapped
+};
+
+#define TRACE(tr, type, a, b, c) do { if (tr) trace_event(tr, type, a, b, c); } while (0)
+
+struct tracer *trace_create(int nevents, int blobsize);
+void trace_free(struct tracer *tr);
+void trace_event(struct tracer *tr, int type, int a, int b, int c);
+void trace_packet(struct tracer *tr, int type, int a, int b, int c, const unsigned char *pkt, int len);
+long trace_dump(struct tracer *tr, FILE *fp);
+long trace_dump_file(struct tracer *tr, const char *path);
+int trace_read_header(FILE *fp, struct trace_header *th);
+int trace_read_event(FILE *fp, struct trace_event *ev, unsigned char *buf, int cap);
+
+#endif  // TRACE_H
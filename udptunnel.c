@@ -0,0 +1,469 @@
+/*
+ * Batched UDP tunnel endpoint. See udptunnel.h.
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "udptunnel.h"
+#include "wireformat.h"
+#include "scheduler.h"
+
+#define UT_SOCKBUF      (4 << 20)   // socket buffers, to absorb bursts of batches
+
+struct udp_tunnel {
+    struct parameters   cp;
+    struct encoder      *ec;
+    struct decoder      *dc;
+    int                 fd;         // data socket
+    int                 fbfd;       // feedback socket
+    struct sockaddr_in  peer;
+    struct sockaddr_in  peerfb;
+    int                 connected;
+    // batch of datagrams to send, UT_MAXDGRAM bytes per slot
+    unsigned char       *sbuf;
+    struct mmsghdr      smsg[UT_BATCH];
+    struct iovec        siov[UT_BATCH];
+    int                 nsend;
+    // batches of received datagrams
+    unsigned char       *rbuf;
+    struct mmsghdr      rmsg[UT_BATCH];
+    struct iovec        riov[UT_BATCH];
+    unsigned char       fbbuf[UT_BATCH][WIRE_MAXFB];
+    struct mmsghdr      fbmsg[UT_BATCH];
+    struct iovec        fbiov[UT_BATCH];
+    // repair cadence without a scheduler
+    double              perrepair;  // repairs due per source packet
+    double              credit;
+    // feedback
+    int                 fbevery;
+    int                 sincefb;    // data packets received since the last feedback sent
+    int                 inflight;   // repair packets sent since the last feedback received
+    // loss shim
+    double              pe;
+    double              p_gb;       // Gilbert-Elliott transitions, 0 for Bernoulli
+    double              p_bg;
+    double              fbpe;
+    int                 bad;
+    uint64_t            rng;
+    struct ut_stats     stats;
+};
+
+static uint64_t rng_next(struct udp_tunnel *ut)
+{
+    ut->rng ^= ut->rng >> 12;
+    ut->rng ^= ut->rng << 25;
+    ut->rng ^= ut->rng >> 27;
+    return ut->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_uniform(struct udp_tunnel *ut)
+{
+    return (rng_next(ut) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int shim_drop(struct udp_tunnel *ut)
+{
+    if (ut->pe <= 0)
+        return 0;
+    if (ut->p_gb <= 0)
+        return rng_uniform(ut) < ut->pe;
+    int e = ut->bad;
+    if (rng_uniform(ut) < (ut->bad ? ut->p_bg : ut->p_gb))
+        ut->bad = !ut->bad;
+    return e;
+}
+
+static int set_addr(struct sockaddr_in *sa, const char *addr, int port)
+{
+    memset(sa, 0, sizeof(struct sockaddr_in));
+    sa->sin_family = AF_INET;
+    sa->sin_port   = htons(port);
+    if (addr == NULL) {
+        sa->sin_addr.s_addr = htonl(INADDR_ANY);
+        return 0;
+    }
+    return inet_pton(AF_INET, addr, &sa->sin_addr) == 1 ? 0 : -1;
+}
+
+static int open_socket(const char *addr, int port)
+{
+    struct sockaddr_in sa;
+    if (set_addr(&sa, addr, port) < 0)
+        return -1;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    int sz = UT_SOCKBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+    if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void setup_batch(struct mmsghdr *msg, struct iovec *iov, unsigned char *buf, int slot)
+{
+    for (int i=0; i<UT_BATCH; i++) {
+        iov[i].iov_base = buf + (size_t) i * slot;
+        iov[i].iov_len  = slot;
+        memset(&msg[i], 0, sizeof(struct mmsghdr));
+        msg[i].msg_hdr.msg_iov    = &iov[i];
+        msg[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+struct udp_tunnel *ut_open(const struct parameters *cp, const char *addr, int port, int fbport)
+{
+    struct udp_tunnel *ut = calloc(1, sizeof(struct udp_tunnel));
+    if (ut == NULL)
+        return NULL;
+    ut->cp = *cp;
+    ut->fd = open_socket(addr, port);
+    ut->fbfd = open_socket(addr, fbport);
+    ut->sbuf = malloc((size_t) UT_BATCH * UT_MAXDGRAM);
+    ut->rbuf = malloc((size_t) UT_BATCH * UT_MAXDGRAM);
+    ut->ec = initialize_encoder(&ut->cp, NULL, 0);
+    ut->dc = initialize_decoder(&ut->cp);
+    if (ut->fd < 0 || ut->fbfd < 0 || ut->sbuf == NULL || ut->rbuf == NULL || ut->ec == NULL || ut->dc == NULL) {
+        ut_close(ut);
+        return NULL;
+    }
+    setup_batch(ut->smsg, ut->siov, ut->sbuf, UT_MAXDGRAM);
+    setup_batch(ut->rmsg, ut->riov, ut->rbuf, UT_MAXDGRAM);
+    setup_batch(ut->fbmsg, ut->fbiov, &ut->fbbuf[0][0], WIRE_MAXFB);
+    if (cp->repfreq >= 1)
+        ut->perrepair = 1.0 / (int) cp->repfreq;
+    else if (cp->repfreq > 0)
+        ut->perrepair = cp->repfreq / (1 - cp->repfreq);
+    ut->fbevery = UT_FBEVERY;
+    return ut;
+}
+
+int ut_connect(struct udp_tunnel *ut, const char *addr, int port, int fbport)
+{
+    if (addr == NULL || set_addr(&ut->peer, addr, port) < 0 || set_addr(&ut->peerfb, addr, fbport) < 0)
+        return -1;
+    for (int i=0; i<UT_BATCH; i++) {
+        ut->smsg[i].msg_hdr.msg_name    = &ut->peer;
+        ut->smsg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+    ut->connected = 1;
+    return 0;
+}
+
+static int local_port(int fd)
+{
+    struct sockaddr_in sa;
+    socklen_t len = sizeof(sa);
+    if (getsockname(fd, (struct sockaddr *) &sa, &len) < 0)
+        return -1;
+    return ntohs(sa.sin_port);
+}
+
+void ut_ports(struct udp_tunnel *ut, int *port, int *fbport)
+{
+    *port = local_port(ut->fd);
+    *fbport = local_port(ut->fbfd);
+}
+
+struct encoder *ut_encoder(struct udp_tunnel *ut)
+{
+    return ut->ec;
+}
+
+struct decoder *ut_decoder(struct udp_tunnel *ut)
+{
+    return ut->dc;
+}
+
+void ut_set_feedback(struct udp_tunnel *ut, int fbevery)
+{
+    ut->fbevery = fbevery > 0 ? fbevery : UT_FBEVERY;
+}
+
+void ut_set_loss(struct udp_tunnel *ut, double pe, double burst, double fbpe, unsigned long seed)
+{
+    ut->pe   = pe;
+    ut->fbpe = fbpe;
+    ut->p_gb = 0;
+    ut->p_bg = 0;
+    ut->bad  = 0;
+    if (burst > 1 && pe > 0 && pe < 1) {
+        ut->p_bg = 1 / burst;
+        ut->p_gb = pe / (burst * (1 - pe));
+    }
+    // splitmix64 of the seed, never 0
+    uint64_t x = seed + 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    ut->rng = (x ^ (x >> 31)) | 1;
+}
+
+int ut_flush(struct udp_tunnel *ut)
+{
+    int off = 0;
+    while (off < ut->nsend) {
+        int n = sendmmsg(ut->fd, ut->smsg + off, ut->nsend - off, 0);
+        ut->stats.nsyscall++;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            ut->nsend = 0;
+            return -1;
+        }
+        off += n;
+    }
+    ut->nsend = 0;
+    return 0;
+}
+
+// Serialize pkt into the send batch (unless the shim drops it) and free it
+static int batch_packet(struct udp_tunnel *ut, struct packet *pkt)
+{
+    if (pkt->repairid >= 0) {
+        ut->stats.nrepair++;
+        ut->inflight++;
+    } else
+        ut->stats.nsource++;
+    if (shim_drop(ut)) {
+        ut->stats.dropped++;
+        free_packet(pkt);
+        return 0;
+    }
+    if (ut->nsend == UT_BATCH && ut_flush(ut) < 0) {
+        free_packet(pkt);
+        return -1;
+    }
+    int len = serialize_packet_into(ut->ec, pkt, ut->siov[ut->nsend].iov_base, UT_MAXDGRAM);
+    free_packet(pkt);
+    if (len < 0) {
+        ut->stats.oversize++;
+        return 0;
+    }
+    ut->siov[ut->nsend].iov_len = len;
+    ut->nsend++;
+    return 0;
+}
+
+// Packets decided by the scheduler, until it has nothing more to send
+static int send_scheduled(struct udp_tunnel *ut)
+{
+    struct packet *pkt;
+    while ((pkt = next_packet(ut->ec)) != NULL) {
+        if (batch_packet(ut, pkt) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+int ut_send(struct udp_tunnel *ut, const unsigned char *data, int n)
+{
+    struct encoder *ec = ut->ec;
+    if (!ut->connected)
+        return -1;
+    for (int i=0; i<n; i++) {
+        if (enqueue_packet(ec, ec->snum, (GF_ELEMENT *) data + (size_t) i * ut->cp.pktsize) < 0)
+            return -1;
+        if (ec->sched != NULL)
+            continue;
+        if (batch_packet(ut, output_source_packet(ec)) < 0)
+            return -1;
+        ut->credit += ut->perrepair;
+        while (ut->credit >= 1) {
+            ut->credit -= 1;
+            if (batch_packet(ut, output_repair_packet(ec)) < 0)
+                return -1;
+        }
+    }
+    if (ec->sched != NULL && send_scheduled(ut) < 0)
+        return -1;
+    return n;
+}
+
+int ut_unacked(struct udp_tunnel *ut)
+{
+    return ut->ec->head != -1 && ut->ec->nextsid > ut->ec->headsid;
+}
+
+static int send_feedback(struct udp_tunnel *ut)
+{
+    struct dec_feedback fb;
+    unsigned char buf[WIRE_MAXFB];
+    get_decoder_feedback(ut->dc, &fb);
+    ut->sincefb = 0;
+    int len = serialize_feedback(&fb, buf, sizeof(buf));
+    if (len < 0 || !ut->connected)
+        return -1;
+    ut->stats.fbsent++;
+    if (ut->fbpe > 0 && rng_uniform(ut) < ut->fbpe) {
+        ut->stats.dropped++;
+        return 0;
+    }
+    ut->stats.nsyscall++;
+    while (sendto(ut->fbfd, buf, len, 0, (struct sockaddr *) &ut->peerfb, sizeof(struct sockaddr_in)) < 0) {
+        if (errno != EINTR)
+            return -1;
+    }
+    return 0;
+}
+
+static void receive_data(struct udp_tunnel *ut, struct mmsghdr *msg)
+{
+    unsigned char *buf = msg->msg_hdr.msg_iov->iov_base;
+    ut->stats.nrecv++;
+    int len = msg->msg_hdr.msg_flags & MSG_TRUNC ? -1 : wire_length(&ut->cp, buf, msg->msg_len);
+    if (len != (int) msg->msg_len) {
+        ut->stats.nbad++;
+        TRACE(ut->dc->trace, TRACE_REJECT, msg->msg_len, len, 0);
+        return;
+    }
+    struct packet *pkt = deserialize_packet_view(ut->dc, buf);
+    if (pkt == NULL) {
+        ut->stats.nbad++;
+        return;
+    }
+    receive_packet(ut->dc, pkt);
+    if (++ut->sincefb >= ut->fbevery)
+        send_feedback(ut);
+}
+
+static int receive_feedback(struct udp_tunnel *ut, int n)
+{
+    struct dec_feedback fb;
+    int last = -1;
+    for (int i=0; i<n; i++) {
+        if (deserialize_feedback(ut->fbbuf[i], ut->fbmsg[i].msg_len, &fb) < 0)
+            continue;
+        ut->stats.fbrecv++;
+        TRACE(ut->ec->trace, TRACE_FEEDBACK, fb.inorder, fb.deficit, fb.nruns);
+        last = i;
+        if (ut->ec->sched != NULL)
+            sched_feedback(ut->ec, &fb);
+        else if (fb.inorder >= ut->ec->headsid)
+            flush_acked_packets(ut->ec, fb.inorder);
+    }
+    if (last < 0)
+        return 0;
+    // repair packets sent since the previous feedback may not have reached the
+    // peer when it sent this one, so they still count against its deficit
+    int inflight = ut->inflight;
+    ut->inflight = 0;
+    if (ut->ec->sched != NULL)
+        return send_scheduled(ut);
+    if (ut->ec->nextsid < ut->ec->snum)
+        return 0;                   // repairs still follow the source packets
+    // answer only the latest feedback, earlier deficits are included in it
+    struct packet *pkts[UT_BATCH];
+    deserialize_feedback(ut->fbbuf[last], ut->fbmsg[last].msg_len, &fb);
+    fb.deficit -= inflight;
+    if (fb.deficit <= 0) {
+        ut->stats.nspared += fb.deficit + inflight;
+        return 0;
+    }
+    ut->stats.nspared += inflight;
+    int k = output_targeted_repairs(ut->ec, &fb, pkts, UT_BATCH);
+    int ret = 0;
+    for (int i=0; i<k; i++) {
+        if (batch_packet(ut, pkts[i]) < 0)
+            ret = -1;
+    }
+    return ret;
+}
+
+// Drain a socket by batches, returning the number of datagrams taken
+static int drain(struct udp_tunnel *ut, int fd, struct mmsghdr *msg, int slot)
+{
+    int total = 0;
+    for (;;) {
+        for (int i=0; i<UT_BATCH; i++) {
+            msg[i].msg_hdr.msg_iov->iov_len = slot;
+            msg[i].msg_hdr.msg_flags = 0;
+        }
+        int n = recvmmsg(fd, msg, UT_BATCH, MSG_DONTWAIT, NULL);
+        ut->stats.nsyscall++;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? total : -1;
+        }
+        if (fd == ut->fd) {
+            for (int i=0; i<n; i++)
+                receive_data(ut, &msg[i]);
+        } else if (receive_feedback(ut, n) < 0) {
+            return -1;
+        }
+        total += n;
+        if (n < UT_BATCH)
+            return total;
+    }
+}
+
+int ut_poll(struct udp_tunnel *ut, int timeout_ms)
+{
+    if (ut_flush(ut) < 0)
+        return -1;
+    struct pollfd pfd[2] = { { ut->fd, POLLIN, 0 }, { ut->fbfd, POLLIN, 0 } };
+    int r = poll(pfd, 2, timeout_ms);
+    ut->stats.nsyscall++;
+    if (r < 0)
+        return errno == EINTR ? 0 : -1;
+    if (r == 0) {
+        if (timeout_ms <= 0)
+            return 0;
+        // idle: report what arrived since the last feedback, probe the peer
+        if (ut->sincefb > 0)
+            send_feedback(ut);
+        if (ut->connected && ut_unacked(ut)) {
+            struct packet *pkt = output_repair_packet(ut->ec);
+            if (pkt != NULL) {
+                ut->stats.nprobe++;
+                if (batch_packet(ut, pkt) < 0)
+                    return -1;
+            }
+        }
+        return ut_flush(ut) < 0 ? -1 : 0;
+    }
+    int total = 0;
+    if (pfd[0].revents & POLLIN) {
+        int n = drain(ut, ut->fd, ut->rmsg, UT_MAXDGRAM);
+        if (n < 0)
+            return -1;
+        total += n;
+    }
+    if (pfd[1].revents & POLLIN) {
+        int n = drain(ut, ut->fbfd, ut->fbmsg, WIRE_MAXFB);
+        if (n < 0)
+            return -1;
+        total += n;
+    }
+    return ut_flush(ut) < 0 ? -1 : total;
+}
+
+void ut_get_stats(struct udp_tunnel *ut, struct ut_stats *st)
+{
+    *st = ut->stats;
+}
+
+void ut_close(struct udp_tunnel *ut)
+{
+    if (ut == NULL)
+        return;
+    if (ut->fd >= 0)
+        close(ut->fd);
+    if (ut->fbfd >= 0)
+        close(ut->fbfd);
+    if (ut->ec != NULL)
+        free_encoder(ut->ec);
+    if (ut->dc != NULL)
+        free_decoder(ut->dc);
+    free(ut->sbuf);
+    free(ut->rbuf);
+    free(ut);
+}
@@ -0,0 +1,89 @@
+#ifndef UDPTUNNEL_H
+#define UDPTUNNEL_H
+/*
+ * Batched UDP tunnel endpoint
+ *
+ * A reference transport for applications that would otherwise make one call
+ * and one system call per packet (e.g., the TCP performance enhancing proxy
+ * built on pystreamc.py). An endpoint owns the encoder of the packets it sends
+ * and the decoder of the packets it receives, and two UDP sockets:
+ *  a) the data socket carries serialized packets. ut_send() enqueues source
+ *     packets and serializes the packets to send straight into a batch of
+ *     datagrams, handed to the kernel by one sendmmsg() per UT_BATCH
+ *     datagrams; ut_poll() takes up to UT_BATCH datagrams per recvmmsg() and
+ *     feeds them through deserialize_packet_view() to receive_packet()
+ *  b) the feedback socket carries serialized decoder feedback (struct
+ *     dec_feedback, see wireformat.h), sent after every fbevery received data
+ *     packets and when the data socket fell idle with packets received since
+ *     the last feedback. Feedback from the peer flushes the encoder up to its
+ *     in-order id (through sched_feedback() if a scheduler is attached) and,
+ *     once no source packet is waiting, is answered with targeted repair
+ *     packets for its rank deficit, less the repair packets sent since the
+ *     previous feedback arrived, which are taken as still in flight
+ * Without a scheduler, a full repair packet is sent after every cp->repfreq
+ * source packets (cp->repfreq < 1 being the fraction of repair packets as in
+ * the examples, 0 for none); with one, next_packet() decides. While packets are
+ * unacknowledged and nothing arrives within a non-zero timeout of ut_poll(), a
+ * full repair packet probes the peer, so that the loss of the last packets of
+ * a burst is repaired without new data.
+ *
+ * Datagrams are at most UT_MAXDGRAM bytes, so repair packets of wide encoding
+ * windows are best sent with COE_COUNTER and WIRE_COMPACT, which elide the
+ * coefficients. Tracers attached to ut->ec and ut->dc (set_encoder_trace() and
+ * set_decoder_trace()) also record the feedback received (TRACE_FEEDBACK) and
+ * the datagrams rejected (TRACE_REJECT). A loss shim (ut_set_loss()) drops datagrams before they are
+ * sent, for end-to-end tests over loopback. An endpoint is not thread-safe;
+ * one thread per endpoint.
+ */
+#include "streamcodec.h"
+
+#define UT_BATCH        64          // datagrams per sendmmsg()/recvmmsg()
+#define UT_MAXDGRAM     65507       // maximum UDP payload
+#define UT_FBEVERY      32          // default received data packets between feedback
+
+struct ut_stats {
+    unsigned long long  nsource;    // source packets sent
+    unsigned long long  nrepair;    // repair packets sent, including targeted repairs and probes
+    unsigned long long  nprobe;     // repair packets sent by ut_poll() timeouts
+    unsigned long long  nspared;    // targeted repairs not sent as repairs were in flight
+    unsigned long long  nrecv;      // data datagrams received
+    unsigned long long  nbad;       // ... rejected (truncated or corrupt)
+    unsigned long long  fbsent;     // feedback datagrams sent
+    unsigned long long  fbrecv;     // ... received
+    unsigned long long  dropped;    // datagrams dropped by the loss shim
+    unsigned long long  oversize;   // packets not sent as they exceed UT_MAXDGRAM
+    unsigned long long  nsyscall;   // poll(), sendmmsg(), recvmmsg() and sendto() calls
+};
+
+struct udp_tunnel;
+
+// Bind the data and feedback sockets to addr (NULL for any) and the given ports,
+// 0 for ephemeral ones. cp is copied; NULL on error
+struct udp_tunnel *ut_open(const struct parameters *cp, const char *addr, int port, int fbport);
+// Set the peer's data and feedback ports. Returns 0 on success, -1 on error
+int ut_connect(struct udp_tunnel *ut, const char *addr, int port, int fbport);
+// Local ports, e.g., after binding to ephemeral ones
+void ut_ports(struct udp_tunnel *ut, int *port, int *fbport);
+// The codec contexts, e.g., to set the wire format, a scheduler or a delivery
+// callback, which is required unless the application polls dc->inorder
+struct encoder *ut_encoder(struct udp_tunnel *ut);
+struct decoder *ut_decoder(struct udp_tunnel *ut);
+void ut_set_feedback(struct udp_tunnel *ut, int fbevery);
+// Drop sent data datagrams with a Gilbert-Elliott channel of loss rate pe and
+// mean loss burst burst (1 or less: Bernoulli), and feedback datagrams with
+// probability fbpe. pe = 0 and fbpe = 0 disable the shim
+void ut_set_loss(struct udp_tunnel *ut, double pe, double burst, double fbpe, unsigned long seed);
+// Enqueue n source packets of pktsize bytes from data and batch the packets to
+// send. Returns n, or -1 on error
+int ut_send(struct udp_tunnel *ut, const unsigned char *data, int n);
+// Send the batched datagrams. Returns 0 on success, -1 on error
+int ut_flush(struct udp_tunnel *ut);
+// Flush, then wait up to timeout_ms for datagrams and process all that arrived,
+// one batch at a time. Returns the number of datagrams processed, -1 on error
+int ut_poll(struct udp_tunnel *ut, int timeout_ms);
+// Whether sent source packets are not yet acknowledged by the peer
+int ut_unacked(struct udp_tunnel *ut);
+void ut_get_stats(struct udp_tunnel *ut, struct ut_stats *st);
+void ut_close(struct udp_tunnel *ut);
+
+#endif  // UDPTUNNEL_H
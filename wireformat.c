@@ -0,0 +1,277 @@
+/*
+ * Legacy and compact wire formats of serialized packets. See wireformat.h.
+ */
+#include <limits.h>
+#include <stdint.h>
+#include "wireformat.h"
+
+static int put_varint(unsigned char *buf, unsigned int v)
+{
+    int n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    buf[n++] = v;
+    return n;
+}
+
+// Return number of bytes consumed, or -1 if the varint is longer than 5 bytes or
+// runs past the len bytes of buf
+static int get_varint(const unsigned char *buf, int len, unsigned int *v)
+{
+    unsigned int r = 0;
+    for (int n=0; n<5 && n<len; n++) {
+        r |= (unsigned int) (buf[n] & 0x7f) << (7*n);
+        if ((buf[n] & 0x80) == 0) {
+            *v = r;
+            return n + 1;
+        }
+    }
+    return -1;
+}
+
+static uint16_t fletcher16(const unsigned char *hdr, int hlen)
+{
+    uint16_t s1 = 0, s2 = 0;
+    for (int i=0; i<hlen; i++) {
+        if (i == 2 || i == 3)
+            continue;               // the checksum field itself
+        s1 = (s1 + hdr[i]) % 255;
+        s2 = (s2 + s1) % 255;
+    }
+    return s2 << 8 | s1;
+}
+
+/*
+ * Return WIRE_LEGACY or WIRE_COMPACT depending on the format of a serialized
+ * packet, or -1 if it is neither.
+ */
+int wire_format(const unsigned char *pktstr)
+{
+    int sourceid, repairid;
+    memcpy(&sourceid, pktstr, sizeof(int));
+    memcpy(&repairid, pktstr + sizeof(int), sizeof(int));
+    if (sourceid == -1 || repairid == -1)
+        return WIRE_LEGACY;
+    if (pktstr[0] == WIRE_MAGIC && pktstr[1] == WIRE_VERSION)
+        return WIRE_COMPACT;
+    return -1;
+}
+
+/*
+ * Write the compact header of pkt (WIRE_MAXHDR bytes at most) to hdr, e.g., in
+ * front of coefficients and symbols encoded in place. Return its length.
+ */
+int compact_header(const struct parameters *cp, const struct packet *pkt, unsigned char *hdr)
+{
+    int n = 5;
+    hdr[0] = WIRE_MAGIC;
+    hdr[1] = WIRE_VERSION;
+    hdr[4] = 0;
+    if (pkt->repairid >= 0) {
+        hdr[4] |= WIRE_F_REPAIR;
+        if (cp->coemode != COE_COUNTER)
+            hdr[4] |= WIRE_F_COES;
+        n += put_varint(hdr + n, pkt->repairid);
+        n += put_varint(hdr + n, pkt->win_e);
+        n += put_varint(hdr + n, pkt->win_e - pkt->win_s);
+    } else {
+        n += put_varint(hdr + n, pkt->sourceid);
+    }
+    uint16_t sum = fletcher16(hdr, n);
+    hdr[2] = sum & 0xff;
+    hdr[3] = sum >> 8;
+    return n;
+}
+
+int compact_size(const struct parameters *cp, const struct packet *pkt)
+{
+    unsigned char hdr[WIRE_MAXHDR];
+    int n = compact_header(cp, pkt, hdr);
+    if (hdr[4] & WIRE_F_COES)
+        n += (pkt->win_e - pkt->win_s + 1) * COEBYTES(cp->gfpower);
+    return n + cp->pktsize;
+}
+
+/*
+ * Serialize a packet in the compact format into buf of cap bytes. Return the
+ * number of bytes written, or -1 if cap is too small.
+ */
+int serialize_compact(const struct parameters *cp, const struct packet *pkt, unsigned char *buf, int cap)
+{
+    unsigned char hdr[WIRE_MAXHDR];
+    int n = compact_header(cp, pkt, hdr);
+    int ncoes = (hdr[4] & WIRE_F_COES) ? (pkt->win_e - pkt->win_s + 1) * COEBYTES(cp->gfpower) : 0;
+    if (n + ncoes + cp->pktsize > cap)
+        return -1;
+    memcpy(buf, hdr, n);
+    if (ncoes) {
+        memcpy(buf + n, pkt->coes, ncoes);
+        n += ncoes;
+    }
+    memcpy(buf + n, pkt->syms, cp->pktsize);
+    return n + cp->pktsize;
+}
+
+/*
+ * Parse a compact serialized packet of at most len bytes. The header fields are
+ * filled in pkt, and pkt->syms (and pkt->coes if carried) point into pktstr.
+ * pkt->coes is NULL if the coefficients were elided, to be regenerated with
+ * coef_batch(). No byte beyond len is read. Return the serialized length, or -1
+ * if the packet is not a valid compact packet, its header checksum does not
+ * match, or it is truncated, i.e., its header implies more than len bytes.
+ */
+int deserialize_compact(const struct parameters *cp, unsigned char *pktstr, int len, struct packet *pkt)
+{
+    unsigned int v[3];
+    int n = 5;
+    if (len < n || pktstr[0] != WIRE_MAGIC || pktstr[1] != WIRE_VERSION
+        || (pktstr[4] & ~(WIRE_F_REPAIR | WIRE_F_COES)))
+        return -1;
+    int nv = (pktstr[4] & WIRE_F_REPAIR) ? 3 : 1;
+    for (int i=0; i<nv; i++) {
+        int m = get_varint(pktstr + n, len - n, &v[i]);
+        if (m < 0 || v[i] > INT32_MAX)
+            return -1;
+        n += m;
+    }
+    uint16_t sum = fletcher16(pktstr, n);
+    if (pktstr[2] != (sum & 0xff) || pktstr[3] != (sum >> 8))
+        return -1;
+    if (nv == 3) {
+        if (v[2] > v[1])
+            return -1;
+        pkt->sourceid = -1;
+        pkt->repairid = v[0];
+        pkt->win_e    = v[1];
+        pkt->win_s    = v[1] - v[2];
+        if (pktstr[4] & WIRE_F_COES) {
+            if (((long long) v[2] + 1) * COEBYTES(cp->gfpower) > len - n)
+                return -1;
+            pkt->coes = pktstr + n;
+            n += (v[2] + 1) * COEBYTES(cp->gfpower);
+        } else {
+            pkt->coes = NULL;
+        }
+    } else {
+        pkt->sourceid = v[0];
+        pkt->repairid = -1;
+        pkt->win_s    = -1;
+        pkt->win_e    = -1;
+        pkt->coes     = NULL;
+    }
+    if (cp->pktsize > len - n)
+        return -1;
+    pkt->syms = pktstr + n;
+    return n + cp->pktsize;
+}
+
+/*
+ * Length of a serialized packet in either format as told by its header, reading
+ * no more than len bytes of pktstr. Return -1 if the header is invalid or implies
+ * more than len bytes.
+ */
+int wire_length(const struct parameters *cp, unsigned char *pktstr, int len)
+{
+    struct packet pkt;
+    int hdr[4];
+    if (len < 2 * (int) sizeof(int))
+        return -1;
+    int fmt = wire_format(pktstr);
+    if (fmt == WIRE_COMPACT)
+        return deserialize_compact(cp, pktstr, len, &pkt);
+    if (fmt != WIRE_LEGACY || len < (int) sizeof(hdr))
+        return -1;
+    memcpy(hdr, pktstr, sizeof(hdr));
+    long long n = sizeof(hdr) + cp->pktsize;
+    if (hdr[1] >= 0) {
+        if (hdr[0] != -1 || hdr[2] < 0 || hdr[3] < hdr[2])
+            return -1;
+        n += ((long long) hdr[3] - hdr[2] + 1) * COEBYTES(cp->gfpower);
+    } else if (hdr[1] != -1 || hdr[0] < 0) {
+        return -1;
+    }
+    return n <= len ? n : -1;
+}
+
+/*
+ * Serialize decoder feedback into buf of cap bytes. Return the number of bytes
+ * written, or -1 if cap is too small or the summary is inconsistent.
+ */
+int serialize_feedback(const struct dec_feedback *fb, unsigned char *buf, int cap)
+{
+    unsigned char msg[WIRE_MAXFB];
+    int n = 4;
+    if (fb->win_s <= fb->inorder || fb->win_e < fb->win_s - 1 || fb->nruns < 0 || fb->nruns > FB_MAXRUNS)
+        return -1;
+    msg[0] = WIRE_FB_MAGIC;
+    msg[1] = WIRE_VERSION;
+    n += put_varint(msg + n, fb->inorder + 1);
+    n += put_varint(msg + n, fb->win_s - fb->inorder - 1);
+    n += put_varint(msg + n, fb->win_e - fb->win_s + 1);
+    n += put_varint(msg + n, fb->deficit > 0 ? fb->deficit : 0);
+    n += put_varint(msg + n, fb->nruns);
+    int end = fb->win_s;
+    for (int i=0; i<fb->nruns; i++) {
+        if (fb->runs[i][0] < end || fb->runs[i][1] <= 0)
+            return -1;
+        n += put_varint(msg + n, fb->runs[i][0] - end);
+        n += put_varint(msg + n, fb->runs[i][1]);
+        end = fb->runs[i][0] + fb->runs[i][1];
+    }
+    if (n > cap)
+        return -1;
+    uint16_t sum = fletcher16(msg, n);
+    msg[2] = sum & 0xff;
+    msg[3] = sum >> 8;
+    memcpy(buf, msg, n);
+    return n;
+}
+
+/*
+ * Parse decoder feedback of at most len bytes. Return the number of bytes
+ * consumed, or -1 if it is not valid feedback or its checksum does not match.
+ */
+int deserialize_feedback(const unsigned char *buf, int len, struct dec_feedback *fb)
+{
+    unsigned int v[5 + 2 * FB_MAXRUNS];
+    int n = 4, nv = 5;
+    if (len < 4 + 5 || buf[0] != WIRE_FB_MAGIC || buf[1] != WIRE_VERSION)
+        return -1;
+    for (int i=0; i<nv; i++) {
+        int m = get_varint(buf + n, len - n, &v[i]);
+        if (m < 0 || v[i] > INT32_MAX)
+            return -1;
+        n += m;
+        if (i == 4) {
+            if (v[4] > FB_MAXRUNS)
+                return -1;
+            nv += 2 * v[4];
+        }
+    }
+    uint16_t sum = fletcher16(buf, n);
+    if (buf[2] != (sum & 0xff) || buf[3] != (sum >> 8))
+        return -1;
+    // each offset is checked against INT_MAX minus its base, so no id overflows
+    if (v[1] > (unsigned int) (INT_MAX - v[0]))
+        return -1;
+    fb->inorder = (int) v[0] - 1;
+    fb->win_s   = fb->inorder + 1 + (int) v[1];
+    if (v[2] > (unsigned int) (INT_MAX - fb->win_s) + 1)
+        return -1;
+    fb->win_e   = fb->win_s + (int) v[2] - 1;
+    fb->deficit = v[3];
+    fb->nruns   = v[4];
+    int end = fb->win_s;
+    for (int i=0; i<fb->nruns; i++) {
+        if (v[5 + 2*i] > (unsigned int) (INT_MAX - end))
+            return -1;
+        fb->runs[i][0] = end + (int) v[5 + 2*i];
+        if (v[6 + 2*i] > (unsigned int) (INT_MAX - fb->runs[i][0]))
+            return -1;
+        fb->runs[i][1] = v[6 + 2*i];
+        end = fb->runs[i][0] + fb->runs[i][1];
+    }
+    return n;
+}
@@ -0,0 +1,55 @@
+#ifndef WIREFORMAT_H
+#define WIREFORMAT_H
+/*
+ * Wire formats of serialized packets
+ *
+ * WIRE_LEGACY: four native ints (sourceid, repairid, win_s, win_e), followed by
+ *              the coefficients of repair packets and pktsize bytes of symbols.
+ *              Exactly one of sourceid and repairid is -1.
+ *
+ * WIRE_COMPACT (version 1):
+ *      byte  0     WIRE_MAGIC
+ *      byte  1     WIRE_VERSION
+ *      bytes 2-3   Fletcher-16 checksum of the header (bytes 0-1 and 4-end)
+ *      byte  4     flags, WIRE_F_REPAIR | WIRE_F_COES
+ *      varints     source packet: sourceid
+ *                  repair packet: repairid, win_e, win_e-win_s
+ *      [coes]      (win_e-win_s+1)*COEBYTES(gfpower) bytes, only if WIRE_F_COES
+ *      syms        pktsize bytes
+ *   Varints are unsigned LEB128. Coefficients are elided if the code uses
+ *   COE_COUNTER, as the decoder regenerates them from (seed, repairid, sid).
+ *   Only the header is checksummed, so a corrupt header is rejected before
+ *   any payload work. Byte 4 is never 0xFF and byte 0 is not 0xFF, so a compact
+ *   packet is never taken for a legacy one (whose first or second int is -1).
+ *
+ * Decoder feedback (struct dec_feedback, version 1):
+ *      byte  0     WIRE_FB_MAGIC
+ *      byte  1     WIRE_VERSION
+ *      bytes 2-3   Fletcher-16 checksum of bytes 0-1 and 4-end
+ *      varints     inorder+1, win_s-inorder-1, win_e-win_s+1, deficit, nruns,
+ *                  then per run: first id - end of the previous run (win_s for
+ *                  the first), count
+ */
+#include "streamcodec.h"
+
+#define WIRE_LEGACY     0
+#define WIRE_COMPACT    1
+
+#define WIRE_MAGIC      0x5C
+#define WIRE_VERSION    1
+#define WIRE_F_REPAIR   0x01        // repair packet
+#define WIRE_F_COES     0x02        // coefficients are carried explicitly
+#define WIRE_MAXHDR     20          // 5 fixed bytes plus up to three 5-byte varints
+#define WIRE_FB_MAGIC   0x5F
+#define WIRE_MAXFB      (4 + 5 * (5 + 2 * FB_MAXRUNS))
+
+int wire_format(const unsigned char *pktstr);
+int compact_header(const struct parameters *cp, const struct packet *pkt, unsigned char *hdr);
+int compact_size(const struct parameters *cp, const struct packet *pkt);
+int serialize_compact(const struct parameters *cp, const struct packet *pkt, unsigned char *buf, int cap);
+int deserialize_compact(const struct parameters *cp, unsigned char *pktstr, int len, struct packet *pkt);
+int wire_length(const struct parameters *cp, unsigned char *pktstr, int len);
+int serialize_feedback(const struct dec_feedback *fb, unsigned char *buf, int cap);
+int deserialize_feedback(const unsigned char *buf, int len, struct dec_feedback *fb);
+
+#endif  // WIREFORMAT_H